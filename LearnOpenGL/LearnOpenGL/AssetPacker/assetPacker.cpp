@@ -0,0 +1,151 @@
+// Packs directories of loose assets into a single archive that Assets::mountArchive() can read.
+//
+// Usage: AssetPacker <archive> <prefix>=<directory>[:<extension>,<extension>...] ...
+//
+// Every file under each directory (or only those with the listed extensions) is added under the logical name
+// <prefix>/<path relative to the directory>, e.g.
+//
+//      AssetPacker assets.pak Shaders=.:vs,fs =../Resources
+//
+// run from the LearnOpenGL project directory packs exactly what main.cpp mounts as loose files. Run it after the
+// renderer has built its mesh and texture caches and those get packed too, so a start from the archive never
+// touches a loose file.
+//
+// It's a separate executable from the renderer, built by the AssetPacker project in the solution. Running that
+// project from Visual Studio runs the command above in the LearnOpenGL project directory. It only needs the shared
+// headers, so it builds just as well on its own, e.g.
+//
+//      cl /std:c++17 /EHsc /O2 /I..\..\ThirdParty\OpenGL\includes assetPacker.cpp
+//      g++ -std=c++17 -O2 -I../../ThirdParty/OpenGL/includes assetPacker.cpp -o AssetPacker
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <Utility/assetArchive.h>
+#include <vector>
+
+using namespace std;
+
+string lowercaseExtension(string extension)
+{
+    transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(tolower(c)); });
+    return extension;
+}
+
+// Images are already compressed, and caches are read in place straight out of the mapping, so neither is worth
+// running through the LZ compressor. Everything else (OBJ, MTL, shader source...) is text that shrinks well.
+bool shouldCompress(const filesystem::path& path)
+{
+    static const set<string> storedRaw = { ".png", ".jpg", ".jpeg", ".dds", ".meshcache", ".pak" };
+
+    return storedRaw.count(lowercaseExtension(path.extension().string())) == 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        cout << "Usage: AssetPacker <archive> <prefix>=<directory>[:<extension>,<extension>...] ..." << endl;
+        return 1;
+    }
+
+    filesystem::path archivePath = argv[1];
+    error_code error;
+    filesystem::path absoluteArchivePath = filesystem::weakly_canonical(archivePath, error);
+
+    AssetArchiveWriter writer;
+
+    for (int i = 2; i < argc; i++)
+    {
+        string mapping = argv[i];
+        size_t separator = mapping.find('=');
+        if (separator == string::npos)
+        {
+            cout << "ERROR::ASSET_PACKER::Expected <prefix>=<directory>, got " << mapping << endl;
+            return 1;
+        }
+
+        string prefix = normalizeAssetName(mapping.substr(0, separator));
+        string directoryAndFilter = mapping.substr(separator + 1);
+        set<string> extensions;
+
+        // A trailing ":vs,fs" limits the files taken, as long as it can't be a drive letter or part of a path
+        size_t filterStart = directoryAndFilter.find_last_of(':');
+        bool driveLetter = filterStart == 1 && isalpha(static_cast<unsigned char>(directoryAndFilter[0]));
+        if (filterStart != string::npos && !driveLetter && directoryAndFilter.find_first_of("/\\", filterStart) == string::npos)
+        {
+            stringstream filter(directoryAndFilter.substr(filterStart + 1));
+            string extension;
+            while (getline(filter, extension, ','))
+            {
+                extensions.insert('.' + lowercaseExtension(extension));
+            }
+
+            directoryAndFilter.resize(filterStart);
+        }
+
+        filesystem::path directory = directoryAndFilter;
+        if (!filesystem::is_directory(directory))
+        {
+            cout << "ERROR::ASSET_PACKER::Not a directory: " << directory.string() << endl;
+            return 1;
+        }
+
+        // Sorted so the same inputs always produce the same archive
+        vector<filesystem::path> files;
+        for (const filesystem::directory_entry& entry : filesystem::recursive_directory_iterator(directory))
+        {
+            if (entry.is_regular_file() && filesystem::weakly_canonical(entry.path(), error) != absoluteArchivePath
+                && (extensions.empty() || extensions.count(lowercaseExtension(entry.path().extension().string())) > 0))
+            {
+                files.push_back(entry.path());
+            }
+        }
+
+        sort(files.begin(), files.end());
+
+        for (const filesystem::path& file : files)
+        {
+            string relativePath = filesystem::relative(file, directory).generic_string();
+            string name = prefix.empty() ? relativePath : prefix + '/' + relativePath;
+
+            if (!writer.addFile(name, file.string(), shouldCompress(file)))
+            {
+                cout << "ERROR::ASSET_PACKER::Couldn't add " << file.string() << " as " << name << " (unreadable or a duplicate name)" << endl;
+                return 1;
+            }
+        }
+    }
+
+    if (!writer.write(archivePath.string()))
+    {
+        cout << "ERROR::ASSET_PACKER::Failed to write " << archivePath.string() << endl;
+        return 1;
+    }
+
+    // Report what actually went in by reading the archive back
+    AssetArchive archive;
+    if (!archive.open(archivePath.string()))
+    {
+        cout << "ERROR::ASSET_PACKER::Wrote " << archivePath.string() << " but can't read it back" << endl;
+        return 1;
+    }
+
+    size_t totalSize = 0, storedSize = 0, compressedCount = 0;
+    for (size_t i = 0; i < archive.entryCount(); i++)
+    {
+        const AssetArchiveEntry& entry = archive.entry(i);
+        totalSize += static_cast<size_t>(entry.size);
+        storedSize += static_cast<size_t>(entry.storedSize);
+        compressedCount += entry.compression != AssetCompression::None ? 1 : 0;
+    }
+
+    cout << "ASSET_PACKER::" << archivePath.string() << " " << archive.entryCount() << " assets (" << compressedCount << " compressed), "
+        << totalSize / 1024 << " KB stored as " << storedSize / 1024 << " KB" << endl;
+    return 0;
+}
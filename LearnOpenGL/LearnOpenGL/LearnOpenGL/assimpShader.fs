@@ -1,13 +1,75 @@
 #version 330 core
 
+in vec3 Normal;
+in vec4 Tangent;
 in vec2 TexCoords;
 
 uniform sampler2D texture_diffuse1;
 uniform sampler2D texture_specular1;
+uniform sampler2D texture_normal1;
+uniform bool hasNormalMap = false;
+
+// Laid out to match the std140 structs in uniformBlocks.h, like in objectShader.fs
+struct SpotLight {
+    vec3 position;
+    float constant;
+    vec3 direction;
+    float linear;
+    vec3 ambient;
+    float quadratic;
+    vec3 diffuse;
+    float innerCutOff;
+    vec3 specular;
+    float outerCutOff;
+};
+
+struct DirectionalLight {
+    vec3 direction;
+    float padding0;
+    vec3 ambient;
+    float padding1;
+    vec3 diffuse;
+    float padding2;
+    vec3 specular;
+    float padding3;
+};
+
+// Shared by every program, see LightBlockData in uniformBlocks.h. Only the directional light's direction is used,
+// the model is shaded with a fixed ambient and diffuse split rather than the scene's light colors.
+layout (std140) uniform LightBlock
+{
+    DirectionalLight directionalLight;
+    SpotLight spotLight;
+    int pointLightCount;
+    int pointLightCapacity;
+};
 
 out vec4 FragColor;
 
+vec3 surfaceNormal()
+{
+    vec3 normal = normalize(Normal);
+
+    // A zero tangent means the model was imported without tangents
+    if (!hasNormalMap || dot(Tangent.xyz, Tangent.xyz) < 1e-8f)
+    {
+        return normal;
+    }
+
+    // Only xy is used and z rebuilt, since BC5 compressed normal maps only keep two channels
+    vec2 xy = texture(texture_normal1, TexCoords).xy * 2.0f - 1.0f;
+    vec3 tangentNormal = vec3(xy, sqrt(max(1.0f - dot(xy, xy), 0.0f)));
+
+    // Re-orthogonalize after interpolation, then build the bitangent the MikkTSpace way, from the sign in w
+    vec3 tangent = normalize(Tangent.xyz - normal * dot(normal, Tangent.xyz));
+    vec3 bitangent = Tangent.w * cross(normal, tangent);
+    return normalize(mat3(tangent, bitangent, normal) * tangentNormal);
+}
+
 void main()
 {
-    FragColor = texture(texture_diffuse1, TexCoords);
+    vec4 diffuseColor = texture(texture_diffuse1, TexCoords);
+
+    float diffuse = max(dot(surfaceNormal(), normalize(-directionalLight.direction)), 0.0f);
+    FragColor = vec4(diffuseColor.rgb * (0.3f + 0.7f * diffuse), diffuseColor.a);
 }
\ No newline at end of file
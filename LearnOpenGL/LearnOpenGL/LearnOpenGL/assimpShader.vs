@@ -3,15 +3,61 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+// Tangent in xyz, bitangent sign in w
+layout (location = 3) in vec4 aTangent;
 
+// Built with INSTANCED defined (see InstanceBuffer), each instance brings its own transforms as attributes
+#ifdef INSTANCED
+layout (location = 4) in mat4 instanceModel;
+layout (location = 8) in mat3 instanceNormalModel;
+#else
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#endif
 
+// Shared by every program, see CameraBlockData in uniformBlocks.h
+layout (std140) uniform CameraBlock
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec3 viewPos;
+};
+
+// Quantized meshes store positions relative to their bounding box and normals octahedral encoded in aNormal.xy.
+// Float meshes leave these at offset 0, scale 1 and false, which makes the decode a no-op.
+uniform vec3 positionOffset = vec3(0.0f);
+uniform vec3 positionScale = vec3(1.0f);
+uniform bool octahedralNormals = false;
+
+out vec3 Normal;
+out vec4 Tangent;
 out vec2 TexCoords;
 
+// Same as VertexQuantizer::decodeOctahedral()
+vec3 decodeOctahedral(vec2 encoded)
+{
+    vec3 normal = vec3(encoded.xy, 1.0f - abs(encoded.x) - abs(encoded.y));
+    float fold = max(-normal.z, 0.0f);
+    normal.x += normal.x >= 0.0f ? -fold : fold;
+    normal.y += normal.y >= 0.0f ? -fold : fold;
+    return normalize(normal);
+}
+
 void main()
 {
+    vec3 position = aPos * positionScale + positionOffset;
+
+    vec3 normal = octahedralNormals ? decodeOctahedral(aNormal.xy) : aNormal;
+
+    // World space, so lighting doesn't depend on how the model is placed
+#ifdef INSTANCED
+    mat4 model = instanceModel;
+    mat3 normalMatrix = instanceNormalModel;
+#else
+    mat3 normalMatrix = transpose(inverse(mat3(model)));
+#endif
+    Normal = normalMatrix * normal;
+    Tangent = vec4(mat3(model) * aTangent.xyz, aTangent.w);
     TexCoords = aTexCoords;
-    gl_Position = projection * view * model * vec4(aPos, 1.0f);
+    gl_Position = viewProjection * model * vec4(position, 1.0f);
 }
\ No newline at end of file
@@ -1,11 +1,27 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 
+// Built with INSTANCED defined (see InstanceBuffer), each instance brings its own model matrix as an attribute
+#ifdef INSTANCED
+layout (location = 4) in mat4 instanceModel;
+#else
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#endif
+
+// Shared by every program, see CameraBlockData in uniformBlocks.h
+layout (std140) uniform CameraBlock
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec3 viewPos;
+};
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+#ifdef INSTANCED
+    mat4 model = instanceModel;
+#endif
+
+    gl_Position = viewProjection * model * vec4(aPos, 1.0);
 }
\ No newline at end of file
@@ -5,10 +5,22 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
+#include <Lighting/lightManager.h>
+#include <ModelLoading/importBenchmark.h>
 #include <ModelLoading/model.h>
+#include <Rendering/glStateCache.h>
+#include <Rendering/instanceBuffer.h>
+#include <Rendering/renderQueue.h>
 #include <Shaders/shader.h>
+#include <Shaders/uniformBlocks.h>
+#include <Shaders/uniformRingBuffer.h>
 #include <string>
+#include <Textures/asyncTextureLoader.h>
+#include <Textures/mipBenchmark.h>
 #include <Textures/stb_image.h>
+#include <Textures/textureRegistry.h>
+#include <Textures/textureStreamer.h>
+#include <Utility/assets.h>
 
 // Forward Declarations
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
@@ -16,27 +28,34 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
 
-unsigned int configureTexture(const char* texturePath);
-void setSpotLight(Shader shader, Camera camera);
-void setDirectionalLight(Shader shader);
-void setPointLights(Shader shader);
+void setSpotLight(SpotLightData& light, const Camera& camera);
+void setDirectionalLight(DirectionalLightData& light);
+void addPointLights(LightManager& lightManager);
+CameraBlockData cameraBlockFor(Camera& camera, const glm::mat4& projection);
+void reportStateCache();
 
 
 // Screen setting constants
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 
-const char* assimpVertShaderPath = "C:/GraphicsProgramming/LearnOpenGL/LearnOpenGL/LearnOpenGL/assimpShader.vs";
-const char* assimpFragShaderPath = "C:/GraphicsProgramming/LearnOpenGL/LearnOpenGL/LearnOpenGL/assimpShader.fs";
+// Assets are looked up by logical name, in the packed archive if there is one (see AssetPacker) and otherwise as loose
+// files. Loose directories are relative to the working directory, which Visual Studio sets to the project directory.
+const char* assetArchivePath = "assets.pak";
+const char* shaderDirectory = ".";
+const char* resourceDirectory = "../Resources";
 
-const char* backpackObjectPath = "C:/GraphicsProgramming/LearnOpenGL/LearnOpenGL/Resources/Objects/backpack/backpack.obj";
+const char* assimpVertShaderPath = "Shaders/assimpShader.vs";
+const char* assimpFragShaderPath = "Shaders/assimpShader.fs";
 
-const char* objVertShaderPath = "C:/GraphicsProgramming/LearnOpenGL/LearnOpenGL/LearnOpenGL/objectShader.vs";
-const char* objFragShaderPath = "C:/GraphicsProgramming/LearnOpenGL/LearnOpenGL/LearnOpenGL/objectShader.fs";
-const char* lightVertShaderPath = "C:/GraphicsProgramming/LearnOpenGL/LearnOpenGL/LearnOpenGL/lightShader.vs";
-const char* lightFragShaderPath = "C:/GraphicsProgramming/LearnOpenGL/LearnOpenGL/LearnOpenGL/lightShader.fs";
-const char* diffuseMapPath = "C:/GraphicsProgramming/LearnOpenGL/LearnOpenGL/Resources/Textures/container2.png";
-const char* specularMapPath = "C:/GraphicsProgramming/LearnOpenGL/LearnOpenGL/Resources/Textures/container2_specular.png";
+const char* backpackObjectPath = "Objects/backpack/backpack.obj";
+
+const char* objVertShaderPath = "Shaders/objectShader.vs";
+const char* objFragShaderPath = "Shaders/objectShader.fs";
+const char* lightVertShaderPath = "Shaders/lightShader.vs";
+const char* lightFragShaderPath = "Shaders/lightShader.fs";
+const char* diffuseMapPath = "Textures/container2.png";
+const char* specularMapPath = "Textures/container2_specular.png";
 
 // Time between current frame and last frame
 float deltaTime = 0.0f;
@@ -122,6 +141,13 @@ glm::vec3 pointLightPositions[] = {
 // Toggle this to switch between using assimp model loading vs manually defined geometry
 const bool useAssimp = true;
 
+// Toggle this to time CPU mip generation against glGenerateMipmap at startup
+const bool runMipBenchmark = false;
+
+// Toggle this to time Assimp importing the model through its default file IO against AssetIOSystem, and its vertex
+// joining against VertexWelder, at startup
+const bool runImportBenchmark = false;
+
 int main()
 {
     // Init glfw, setting to OpenGL 3.3 and the core-profile
@@ -157,9 +183,28 @@ int main()
     // Enable depth testing via the z-buffer
     glEnable(GL_DEPTH_TEST);
 
+    // Mounted newest first, so the archive wins over loose files wherever it has a copy
+    Assets::instance().mountDirectory("", resourceDirectory);
+    Assets::instance().mountDirectory("Shaders", shaderDirectory);
+    if (Assets::instance().mountArchive(assetArchivePath))
+    {
+        cout << "ASSETS::MOUNTED::" << assetArchivePath << endl;
+    }
+
     // Set stbi to flip loaded textures on the y-axis before we load any models.
     stbi_set_flip_vertically_on_load(true);
 
+    if (runMipBenchmark)
+    {
+        benchmarkMipGeneration(diffuseMapPath);
+    }
+
+    if (runImportBenchmark)
+    {
+        benchmarkModelImport(backpackObjectPath);
+        benchmarkVertexWelding(backpackObjectPath);
+    }
+
     // draw in wireframe
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
@@ -169,12 +214,27 @@ int main()
 
         Shader assimpShader(assimpVertShaderPath, assimpFragShaderPath);
         Model guitarModel(backpackObjectPath);
+        UniformHandle modelUniform = assimpShader.uniform("model");
+
+        // Camera matrices for every program, written once a frame. The model is lit by the scene's directional light,
+        // which never changes, so the light block is only written the first time it's uploaded.
+        UniformRingBuffer cameraBuffer(CAMERA_BLOCK_BINDING, sizeof(CameraBlockData));
+        LightManager lightManager;
+        DirectionalLightData directionalLight;
+        setDirectionalLight(directionalLight);
+        lightManager.setDirectionalLight(directionalLight);
+        RenderQueue renderQueue;
+        ModelDrawStats previousDrawStats;
+        double lastStatsReport = 0.0;
 
         while (!glfwWindowShouldClose(window))
         {
             // Check for specific key presses
             processInput(window);
 
+            // Swap in any textures that finished decoding in the background, within our per-frame budget
+            AsyncTextureLoader::instance().processUploads(TEXTURE_UPLOAD_BUDGET_MS);
+
             // Execute render commands
             // 
             // (Currently just clearing the previous frame, displaying the specified color)
@@ -188,22 +248,67 @@ int main()
             // Enable shader before setting uniforms
             assimpShader.useProgram();
 
+            lightManager.upload();
+
             glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-            glm::mat4 view = camera.GetViewMatrix();
-            assimpShader.setMat4("projection", projection);
-            assimpShader.setMat4("view", view);
+            CameraBlockData cameraBlock = cameraBlockFor(camera, projection);
+            cameraBuffer.update(cameraBlock);
 
             glm::mat4 model = glm::mat4(1.0f);
             // translate it down so it's at the center of the scene
             model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
             // it's a bit too big for our scene, so scale it down
             model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));
-            assimpShader.setMat4("model", model);
+            assimpShader.setMat4(modelUniform, model);
 
             // TODO: Set normal model here
 
+            // Let distant meshes drop to a coarser LOD, as long as the difference stays under a pixel, and skip
+            // meshlets we can't see
+            DrawView drawView;
+            drawView.cameraPosition = camera.Position;
+            drawView.modelMatrix = model;
+            drawView.viewProjection = cameraBlock.viewProjection;
+            drawView.projectionScale = DrawView::projectionScaleFor((float)SCR_HEIGHT, glm::radians(camera.Zoom));
+
             // Render!
-            guitarModel.draw(assimpShader);
+            renderQueue.clear();
+            guitarModel.submit(renderQueue, assimpShader, drawView);
+            renderQueue.execute();
+
+            // Now that we know how big every texture ended up on screen, stream their mips in (or out)
+            TextureStreamer::instance().update(TEXTURE_STREAMING_BUDGET_MS);
+
+            // Report which LODs we're drawing whenever that changes
+            const ModelDrawStats& drawStats = guitarModel.lastDrawStats();
+            if (!drawStats.sameLods(previousDrawStats))
+            {
+                cout << "MODEL::LOD_DRAW::";
+                for (unsigned int lod = 0; lod < MAX_MESH_LODS; lod++)
+                {
+                    cout << " LOD" << lod << " " << drawStats.meshCounts[lod] << " meshes/" << drawStats.triangleCounts[lod] << " triangles";
+                }
+
+                cout << endl;
+            }
+
+            previousDrawStats = drawStats;
+
+            // Culling and streaming change every time the camera moves, so only report them every couple of seconds
+            if (glfwGetTime() - lastStatsReport > 2.0)
+            {
+                const MeshletCullingStats& cullingStats = drawStats.meshletCulling;
+                cout << "MODEL::MESHLET_CULLING:: culled " << cullingStats.culledMeshletCount << "/" << cullingStats.meshletCount
+                    << " meshlets, " << cullingStats.culledTriangleCount << " triangles" << endl;
+
+                TextureStreamingStats streamingStats = TextureStreamer::instance().stats();
+                cout << "TEXTURE::STREAMING:: " << streamingStats.textureCount << " textures, " << streamingStats.residentBytes / (1024 * 1024)
+                    << "/" << streamingStats.budgetBytes / (1024 * 1024) << " MB resident, " << streamingStats.uploadedLevels << " levels uploaded, "
+                    << streamingStats.evictedLevels << " evicted, " << streamingStats.starvedTextures << " still streaming" << endl;
+
+                reportStateCache();
+                lastStatsReport = glfwGetTime();
+            }
 
 
             // Swap color buffer once the new frame is ready
@@ -221,12 +326,20 @@ int main()
         // --------------------- Container & Lighting Rendering ---------------------
 
         // Create shader program
-        Shader objectShader(objVertShaderPath, objFragShaderPath);
-        Shader lightShader(lightVertShaderPath, lightFragShaderPath);
+        // Both draw every copy of their cube in a single instanced draw call
+        Shader objectShader(objVertShaderPath, objFragShaderPath, { INSTANCED_SHADER_DEFINE });
+        Shader lightShader(lightVertShaderPath, lightFragShaderPath, { INSTANCED_SHADER_DEFINE });
 
         // Create and load textures
-        unsigned int diffuseMap = configureTexture(diffuseMapPath),
-            specularMap = configureTexture(specularMapPath);
+        // The specular map is intensity data, not colour
+        TextureLoadParameters specularParameters;
+        specularParameters.srgbEncoded = false;
+
+        unsigned int diffuseMap = TextureRegistry::instance().acquireAsync(diffuseMapPath),
+            specularMap = TextureRegistry::instance().acquireAsync(specularMapPath, specularParameters);
+
+        // Every bind goes through the state cache, which skips the ones that wouldn't change anything
+        GLStateCache& glState = GLStateCache::instance();
 
         // Create a VAO and VBO
         unsigned int objectVAO, lightVAO, VBO;
@@ -234,9 +347,9 @@ int main()
         glGenVertexArrays(1, &lightVAO);
         glGenBuffers(1, &VBO);
 
-        glBindVertexArray(objectVAO);
+        glState.bindVertexArray(objectVAO);
 
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glState.bindBuffer(GL_ARRAY_BUFFER, VBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
         // Position attribute
@@ -249,18 +362,92 @@ int main()
         glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
         glEnableVertexAttribArray(2);
 
-        glBindVertexArray(lightVAO);
+        glState.bindVertexArray(lightVAO);
 
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glState.bindBuffer(GL_ARRAY_BUFFER, VBO);
 
         // Position attribute
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
         glEnableVertexAttribArray(0);
 
+        // The cubes and light gizmos never move, so their transforms (and the cubes' normal matrices) are worked out
+        // and uploaded once, as per-instance attributes of each VAO
+        vector<glm::mat4> cubeModels, lightModels;
+        for (unsigned int i = 0; i < 10; i++)
+        {
+            glm::mat4 objectModel = glm::mat4(1.0f);
+            objectModel = glm::translate(objectModel, cubePositions[i]);
+            float angle = 20.0f * i;
+            objectModel = glm::rotate(objectModel, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
+            cubeModels.push_back(objectModel);
+        }
+
+        for (const glm::vec3& lightPosition : pointLightPositions)
+        {
+            // Because the lightModel will be acting upon object-space vertex coordinates we need to translate to the world space position
+            // of the light
+            glm::mat4 lightModel = glm::mat4(1.0f);
+            lightModel = glm::translate(lightModel, lightPosition);
+            lightModel = glm::scale(lightModel, glm::vec3(0.2f));
+            lightModels.push_back(lightModel);
+        }
+
+        InstanceBuffer cubeInstances, lightInstances;
+        cubeInstances.upload(cubeModels);
+        cubeInstances.attach(objectVAO);
+        lightInstances.upload(lightModels);
+        lightInstances.attach(lightVAO);
+
         // Set texture uniforms
         objectShader.useProgram();
         objectShader.setInt("material.diffuseMap", 0);
         objectShader.setInt("material.specularMap", 1);
+        objectShader.setInt(POINT_LIGHT_SAMPLER_NAME, POINT_LIGHT_TEXTURE_UNIT);
+
+        // Everything the render loop sets, resolved up front
+        objectShader.setFloat("material.shininess", 64.0f);
+        lightShader.useProgram();
+        lightShader.setVec3("lightColor", pointLightColor);
+
+        // Each set of cubes is sorted as a whole, by the distance to its middle
+        glm::vec3 cubesCenter = glm::vec3(0.0f), lightsCenter = glm::vec3(0.0f);
+        for (const glm::mat4& cubeModel : cubeModels)
+        {
+            cubesCenter += glm::vec3(cubeModel[3]) / float(cubeModels.size());
+        }
+
+        for (const glm::mat4& lightModel : lightModels)
+        {
+            lightsCenter += glm::vec3(lightModel[3]) / float(lightModels.size());
+        }
+
+        // The containers' material and the light gizmos' flat color are materials of their own
+        DrawSubmission cubesDraw;
+        cubesDraw.shader = &objectShader;
+        cubesDraw.material = allocateMaterialIds(1);
+        cubesDraw.vertexArray = objectVAO;
+        cubesDraw.vertexCount = 36;
+        cubesDraw.textures = { diffuseMap, specularMap };
+        cubesDraw.instances = &cubeInstances;
+
+        DrawSubmission lightsDraw;
+        lightsDraw.shader = &lightShader;
+        lightsDraw.material = allocateMaterialIds(1);
+        lightsDraw.vertexArray = lightVAO;
+        lightsDraw.vertexCount = 36;
+        lightsDraw.instances = &lightInstances;
+        RenderQueue renderQueue;
+
+        // The camera and the lights are shared by both programs through uniform blocks. The camera's written once a
+        // frame, the lights only when one of them changes.
+        UniformRingBuffer cameraBuffer(CAMERA_BLOCK_BINDING, sizeof(CameraBlockData));
+        LightManager lightManager;
+        DirectionalLightData directionalLight;
+        setDirectionalLight(directionalLight);
+        lightManager.setDirectionalLight(directionalLight);
+        addPointLights(lightManager);
+        SpotLightData spotLight;
+        double lastStatsReport = 0.0;
 
         // Render loop
         while (!glfwWindowShouldClose(window))
@@ -268,6 +455,9 @@ int main()
             // Check for specific key presses
             processInput(window);
 
+            // Swap in any textures that finished decoding in the background, within our per-frame budget
+            AsyncTextureLoader::instance().processUploads(TEXTURE_UPLOAD_BUDGET_MS);
+
             // Execute render commands
             // 
             // (Currently just clearing the previous frame, displaying the specified color)
@@ -278,73 +468,29 @@ int main()
             glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-            // Render Cubes
-            objectShader.useProgram();
-            glBindVertexArray(objectVAO);
-
-            // Bind Object Textures
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, diffuseMap);
-
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, specularMap);
-
-            // Material Properties
-            objectShader.setFloat("material.shininess", 64.0f);
-
-            // Light Properties
-            setSpotLight(objectShader, camera);
-            setDirectionalLight(objectShader);
-            setPointLights(objectShader);
-
-            objectShader.setVec3("viewPos", camera.Position);
-
-            // Construct our object's transformation matrices
-            // note that we're translating the scene in the reverse direction of where we want to move
-            glm::mat4 view = camera.GetViewMatrix();
-            objectShader.setMat4("view", view);
+            // Light Properties. Only the spotlight moves, it follows the camera.
+            setSpotLight(spotLight, camera);
+            lightManager.setSpotLight(spotLight);
+            lightManager.upload();
 
+            // Construct our camera's transformation matrices
+            // note that the view matrix translates the scene in the reverse direction of where we want to move
             glm::mat4 projection;
             projection = glm::perspective(glm::radians(camera.Zoom), 800.0f / 600.0f, 0.1f, 100.0f);
-            objectShader.setMat4("projection", projection);
-
-            for (unsigned int i = 0; i < 10; i++)
-            {
-                // Calculate the model matrix for each object and pass it to shader before drawing
-                glm::mat4 objectModel = glm::mat4(1.0f);
-                objectModel = glm::translate(objectModel, cubePositions[i]);
-                float angle = 20.0f * i;
-                objectModel = glm::rotate(objectModel, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-                objectShader.setMat4("model", objectModel);
-
-                // Prepare the normal matrix for the objects normal vectors (used to transform normals into world space
-                // without suffering from non-uniform scaling distortions)
-                glm::mat4 normalModel = glm::inverse(objectModel);
-                normalModel = glm::transpose(normalModel);
-                objectShader.setMat3("normalModel", glm::mat3(normalModel));
-                glDrawArrays(GL_TRIANGLES, 0, 36);
-            }
-
-            // Render pointlights
-            lightShader.useProgram();
-            glBindVertexArray(lightVAO);
+            cameraBuffer.update(cameraBlockFor(camera, projection));
 
-            lightShader.setVec3("lightColor", pointLightColor);
+            // Render the cubes and the point light gizmos, in whichever order the queue sorts them into
+            cubesDraw.depth = glm::length(cubesCenter - camera.Position);
+            lightsDraw.depth = glm::length(lightsCenter - camera.Position);
+            renderQueue.clear();
+            renderQueue.submit(cubesDraw);
+            renderQueue.submit(lightsDraw);
+            renderQueue.execute();
 
-            // Set up the light's transform matrices
-            lightShader.setMat4("view", view);
-            lightShader.setMat4("projection", projection);
-
-            for (unsigned int i = 0; i < 4; i++)
+            if (glfwGetTime() - lastStatsReport > 2.0)
             {
-                glm::mat4 lightModel = glm::mat4(1.0f);
-                // Because the lightModel will be acting upon object-space vertex coordinates we need to translate to the world space position
-                // of the light
-                lightModel = glm::translate(lightModel, glm::vec3(pointLightPositions[i]));
-                lightModel = glm::scale(lightModel, glm::vec3(0.2f));
-                lightShader.setMat4("model", lightModel);
-
-                glDrawArrays(GL_TRIANGLES, 0, 36);
+                reportStateCache();
+                lastStatsReport = glfwGetTime();
             }
 
             // Swap color buffer once the new frame is ready
@@ -355,9 +501,11 @@ int main()
         }
 
         // Memory clean-up
-        glDeleteVertexArrays(1, &objectVAO);
-        glDeleteVertexArrays(1, &lightVAO);
-        glDeleteBuffers(1, &VBO);
+        glState.deleteVertexArray(objectVAO);
+        glState.deleteVertexArray(lightVAO);
+        glState.deleteBuffer(VBO);
+        TextureRegistry::instance().release(diffuseMap);
+        TextureRegistry::instance().release(specularMap);
         objectShader.deleteProgram();
         lightShader.deleteProgram();
     }
@@ -457,53 +605,31 @@ void processInput(GLFWwindow* window)
 }
 
 
-unsigned int configureTexture(const char* texturePath)
+CameraBlockData cameraBlockFor(Camera& camera, const glm::mat4& projection)
 {
-    unsigned int texture;
-    int width, height, nrChannels;
-    unsigned char* data = stbi_load(texturePath, &width, &height, &nrChannels, 0);
-
-    if (data)
-    {
-        glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        // TODO: Again, is this a proper initialization? We need a good default to avoid the unitialized memory issue
-        GLenum format = 0;
-        if (nrChannels == 1)
-        {
-            format = GL_RED;
-        }
-        else if (nrChannels == 3)
-        {
-            format = GL_RGB;
-        }
-        else if (nrChannels == 4)
-        {
-            format = GL_RGBA;
-        }
+    CameraBlockData block;
+    block.view = camera.GetViewMatrix();
+    block.projection = projection;
+    block.viewProjection = projection * block.view;
+    block.viewPos = camera.Position;
+    return block;
+}
 
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
 
-        stbi_image_free(data);
-        return texture;
-    }
-    else
-    {
-        cout << "Failed to load texture" << endl;
+// Prints how many binds went through to GL since the last report, and how many the state cache dropped
+void reportStateCache()
+{
+    const GLStateStats& stats = GLStateCache::instance().stats();
+    GLBindCounts total = stats.total();
+    cout << "GL_STATE::BINDS:: " << total.issued << " issued, " << total.filtered << " filtered (programs " << stats.programs.filtered
+        << ", vertex arrays " << stats.vertexArrays.filtered << ", texture units " << stats.activeTextures.filtered << ", textures "
+        << stats.textures.filtered << ", buffers " << stats.buffers.filtered << ")" << endl;
 
-        stbi_image_free(data);
-        return 0;
-    }
+    GLStateCache::instance().resetStats();
 }
 
 
-void setSpotLight(Shader shader, Camera camera)
+void setSpotLight(SpotLightData& light, const Camera& camera)
 {
     glm::vec3 lightColor = glm::vec3(1.0f, 1.0f, 1.0f);
     float outerCutOff = 10.0f;
@@ -511,43 +637,44 @@ void setSpotLight(Shader shader, Camera camera)
     glm::vec3 diffuseLight = lightColor * glm::vec3(0.8f);
     glm::vec3 ambientLight = diffuseLight * glm::vec3(0.05f);
 
-    shader.setVec3("spotLight.position", camera.Position);
-    shader.setVec3("spotLight.direction", camera.Front);
-    shader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(outerCutOff)));
-    shader.setFloat("spotLight.innerCutOff", glm::cos(glm::radians(innerCutOff)));
-    shader.setVec3("spotLight.ambient", ambientLight);
-    shader.setVec3("spotLight.diffuse", diffuseLight);
-    shader.setVec3("spotLight.specular", lightColor);
-    shader.setFloat("spotLight.constant", 1.0f);
-    shader.setFloat("spotLight.linear", 0.09f);
-    shader.setFloat("spotLight.quadratic", 0.032f);
+    light.position = camera.Position;
+    light.direction = camera.Front;
+    light.outerCutOff = glm::cos(glm::radians(outerCutOff));
+    light.innerCutOff = glm::cos(glm::radians(innerCutOff));
+    light.ambient = ambientLight;
+    light.diffuse = diffuseLight;
+    light.specular = lightColor;
+    light.constant = 1.0f;
+    light.linear = 0.09f;
+    light.quadratic = 0.032f;
 }
 
 
-void setPointLights(Shader shader)
+void addPointLights(LightManager& lightManager)
 {
     glm::vec3 lightColor = pointLightColor;
     glm::vec3 diffuseLight = lightColor * glm::vec3(0.2f);
     glm::vec3 ambientLight = diffuseLight * glm::vec3(0.05f);
 
-    for (unsigned int i = 0; i < 4; i++)
+    for (const glm::vec3& position : pointLightPositions)
     {
-        string prefix = "pointLights[" + to_string(i) + "].";
-        shader.setVec3(prefix + "position", pointLightPositions[i]);
-        shader.setVec3(prefix + "ambient", ambientLight);
-        shader.setVec3(prefix + "diffuse", diffuseLight);
-        shader.setVec3(prefix + "specular", lightColor);
-        shader.setFloat(prefix + "constant", 1.0f);
-        shader.setFloat(prefix + "linear", 0.09f);
-        shader.setFloat(prefix + "quadratic", 0.032f);
+        PointLightData light;
+        light.position = position;
+        light.ambient = ambientLight;
+        light.diffuse = diffuseLight;
+        light.specular = lightColor;
+        light.constant = 1.0f;
+        light.linear = 0.09f;
+        light.quadratic = 0.032f;
+        lightManager.addPointLight(light);
     }
 }
 
 
-void setDirectionalLight(Shader shader)
+void setDirectionalLight(DirectionalLightData& light)
 {
-    shader.setVec3("directionalLight.direction", glm::vec3(-0.2f, -1.0f, -0.3f));
-    shader.setVec3("directionalLight.ambient", glm::vec3(0.02f));
-    shader.setVec3("directionalLight.diffuse", glm::vec3(0.06f));
-    shader.setVec3("directionalLight.specular", glm::vec3(0.2f));
+    light.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+    light.ambient = glm::vec3(0.02f);
+    light.diffuse = glm::vec3(0.06f);
+    light.specular = glm::vec3(0.2f);
 }
\ No newline at end of file
@@ -6,22 +6,21 @@ struct Material {
     float shininess;
 };
 
+// The light structs are laid out to match the std140 structs in uniformBlocks.h: each vec3 is followed by a float
+// that fills out its 16 bytes, with the attenuation terms and cut offs put to use there.
 struct SpotLight {
-    // Orientation
+    // Orientation, and attenuation
     vec3 position;
+    float constant;
     vec3 direction;
+    float linear;
 
-    // Color
+    // Color, and cone
     vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-
-    // Attentuation
-    float constant;
-    float linear;
     float quadratic;
-
+    vec3 diffuse;
     float innerCutOff;
+    vec3 specular;
     float outerCutOff;
 };
 
@@ -29,25 +28,30 @@ struct PointLight {
     // Orientation
     vec3 position;
 
-    // Color
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-
     // Attentuation
     float constant;
+
+    // Color
+    vec3 ambient;
     float linear;
+    vec3 diffuse;
     float quadratic;
+    vec3 specular;
+    float padding;
 };
 
 struct DirectionalLight {
     // Orientation
     vec3 direction;
+    float padding0;
 
     // Color
     vec3 ambient;
+    float padding1;
     vec3 diffuse;
+    float padding2;
     vec3 specular;
+    float padding3;
 };
 
 in vec3 FragPos;
@@ -55,19 +59,34 @@ in vec3 Normal;
 in vec2 TexCoords;
 
 uniform Material material;
-uniform SpotLight spotLight;
-uniform DirectionalLight directionalLight;
 
-#define NR_POINT_LIGHTS 4 
-uniform PointLight pointLights[NR_POINT_LIGHTS];
+// Shared by every program, see LightBlockData in uniformBlocks.h
+layout (std140) uniform LightBlock
+{
+    DirectionalLight directionalLight;
+    SpotLight spotLight;
+    int pointLightCount;
+    int pointLightCapacity;
+};
+
+// Every point light, as four streams of pointLightCapacity vec4s, one per row of PointLight (see LightManager)
+uniform samplerBuffer pointLightData;
 
-uniform vec3 viewPos;
+// Shared by every program, see CameraBlockData in uniformBlocks.h
+layout (std140) uniform CameraBlock
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec3 viewPos;
+};
 
 out vec4 FragColor;
 
 vec3 ProcessDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir, vec3 diffuseTexture, vec3 specularTexture);
 vec3 ProcessPointLight(PointLight light, vec3 normal, vec3 viewDir, vec3 diffuseTexture, vec3 specularTexture);
 vec3 ProcessSpotLight(SpotLight light, vec3 normal, vec3 viewDir, vec3 diffuseTexture, vec3 specularTexture);
+PointLight FetchPointLight(int index);
 
 void main()
 {
@@ -79,14 +98,25 @@ void main()
     vec3 lightAdjustedColor = ProcessDirectionalLight(directionalLight, normal, viewDir, diffuseTexture, specularTexture);
     lightAdjustedColor += ProcessSpotLight(spotLight, normal, viewDir, diffuseTexture, specularTexture);
 
-    for (int i = 0; i < NR_POINT_LIGHTS; i++)
+    for (int i = 0; i < pointLightCount; i++)
     {
-        lightAdjustedColor += ProcessPointLight(pointLights[i], normal, viewDir, diffuseTexture, specularTexture);
+        lightAdjustedColor += ProcessPointLight(FetchPointLight(i), normal, viewDir, diffuseTexture, specularTexture);
     }
 
     FragColor = vec4(lightAdjustedColor, 1.0);
 }
 
+PointLight FetchPointLight(int index)
+{
+    vec4 positionConstant = texelFetch(pointLightData, index);
+    vec4 ambientLinear = texelFetch(pointLightData, pointLightCapacity + index);
+    vec4 diffuseQuadratic = texelFetch(pointLightData, 2 * pointLightCapacity + index);
+    vec4 specular = texelFetch(pointLightData, 3 * pointLightCapacity + index);
+
+    return PointLight(positionConstant.xyz, positionConstant.w, ambientLinear.xyz, ambientLinear.w,
+        diffuseQuadratic.xyz, diffuseQuadratic.w, specular.xyz, 0.0f);
+}
+
 vec3 ProcessDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir, vec3 diffuseTexture, vec3 specularTexture)
 {
     // Ambient
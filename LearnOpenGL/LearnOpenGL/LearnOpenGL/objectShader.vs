@@ -4,10 +4,23 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 
+// Built with INSTANCED defined (see InstanceBuffer), each instance brings its own transforms as attributes
+#ifdef INSTANCED
+layout (location = 4) in mat4 instanceModel;
+layout (location = 8) in mat3 instanceNormalModel;
+#else
 uniform mat4 model;
 uniform mat3 normalModel;
-uniform mat4 view;
-uniform mat4 projection;
+#endif
+
+// Shared by every program, see CameraBlockData in uniformBlocks.h
+layout (std140) uniform CameraBlock
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec3 viewPos;
+};
 
 out vec3 FragPos;
 out vec3 Normal;
@@ -15,8 +28,13 @@ out vec2 TexCoords;
 
 void main()
 {
+#ifdef INSTANCED
+    mat4 model = instanceModel;
+    mat3 normalModel = instanceNormalModel;
+#endif
+
     vec4 aPosV4 = vec4(aPos, 1.0f);
-    gl_Position = projection * view * model * aPosV4;
+    gl_Position = viewProjection * model * aPosV4;
     FragPos = vec3(model * aPosV4);
     Normal = normalModel * aNormal;
     TexCoords = aTexCoords;
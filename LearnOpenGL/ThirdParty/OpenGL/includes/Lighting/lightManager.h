@@ -0,0 +1,314 @@
+#ifndef LIGHT_MANAGER_H
+#define LIGHT_MANAGER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <Rendering/glStateCache.h>
+#include <Shaders/uniformBlocks.h>
+#include <Shaders/uniformRingBuffer.h>
+#include <vector>
+
+// Point lights a LightManager makes room for up front (it grows past this as needed)
+const size_t LIGHT_MANAGER_INITIAL_CAPACITY = 1024;
+
+// Dirty lights closer together than this are uploaded as one range, rather than paying for another call
+const size_t LIGHT_UPLOAD_MERGE_GAP = 16;
+
+// What the last LightManager::upload() sent to the GPU
+struct LightUploadStats
+{
+    size_t uploadCount = 0;
+    size_t uploadedBytes = 0;
+    bool blockUploaded = false;
+};
+
+// Owns the scene's lights and keeps the GPU's copy of them up to date, sending only what changed.
+//
+// The directional light, the spotlight and the point light count go in the shared LightBlock. Point lights don't, a
+// uniform block only guarantees 16 KB, so they live in a texture buffer instead (sampled as pointLightData from
+// POINT_LIGHT_TEXTURE_UNIT), which holds as many as we like.
+//
+// Point lights are kept as a structure of arrays, one stream of vec4s per PointLightData row: position and constant,
+// ambient and linear, diffuse and quadratic, specular. The texture buffer has the same four streams back to back,
+// each pointLightCapacity long, so moving a light only dirties its slot in the position stream. Every stream tracks
+// which of its lights changed, and upload() sends each run of them with one glBufferSubData. Nothing changed, nothing
+// is sent: a static scene costs no uploads at all.
+//
+// Like everything else that owns GL objects, only use this from the thread the GL context is current on.
+class LightManager
+{
+public:
+    explicit LightManager(size_t initialCapacity = LIGHT_MANAGER_INITIAL_CAPACITY)
+        : blockBuffer(LIGHT_BLOCK_BINDING, sizeof(LightBlockData))
+    {
+        glGenBuffers(1, &this->pointLightBuffer);
+        glGenTextures(1, &this->pointLightTexture);
+        this->reserve(std::max<size_t>(initialCapacity, 1));
+    }
+
+    ~LightManager()
+    {
+        GLStateCache::instance().deleteTexture(this->pointLightTexture);
+        GLStateCache::instance().deleteBuffer(this->pointLightBuffer);
+    }
+
+    LightManager(const LightManager&) = delete;
+    LightManager& operator=(const LightManager&) = delete;
+
+    void setDirectionalLight(const DirectionalLightData& light)
+    {
+        if (std::memcmp(&this->block.directionalLight, &light, sizeof(light)) != 0)
+        {
+            this->block.directionalLight = light;
+            this->blockDirty = true;
+        }
+    }
+
+    void setSpotLight(const SpotLightData& light)
+    {
+        if (std::memcmp(&this->block.spotLight, &light, sizeof(light)) != 0)
+        {
+            this->block.spotLight = light;
+            this->blockDirty = true;
+        }
+    }
+
+    // Adds a point light and returns its index
+    unsigned int addPointLight(const PointLightData& light)
+    {
+        if (this->count == this->capacity)
+        {
+            this->reserve(this->capacity * 2);
+        }
+
+        unsigned int index = static_cast<unsigned int>(this->count++);
+        this->setPointLight(index, light);
+        this->block.pointLightCount = static_cast<int32_t>(this->count);
+        this->blockDirty = true;
+        return index;
+    }
+
+    // Removes a point light by moving the last one into its place, so the last light's index becomes index
+    void removePointLight(unsigned int index)
+    {
+        if (index >= this->count)
+        {
+            return;
+        }
+
+        size_t last = --this->count;
+        if (index != last)
+        {
+            for (size_t stream = 0; stream < POINT_LIGHT_STREAMS; stream++)
+            {
+                this->streams[stream].values[index] = this->streams[stream].values[last];
+                this->markDirty(stream, index);
+            }
+        }
+
+        this->block.pointLightCount = static_cast<int32_t>(this->count);
+        this->blockDirty = true;
+    }
+
+    void setPointLight(unsigned int index, const PointLightData& light)
+    {
+        this->setStream(POSITION_STREAM, index, glm::vec4(light.position, light.constant));
+        this->setStream(AMBIENT_STREAM, index, glm::vec4(light.ambient, light.linear));
+        this->setStream(DIFFUSE_STREAM, index, glm::vec4(light.diffuse, light.quadratic));
+        this->setStream(SPECULAR_STREAM, index, glm::vec4(light.specular, 0.0f));
+    }
+
+    // The common case for a moving light, only touches the position stream
+    void setPointLightPosition(unsigned int index, const glm::vec3& position)
+    {
+        float constant = this->streams[POSITION_STREAM].values[index].w;
+        this->setStream(POSITION_STREAM, index, glm::vec4(position, constant));
+    }
+
+    PointLightData pointLight(unsigned int index) const
+    {
+        const glm::vec4& position = this->streams[POSITION_STREAM].values[index];
+        const glm::vec4& ambient = this->streams[AMBIENT_STREAM].values[index];
+        const glm::vec4& diffuse = this->streams[DIFFUSE_STREAM].values[index];
+
+        PointLightData light;
+        light.position = glm::vec3(position);
+        light.constant = position.w;
+        light.ambient = glm::vec3(ambient);
+        light.linear = ambient.w;
+        light.diffuse = glm::vec3(diffuse);
+        light.quadratic = diffuse.w;
+        light.specular = glm::vec3(this->streams[SPECULAR_STREAM].values[index]);
+        return light;
+    }
+
+    size_t pointLightCount() const
+    {
+        return this->count;
+    }
+
+    // Sends whatever changed since the last call to the GPU and binds the point light buffer. Call once a frame,
+    // before drawing anything lit.
+    void upload()
+    {
+        this->lastStats = LightUploadStats();
+
+        GLStateCache::instance().bindBuffer(GL_TEXTURE_BUFFER, this->pointLightBuffer);
+        for (size_t stream = 0; stream < POINT_LIGHT_STREAMS; stream++)
+        {
+            this->uploadStream(stream);
+        }
+
+        // The ring buffer keeps the last block bound, so an unchanged block doesn't need writing again
+        if (this->blockDirty)
+        {
+            this->blockBuffer.update(this->block);
+            this->blockDirty = false;
+            this->lastStats.blockUploaded = true;
+            this->lastStats.uploadedBytes += sizeof(LightBlockData);
+        }
+
+        GLStateCache::instance().bindTexture(POINT_LIGHT_TEXTURE_UNIT, GL_TEXTURE_BUFFER, this->pointLightTexture);
+    }
+
+    const LightUploadStats& lastUploadStats() const
+    {
+        return this->lastStats;
+    }
+
+private:
+    enum PointLightStream
+    {
+        POSITION_STREAM,
+        AMBIENT_STREAM,
+        DIFFUSE_STREAM,
+        SPECULAR_STREAM,
+        POINT_LIGHT_STREAMS
+    };
+
+    // One row of every point light, plus which of them changed since the last upload. dirtyBegin/dirtyEnd bound the
+    // changed ones so upload() doesn't have to look at the rest.
+    struct Stream
+    {
+        std::vector<glm::vec4> values;
+        std::vector<unsigned char> dirty;
+        size_t dirtyBegin = 0;
+        size_t dirtyEnd = 0;
+    };
+
+    Stream streams[POINT_LIGHT_STREAMS];
+    size_t count = 0;
+    size_t capacity = 0;
+
+    GLuint pointLightBuffer = 0;
+    GLuint pointLightTexture = 0;
+
+    LightBlockData block;
+    UniformRingBuffer blockBuffer;
+    bool blockDirty = true;
+
+    LightUploadStats lastStats;
+
+    void setStream(size_t stream, unsigned int index, const glm::vec4& value)
+    {
+        glm::vec4& current = this->streams[stream].values[index];
+        if (current != value)
+        {
+            current = value;
+            this->markDirty(stream, index);
+        }
+    }
+
+    void markDirty(size_t stream, size_t index)
+    {
+        Stream& target = this->streams[stream];
+        if (target.dirtyBegin == target.dirtyEnd)
+        {
+            target.dirtyBegin = index;
+            target.dirtyEnd = index + 1;
+        }
+        else
+        {
+            target.dirtyBegin = std::min(target.dirtyBegin, index);
+            target.dirtyEnd = std::max(target.dirtyEnd, index + 1);
+        }
+
+        target.dirty[index] = 1;
+    }
+
+    // Uploads each run of dirty lights in the stream, merging runs separated by only a few clean ones
+    void uploadStream(size_t stream)
+    {
+        Stream& source = this->streams[stream];
+        size_t end = std::min(source.dirtyEnd, this->count);
+        size_t i = source.dirtyBegin;
+        while (i < end)
+        {
+            if (!source.dirty[i])
+            {
+                i++;
+                continue;
+            }
+
+            size_t runBegin = i, runEnd = i + 1, clean = 0;
+            for (i = runBegin + 1; i < end && clean < LIGHT_UPLOAD_MERGE_GAP; i++)
+            {
+                if (source.dirty[i])
+                {
+                    runEnd = i + 1;
+                    clean = 0;
+                }
+                else
+                {
+                    clean++;
+                }
+            }
+
+            GLintptr offset = static_cast<GLintptr>((stream * this->capacity + runBegin) * sizeof(glm::vec4));
+            GLsizeiptr size = static_cast<GLsizeiptr>((runEnd - runBegin) * sizeof(glm::vec4));
+            glBufferSubData(GL_TEXTURE_BUFFER, offset, size, &source.values[runBegin]);
+            std::fill(source.dirty.begin() + runBegin, source.dirty.begin() + runEnd, 0);
+
+            this->lastStats.uploadCount++;
+            this->lastStats.uploadedBytes += static_cast<size_t>(size);
+            i = runEnd;
+        }
+
+        // Lights removed since they were marked can leave flags past the end behind
+        std::fill(source.dirty.begin() + source.dirtyBegin, source.dirty.begin() + source.dirtyEnd, 0);
+        source.dirtyBegin = source.dirtyEnd = 0;
+    }
+
+    // Grows every stream and the texture buffer to hold newCapacity lights. The streams' offsets in the buffer
+    // depend on the capacity, so everything is sent again.
+    void reserve(size_t newCapacity)
+    {
+        this->capacity = newCapacity;
+        for (size_t stream = 0; stream < POINT_LIGHT_STREAMS; stream++)
+        {
+            Stream& target = this->streams[stream];
+            target.values.resize(newCapacity, glm::vec4(0.0f));
+            target.dirty.assign(newCapacity, 0);
+            target.dirtyBegin = target.dirtyEnd = 0;
+            for (size_t i = 0; i < this->count; i++)
+            {
+                this->markDirty(stream, i);
+            }
+        }
+
+        GLStateCache::instance().bindBuffer(GL_TEXTURE_BUFFER, this->pointLightBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, static_cast<GLsizeiptr>(newCapacity * POINT_LIGHT_STREAMS * sizeof(glm::vec4)), nullptr, GL_DYNAMIC_DRAW);
+        GLStateCache::instance().bindTexture(GL_TEXTURE_BUFFER, this->pointLightTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, this->pointLightBuffer);
+        GLStateCache::instance().bindTexture(GL_TEXTURE_BUFFER, 0);
+        GLStateCache::instance().bindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        this->block.pointLightCapacity = static_cast<int32_t>(newCapacity);
+        this->blockDirty = true;
+    }
+};
+
+#endif
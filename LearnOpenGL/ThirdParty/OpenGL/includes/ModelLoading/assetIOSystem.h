@@ -0,0 +1,131 @@
+#ifndef ASSET_IO_SYSTEM_H
+#define ASSET_IO_SYSTEM_H
+
+#include <algorithm>
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <Utility/assets.h>
+
+using namespace std;
+
+// Assimp stream over an asset's bytes, which are already in memory: mapped straight from the loose file or an
+// archive, or decompressed out of one. Reads are a single memcpy, and seeks and sizes never touch the OS, unlike
+// Assimp's default stream, which goes through buffered stdio for every read.
+class AssetIOStream : public Assimp::IOStream
+{
+    public:
+        explicit AssetIOStream(AssetData&& asset) : asset(std::move(asset))
+        {
+        }
+
+        size_t Read(void* buffer, size_t size, size_t count) override
+        {
+            if (size == 0)
+            {
+                return 0;
+            }
+
+            size_t readCount = min(count, (this->asset.size() - this->position) / size);
+            memcpy(buffer, this->asset.data() + this->position, readCount * size);
+            this->position += readCount * size;
+            return readCount;
+        }
+
+        // Assets are read-only
+        size_t Write(const void*, size_t, size_t) override
+        {
+            return 0;
+        }
+
+        aiReturn Seek(size_t offset, aiOrigin origin) override
+        {
+            size_t size = this->asset.size();
+            size_t target;
+            if (origin == aiOrigin_SET && offset <= size)
+            {
+                target = offset;
+            }
+            else if (origin == aiOrigin_END && offset <= size)
+            {
+                target = size - offset;
+            }
+            else if (origin == aiOrigin_CUR && offset <= size - this->position)
+            {
+                target = this->position + offset;
+            }
+            else
+            {
+                return aiReturn_FAILURE;
+            }
+
+            this->position = target;
+            return aiReturn_SUCCESS;
+        }
+
+        size_t Tell() const override
+        {
+            return this->position;
+        }
+
+        size_t FileSize() const override
+        {
+            return this->asset.size();
+        }
+
+        void Flush() override
+        {
+        }
+
+    private:
+        AssetData asset;
+        size_t position = 0;
+};
+
+// Lets Assimp open files through Assets, so models and everything they reference (an OBJ's .mtl, say) resolve as
+// logical names, from a packed archive or memory-mapped loose files. Hand one to Importer::SetIOHandler, which takes
+// ownership of it.
+class AssetIOSystem : public Assimp::IOSystem
+{
+    public:
+        bool Exists(const char* file) const override
+        {
+            return Assets::instance().exists(file);
+        }
+
+        char getOsSeparator() const override
+        {
+            return '/';
+        }
+
+        Assimp::IOStream* Open(const char* file, const char* mode = "rb") override
+        {
+            // Nothing we import ever writes
+            if (strchr(mode, 'w') || strchr(mode, 'a'))
+            {
+                return nullptr;
+            }
+
+            AssetData asset = Assets::instance().read(file);
+            if (!asset.isOpen())
+            {
+                return nullptr;
+            }
+
+            return new AssetIOStream(std::move(asset));
+        }
+
+        void Close(Assimp::IOStream* file) override
+        {
+            delete file;
+        }
+
+        bool ComparePaths(const char* one, const char* second) const override
+        {
+            return normalizeAssetName(one) == normalizeAssetName(second);
+        }
+};
+
+#endif
@@ -0,0 +1,209 @@
+#ifndef BOUNDING_VOLUME_H
+#define BOUNDING_VOLUME_H
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <ModelLoading/vertex.h>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define BOUNDING_VOLUME_SSE2
+    #include <emmintrin.h>
+#endif
+
+using namespace std;
+
+// Model space extent of a mesh (or a whole Model): the tight axis aligned box around its vertices, plus a sphere
+// around the box's center just big enough to hold every vertex, which is usually well inside the box's own bounding
+// sphere. The box is the better fit for frustum tests, the sphere is cheaper and doesn't care about rotation.
+//
+// Only glm::vec3s and a float, so it's written to the mesh cache as is.
+struct BoundingVolume
+{
+    // boundsMin > boundsMax means no vertices at all (see isEmpty())
+    glm::vec3 boundsMin = glm::vec3(FLT_MAX);
+    glm::vec3 boundsMax = glm::vec3(-FLT_MAX);
+
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+
+    bool isEmpty() const
+    {
+        return this->boundsMin.x > this->boundsMax.x;
+    }
+
+    glm::vec3 size() const
+    {
+        return this->isEmpty() ? glm::vec3(0.0f) : this->boundsMax - this->boundsMin;
+    }
+
+    // Grows this to also enclose other, e.g. to combine a Model's meshes. The sphere is the smallest one holding
+    // both spheres, not a refit to the vertices, so a combined sphere can be a little looser than a computed one.
+    void merge(const BoundingVolume& other)
+    {
+        if (other.isEmpty())
+        {
+            return;
+        }
+
+        if (this->isEmpty())
+        {
+            *this = other;
+            return;
+        }
+
+        this->boundsMin = glm::min(this->boundsMin, other.boundsMin);
+        this->boundsMax = glm::max(this->boundsMax, other.boundsMax);
+
+        glm::vec3 offset = other.center - this->center;
+        float distance = glm::length(offset);
+        if (distance + other.radius <= this->radius)
+        {
+            return;
+        }
+
+        if (distance + this->radius <= other.radius)
+        {
+            this->center = other.center;
+            this->radius = other.radius;
+            return;
+        }
+
+        float mergedRadius = (distance + this->radius + other.radius) * 0.5f;
+        this->center += offset * ((mergedRadius - this->radius) / distance);
+        this->radius = mergedRadius;
+    }
+
+    // Bounds of these bounds after the given transform, e.g. the model matrix to go to world space. The box is the
+    // box around the transformed box, and the sphere's radius is scaled by the transform's largest axis scale.
+    BoundingVolume transformed(const glm::mat4& transform) const
+    {
+        BoundingVolume result;
+        if (this->isEmpty())
+        {
+            return result;
+        }
+
+        // Each column contributes its smallest and largest product to the new box (Arvo's method)
+        glm::vec3 translation = glm::vec3(transform[3]);
+        result.boundsMin = translation;
+        result.boundsMax = translation;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            glm::vec3 column = glm::vec3(transform[axis]);
+            glm::vec3 a = column * this->boundsMin[axis];
+            glm::vec3 b = column * this->boundsMax[axis];
+            result.boundsMin += glm::min(a, b);
+            result.boundsMax += glm::max(a, b);
+        }
+
+        float scale = max(glm::length(glm::vec3(transform[0])), max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+        result.center = glm::vec3(transform * glm::vec4(this->center, 1.0f));
+        result.radius = this->radius * scale;
+        return result;
+    }
+};
+
+// Computes a mesh's BoundingVolume at import. Both passes over the vertices are SIMD: the box is a min/max reduction
+// over whole positions, the sphere's radius a max reduction over four squared distances at a time.
+class BoundsBuilder
+{
+    public:
+        static BoundingVolume build(const vector<Vertex>& vertices)
+        {
+            BoundingVolume bounds;
+            if (vertices.empty())
+            {
+                return bounds;
+            }
+
+            computeBox(vertices, bounds.boundsMin, bounds.boundsMax);
+            bounds.center = (bounds.boundsMin + bounds.boundsMax) * 0.5f;
+            bounds.radius = sqrt(maxSquaredDistance(vertices, bounds.center));
+            return bounds;
+        }
+
+    private:
+        static void computeBox(const vector<Vertex>& vertices, glm::vec3& boundsMin, glm::vec3& boundsMax)
+        {
+#ifdef BOUNDING_VOLUME_SSE2
+            // Loads 4 floats from each position, the 4th being the normal's x, which is just ignored. Two pairs of
+            // accumulators so consecutive min/max don't wait on each other.
+            const float* first = &vertices[0].position.x;
+            __m128 min0 = _mm_loadu_ps(first), max0 = min0;
+            __m128 min1 = min0, max1 = min0;
+
+            size_t count = vertices.size(), i = 0;
+            for (; i + 2 <= count; i += 2)
+            {
+                __m128 a = _mm_loadu_ps(&vertices[i].position.x);
+                __m128 b = _mm_loadu_ps(&vertices[i + 1].position.x);
+                min0 = _mm_min_ps(min0, a);
+                max0 = _mm_max_ps(max0, a);
+                min1 = _mm_min_ps(min1, b);
+                max1 = _mm_max_ps(max1, b);
+            }
+
+            for (; i < count; i++)
+            {
+                __m128 a = _mm_loadu_ps(&vertices[i].position.x);
+                min0 = _mm_min_ps(min0, a);
+                max0 = _mm_max_ps(max0, a);
+            }
+
+            alignas(16) float minValues[4], maxValues[4];
+            _mm_store_ps(minValues, _mm_min_ps(min0, min1));
+            _mm_store_ps(maxValues, _mm_max_ps(max0, max1));
+            boundsMin = glm::vec3(minValues[0], minValues[1], minValues[2]);
+            boundsMax = glm::vec3(maxValues[0], maxValues[1], maxValues[2]);
+#else
+            boundsMin = vertices[0].position;
+            boundsMax = vertices[0].position;
+            for (const Vertex& vertex : vertices)
+            {
+                boundsMin = glm::min(boundsMin, vertex.position);
+                boundsMax = glm::max(boundsMax, vertex.position);
+            }
+#endif
+        }
+
+        static float maxSquaredDistance(const vector<Vertex>& vertices, const glm::vec3& center)
+        {
+            float maxDistance = 0.0f;
+            size_t count = vertices.size(), i = 0;
+
+#ifdef BOUNDING_VOLUME_SSE2
+            // Four vertices at a time, transposed so each register holds one axis of all four
+            const __m128 centerX = _mm_set1_ps(center.x), centerY = _mm_set1_ps(center.y), centerZ = _mm_set1_ps(center.z);
+            __m128 maxSquared = _mm_setzero_ps();
+            for (; i + 4 <= count; i += 4)
+            {
+                __m128 x = _mm_loadu_ps(&vertices[i].position.x);
+                __m128 y = _mm_loadu_ps(&vertices[i + 1].position.x);
+                __m128 z = _mm_loadu_ps(&vertices[i + 2].position.x);
+                __m128 w = _mm_loadu_ps(&vertices[i + 3].position.x);
+                _MM_TRANSPOSE4_PS(x, y, z, w);
+
+                __m128 dx = _mm_sub_ps(x, centerX), dy = _mm_sub_ps(y, centerY), dz = _mm_sub_ps(z, centerZ);
+                __m128 squared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+                maxSquared = _mm_max_ps(maxSquared, squared);
+            }
+
+            alignas(16) float lanes[4];
+            _mm_store_ps(lanes, maxSquared);
+            maxDistance = max(max(lanes[0], lanes[1]), max(lanes[2], lanes[3]));
+#endif
+
+            for (; i < count; i++)
+            {
+                glm::vec3 offset = vertices[i].position - center;
+                maxDistance = max(maxDistance, glm::dot(offset, offset));
+            }
+
+            return maxDistance;
+        }
+};
+
+#endif
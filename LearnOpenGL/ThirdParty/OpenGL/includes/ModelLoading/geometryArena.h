@@ -0,0 +1,514 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <glad/glad.h>
+#include <ModelLoading/vertex.h>
+#include <Rendering/glStateCache.h>
+#include <vector>
+
+using namespace std;
+
+// Starting size of an arena's buffers. They grow (doubling) as needed.
+const size_t GEOMETRY_ARENA_INITIAL_VERTICES = 1 << 16;
+const size_t GEOMETRY_ARENA_INITIAL_INDEX_BYTES = 1 << 20;
+
+// Every index range starts on a 4 byte boundary so 16 and 32-bit index data can share the buffer
+const size_t GEOMETRY_ARENA_INDEX_ALIGNMENT = 4;
+
+// First-fit allocator for ranges within a buffer. Free ranges are kept sorted by offset and merged with their
+// neighbours when freed, so a fully freed arena goes back to being one big range.
+class ArenaRangeAllocator
+{
+    public:
+        size_t capacity() const
+        {
+            return this->totalSize;
+        }
+
+        size_t freeSize() const
+        {
+            size_t size = 0;
+            for (const Range& range : this->freeRanges)
+            {
+                size += range.size;
+            }
+
+            return size;
+        }
+
+        size_t largestFreeRange() const
+        {
+            size_t largest = 0;
+            for (const Range& range : this->freeRanges)
+            {
+                largest = max(largest, range.size);
+            }
+
+            return largest;
+        }
+
+        // Starts over with everything below usedSize allocated and the rest free
+        void reset(size_t capacity, size_t usedSize)
+        {
+            this->totalSize = capacity;
+            this->freeRanges.clear();
+            if (usedSize < capacity)
+            {
+                this->freeRanges.push_back({ usedSize, capacity - usedSize });
+            }
+        }
+
+        bool allocate(size_t size, size_t& offset)
+        {
+            for (size_t i = 0; i < this->freeRanges.size(); i++)
+            {
+                Range& range = this->freeRanges[i];
+                if (range.size < size)
+                {
+                    continue;
+                }
+
+                offset = range.offset;
+                range.offset += size;
+                range.size -= size;
+                if (range.size == 0)
+                {
+                    this->freeRanges.erase(this->freeRanges.begin() + i);
+                }
+
+                return true;
+            }
+
+            return false;
+        }
+
+        void free(size_t offset, size_t size)
+        {
+            if (size == 0)
+            {
+                return;
+            }
+
+            auto next = lower_bound(this->freeRanges.begin(), this->freeRanges.end(), offset,
+                [](const Range& range, size_t value) { return range.offset < value; });
+            auto inserted = this->freeRanges.insert(next, { offset, size });
+
+            // Merge with the following range, then the preceding one
+            auto following = inserted + 1;
+            if (following != this->freeRanges.end() && inserted->offset + inserted->size == following->offset)
+            {
+                inserted->size += following->size;
+                inserted = this->freeRanges.erase(following) - 1;
+            }
+
+            if (inserted != this->freeRanges.begin())
+            {
+                auto preceding = inserted - 1;
+                if (preceding->offset + preceding->size == inserted->offset)
+                {
+                    preceding->size += inserted->size;
+                    this->freeRanges.erase(inserted);
+                }
+            }
+        }
+
+    private:
+        struct Range
+        {
+            size_t offset;
+            size_t size;
+        };
+
+        size_t totalSize = 0;
+        vector<Range> freeRanges;
+};
+
+struct GeometryArenaStats
+{
+    size_t allocationCount = 0;
+
+    size_t vertexCapacity = 0;
+    size_t verticesUsed = 0;
+    size_t indexCapacityBytes = 0;
+    size_t indexBytesUsed = 0;
+
+    // 1 - (largest free range / total free space). 0 means all the free space is in one piece.
+    float vertexFragmentation = 0.0f;
+    float indexFragmentation = 0.0f;
+
+    float vertexOccupancy() const
+    {
+        return this->vertexCapacity > 0 ? float(this->verticesUsed) / float(this->vertexCapacity) : 0.0f;
+    }
+
+    float indexOccupancy() const
+    {
+        return this->indexCapacityBytes > 0 ? float(this->indexBytesUsed) / float(this->indexCapacityBytes) : 0.0f;
+    }
+};
+
+// One big vertex buffer and index buffer shared by every Mesh with the same vertex format.
+//
+// Each mesh gets a sub-range of both buffers and draws with glDrawElementsBaseVertex, so its indices stay relative
+// to its own vertices. Since all meshes share a single VAO, drawing a whole scene only needs one VAO bind per vertex
+// format instead of one per mesh.
+//
+// Allocations are referred to by handle rather than offset, because compact() (and growing the buffers) move them.
+// Only use this from the thread the GL context is current on.
+class GeometryArena
+{
+    public:
+        static constexpr unsigned int INVALID_ALLOCATION = ~0u;
+
+        static GeometryArena& instance(VertexFormat format)
+        {
+            static GeometryArena floatArena(VertexFormat::Float);
+            static GeometryArena quantizedArena(VertexFormat::Quantized);
+            return format == VertexFormat::Quantized ? quantizedArena : floatArena;
+        }
+
+        GeometryArena(const GeometryArena&) = delete;
+        GeometryArena& operator=(const GeometryArena&) = delete;
+
+        // Copies a mesh's vertices (vertexCount vertices in this arena's format) and already packed indices into the
+        // arena, growing it if needed. Returns the allocation's handle.
+        unsigned int allocate(const void* vertexData, size_t vertexCount, const void* indexData, size_t indexBytes)
+        {
+            size_t alignedIndexBytes = alignIndexBytes(indexBytes);
+
+            Allocation allocation;
+            allocation.vertexCount = vertexCount;
+            allocation.indexBytes = alignedIndexBytes;
+
+            if (!this->tryAllocate(allocation))
+            {
+                // Doubling keeps the number of (full buffer copy) grows logarithmic in the final size
+                size_t vertexCapacity = max(this->vertexRanges.capacity(), GEOMETRY_ARENA_INITIAL_VERTICES);
+                size_t indexCapacity = max(this->indexRanges.capacity(), GEOMETRY_ARENA_INITIAL_INDEX_BYTES);
+                size_t verticesNeeded = this->usedVertices() + vertexCount;
+                size_t indexBytesNeeded = this->usedIndexBytes() + alignedIndexBytes;
+
+                while (vertexCapacity < verticesNeeded)
+                {
+                    vertexCapacity *= 2;
+                }
+                while (indexCapacity < indexBytesNeeded)
+                {
+                    indexCapacity *= 2;
+                }
+
+                // If the arena was big enough overall and just too fragmented, this compacts it at the same size
+                this->rebuild(vertexCapacity, indexCapacity);
+
+                this->tryAllocate(allocation);
+            }
+
+            GLStateCache::instance().bindBuffer(GL_COPY_WRITE_BUFFER, this->VBO);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.vertexOffset * this->stride(), vertexCount * this->stride(), vertexData);
+            GLStateCache::instance().bindBuffer(GL_COPY_WRITE_BUFFER, this->EBO);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.indexOffset, indexBytes, indexData);
+            GLStateCache::instance().bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+            allocation.live = true;
+
+            unsigned int handle;
+            if (!this->freeHandles.empty())
+            {
+                handle = this->freeHandles.back();
+                this->freeHandles.pop_back();
+                this->allocations[handle] = allocation;
+            }
+            else
+            {
+                handle = static_cast<unsigned int>(this->allocations.size());
+                this->allocations.push_back(allocation);
+            }
+
+            return handle;
+        }
+
+        // Gives an allocation's ranges back to the arena. The space is reused by later allocations, or reclaimed
+        // all at once by compact().
+        void free(unsigned int handle)
+        {
+            if (handle >= this->allocations.size() || !this->allocations[handle].live)
+            {
+                return;
+            }
+
+            Allocation& allocation = this->allocations[handle];
+            this->vertexRanges.free(allocation.vertexOffset, allocation.vertexCount);
+            this->indexRanges.free(allocation.indexOffset, allocation.indexBytes);
+            allocation.live = false;
+            this->freeHandles.push_back(handle);
+        }
+
+        // Packs every live allocation to the front of freshly sized buffers, leaving headroom of half the used size.
+        // Worth doing after unloading models, once the free space has been chopped up.
+        void compact()
+        {
+            if (this->VAO == 0)
+            {
+                return;
+            }
+
+            size_t vertexCapacity = max(GEOMETRY_ARENA_INITIAL_VERTICES, this->usedVertices() + this->usedVertices() / 2);
+            size_t indexCapacity = max(GEOMETRY_ARENA_INITIAL_INDEX_BYTES, alignIndexBytes(this->usedIndexBytes() + this->usedIndexBytes() / 2));
+            this->rebuild(vertexCapacity, indexCapacity);
+        }
+
+        // compact()s if enough of the arena is free and scattered to make it worthwhile. An arena with nothing left in
+        // it gives all of its memory back.
+        void compactIfFragmented(float maxFragmentation = 0.5f)
+        {
+            GeometryArenaStats currentStats = this->stats();
+            if (currentStats.allocationCount == 0)
+            {
+                this->freeResources();
+                return;
+            }
+
+            bool mostlyEmpty = currentStats.vertexOccupancy() < 0.25f && currentStats.vertexCapacity > GEOMETRY_ARENA_INITIAL_VERTICES;
+            if (mostlyEmpty || currentStats.vertexFragmentation > maxFragmentation || currentStats.indexFragmentation > maxFragmentation)
+            {
+                this->compact();
+            }
+        }
+
+        void bind() const
+        {
+            GLStateCache::instance().bindVertexArray(this->VAO);
+        }
+
+        // Points whichever VAO is bound at the arena's buffers, with the arena's vertex layout. For VAOs that add
+        // their own attributes on top, like an InstanceBuffer's.
+        void setupAttributes() const
+        {
+            GLStateCache::instance().bindBuffer(GL_ARRAY_BUFFER, this->VBO);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->EBO);
+
+            const VertexLayout& layout = vertexLayoutFor(this->format);
+            for (const VertexAttribute& attribute : layout.attributes)
+            {
+                glEnableVertexAttribArray(attribute.location);
+                glVertexAttribPointer(attribute.location, attribute.components, attribute.type, attribute.normalized,
+                    layout.stride, (void*)attribute.offset);
+            }
+        }
+
+        // Changes whenever the arena's buffers are replaced, which leaves any VAO set up with setupAttributes()
+        // pointing at the old ones
+        unsigned int bufferVersion() const
+        {
+            return this->version;
+        }
+
+        GLint baseVertex(unsigned int handle) const
+        {
+            return static_cast<GLint>(this->allocations[handle].vertexOffset);
+        }
+
+        // Byte offset of the allocation's indices, in the form glDrawElements* wants it
+        const void* indexOffset(unsigned int handle) const
+        {
+            return reinterpret_cast<const void*>(this->allocations[handle].indexOffset);
+        }
+
+        GeometryArenaStats stats() const
+        {
+            GeometryArenaStats arenaStats;
+            arenaStats.allocationCount = this->allocations.size() - this->freeHandles.size();
+            arenaStats.vertexCapacity = this->vertexRanges.capacity();
+            arenaStats.verticesUsed = this->usedVertices();
+            arenaStats.indexCapacityBytes = this->indexRanges.capacity();
+            arenaStats.indexBytesUsed = this->usedIndexBytes();
+            arenaStats.vertexFragmentation = fragmentation(this->vertexRanges);
+            arenaStats.indexFragmentation = fragmentation(this->indexRanges);
+            return arenaStats;
+        }
+
+        // Deletes the GL objects. Every allocation is gone afterwards, the next allocate() starts a new arena.
+        void freeResources()
+        {
+            if (this->VAO != 0)
+            {
+                GLStateCache::instance().deleteVertexArray(this->VAO);
+            }
+            if (this->VBO != 0)
+            {
+                GLStateCache::instance().deleteBuffer(this->VBO);
+            }
+            if (this->EBO != 0)
+            {
+                GLStateCache::instance().deleteBuffer(this->EBO);
+            }
+
+            this->VAO = this->VBO = this->EBO = 0;
+            this->version++;
+            this->allocations.clear();
+            this->freeHandles.clear();
+            this->vertexRanges.reset(0, 0);
+            this->indexRanges.reset(0, 0);
+        }
+
+    private:
+        struct Allocation
+        {
+            // In vertices
+            size_t vertexOffset = 0;
+            size_t vertexCount = 0;
+
+            // In bytes
+            size_t indexOffset = 0;
+            size_t indexBytes = 0;
+
+            bool live = false;
+        };
+
+        VertexFormat format;
+        unsigned int VAO = 0, VBO = 0, EBO = 0;
+        unsigned int version = 0;
+
+        ArenaRangeAllocator vertexRanges;
+        ArenaRangeAllocator indexRanges;
+
+        // Indexed by handle. Freed slots are recycled through freeHandles.
+        vector<Allocation> allocations;
+        vector<unsigned int> freeHandles;
+
+        GeometryArena(VertexFormat format)
+            : format(format)
+        {
+        }
+
+        size_t stride() const
+        {
+            return vertexLayoutFor(this->format).stride;
+        }
+
+        size_t usedVertices() const
+        {
+            return this->vertexRanges.capacity() - this->vertexRanges.freeSize();
+        }
+
+        size_t usedIndexBytes() const
+        {
+            return this->indexRanges.capacity() - this->indexRanges.freeSize();
+        }
+
+        bool tryAllocate(Allocation& allocation)
+        {
+            if (!this->vertexRanges.allocate(allocation.vertexCount, allocation.vertexOffset))
+            {
+                return false;
+            }
+
+            if (!this->indexRanges.allocate(allocation.indexBytes, allocation.indexOffset))
+            {
+                this->vertexRanges.free(allocation.vertexOffset, allocation.vertexCount);
+                return false;
+            }
+
+            return true;
+        }
+
+        // Moves every live allocation, in their current order, to the front of new buffers of the given size
+        void rebuild(size_t vertexCapacity, size_t indexCapacity)
+        {
+            size_t vertexStride = this->stride();
+
+            unsigned int newVBO, newEBO;
+            glGenBuffers(1, &newVBO);
+            glGenBuffers(1, &newEBO);
+
+            GLStateCache::instance().bindBuffer(GL_COPY_WRITE_BUFFER, newVBO);
+            glBufferData(GL_COPY_WRITE_BUFFER, vertexCapacity * vertexStride, nullptr, GL_STATIC_DRAW);
+            GLStateCache::instance().bindBuffer(GL_COPY_WRITE_BUFFER, newEBO);
+            glBufferData(GL_COPY_WRITE_BUFFER, indexCapacity, nullptr, GL_STATIC_DRAW);
+
+            vector<unsigned int> liveHandles;
+            for (unsigned int handle = 0; handle < this->allocations.size(); handle++)
+            {
+                if (this->allocations[handle].live)
+                {
+                    liveHandles.push_back(handle);
+                }
+            }
+
+            sort(liveHandles.begin(), liveHandles.end(), [this](unsigned int a, unsigned int b)
+            {
+                return this->allocations[a].vertexOffset < this->allocations[b].vertexOffset;
+            });
+
+            // The copies stay on the GPU, nothing comes back to the CPU
+            size_t vertexCursor = 0, indexCursor = 0;
+            for (unsigned int handle : liveHandles)
+            {
+                Allocation& allocation = this->allocations[handle];
+
+                GLStateCache::instance().bindBuffer(GL_COPY_READ_BUFFER, this->VBO);
+                GLStateCache::instance().bindBuffer(GL_COPY_WRITE_BUFFER, newVBO);
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, allocation.vertexOffset * vertexStride,
+                    vertexCursor * vertexStride, allocation.vertexCount * vertexStride);
+
+                GLStateCache::instance().bindBuffer(GL_COPY_READ_BUFFER, this->EBO);
+                GLStateCache::instance().bindBuffer(GL_COPY_WRITE_BUFFER, newEBO);
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, allocation.indexOffset, indexCursor, allocation.indexBytes);
+
+                allocation.vertexOffset = vertexCursor;
+                allocation.indexOffset = indexCursor;
+                vertexCursor += allocation.vertexCount;
+                indexCursor += allocation.indexBytes;
+            }
+
+            GLStateCache::instance().bindBuffer(GL_COPY_READ_BUFFER, 0);
+            GLStateCache::instance().bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+            if (this->VBO != 0)
+            {
+                GLStateCache::instance().deleteBuffer(this->VBO);
+            }
+            if (this->EBO != 0)
+            {
+                GLStateCache::instance().deleteBuffer(this->EBO);
+            }
+
+            this->VBO = newVBO;
+            this->EBO = newEBO;
+            this->vertexRanges.reset(vertexCapacity, vertexCursor);
+            this->indexRanges.reset(indexCapacity, indexCursor);
+
+            this->setupVertexArray();
+        }
+
+        // Points the VAO at the current buffers
+        void setupVertexArray()
+        {
+            if (this->VAO == 0)
+            {
+                glGenVertexArrays(1, &(this->VAO));
+            }
+
+            GLStateCache::instance().bindVertexArray(this->VAO);
+            this->setupAttributes();
+            this->version++;
+
+            GLStateCache::instance().bindVertexArray(0);
+            GLStateCache::instance().bindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+
+        static size_t alignIndexBytes(size_t size)
+        {
+            return (size + GEOMETRY_ARENA_INDEX_ALIGNMENT - 1) / GEOMETRY_ARENA_INDEX_ALIGNMENT * GEOMETRY_ARENA_INDEX_ALIGNMENT;
+        }
+
+        static float fragmentation(const ArenaRangeAllocator& ranges)
+        {
+            size_t freeSize = ranges.freeSize();
+            return freeSize > 0 ? 1.0f - float(ranges.largestFreeRange()) / float(freeSize) : 0.0f;
+        }
+};
+
+#endif
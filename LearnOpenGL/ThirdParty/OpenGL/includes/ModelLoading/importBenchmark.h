@@ -0,0 +1,134 @@
+#ifndef IMPORT_BENCHMARK_H
+#define IMPORT_BENCHMARK_H
+
+#include <algorithm>
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include <iostream>
+#include <ModelLoading/assetIOSystem.h>
+#include <ModelLoading/vertex.h>
+#include <ModelLoading/vertexWelder.h>
+#include <string>
+#include <Utility/assets.h>
+#include <Utility/timer.h>
+#include <vector>
+
+using namespace std;
+
+// Times an Assimp import of the given model both ways: through Assimp's default file system, straight from the loose
+// file, versus through AssetIOSystem. Each is run a few times and the best time kept, so both get a warm page cache
+// and the difference is down to how the bytes reach the parser. No post-processing is asked for, since it would only
+// add the same time to both.
+inline void benchmarkModelImport(const string& path, int runs = 5)
+{
+    string loosePath = Assets::instance().resolvePath(path);
+
+    double bestDefaultTime = -1.0, bestAssetTime = -1.0;
+    for (int run = 0; run < runs; run++)
+    {
+        Timer defaultTimer;
+        Assimp::Importer defaultImporter;
+        bool defaultImported = defaultImporter.ReadFile(loosePath, 0) != nullptr;
+        double defaultTime = defaultTimer.elapsedMilliseconds();
+
+        Timer assetTimer;
+        Assimp::Importer assetImporter;
+        assetImporter.SetIOHandler(new AssetIOSystem());
+        bool assetImported = assetImporter.ReadFile(path, 0) != nullptr;
+        double assetTime = assetTimer.elapsedMilliseconds();
+
+        if (!defaultImported || !assetImported)
+        {
+            // The default path needs a loose file, which a model that's only in an archive doesn't have
+            cout << "ERROR::IMPORT_BENCHMARK::" << path << " failed to import through the "
+                << (defaultImported ? "asset" : "default") << " file system" << endl;
+            return;
+        }
+
+        bestDefaultTime = run == 0 ? defaultTime : min(bestDefaultTime, defaultTime);
+        bestAssetTime = run == 0 ? assetTime : min(bestAssetTime, assetTime);
+    }
+
+    cout << "MODEL::IMPORT_BENCHMARK::" << path << ", best of " << runs << ": default IO " << bestDefaultTime
+        << " ms, AssetIOSystem " << bestAssetTime << " ms" << endl;
+}
+
+// Times our VertexWelder against Assimp's aiProcess_JoinIdenticalVertices on the given model. Assimp's join is timed
+// as the difference between importing with and without it, ours on the meshes of the import without it. Best of a
+// few runs each, like benchmarkModelImport.
+inline void benchmarkVertexWelding(const string& path, int runs = 5)
+{
+    const unsigned int importFlags = aiProcess_Triangulate | aiProcess_FlipUVs;
+
+    double bestImportTime = -1.0, bestJoinedImportTime = -1.0, bestWeldTime = -1.0;
+    size_t vertexCount = 0, joinedVertexCount = 0, weldedVertexCount = 0;
+    for (int run = 0; run < runs; run++)
+    {
+        Timer importTimer;
+        Assimp::Importer importer;
+        importer.SetIOHandler(new AssetIOSystem());
+        const aiScene* scene = importer.ReadFile(path, importFlags);
+        double importTime = importTimer.elapsedMilliseconds();
+
+        Timer joinedImportTimer;
+        Assimp::Importer joinedImporter;
+        joinedImporter.SetIOHandler(new AssetIOSystem());
+        const aiScene* joinedScene = joinedImporter.ReadFile(path, importFlags | aiProcess_JoinIdenticalVertices);
+        double joinedImportTime = joinedImportTimer.elapsedMilliseconds();
+
+        if (!scene || !joinedScene)
+        {
+            cout << "ERROR::IMPORT_BENCHMARK::" << path << " failed to import" << endl;
+            return;
+        }
+
+        // Same conversion Model::processMesh does, but only what the welder looks at
+        vector<vector<Vertex>> meshVertices(scene->mNumMeshes);
+        vector<vector<unsigned int>> meshIndices(scene->mNumMeshes);
+        vertexCount = joinedVertexCount = 0;
+        for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+        {
+            const aiMesh* mesh = scene->mMeshes[i];
+            for (unsigned int v = 0; v < mesh->mNumVertices; v++)
+            {
+                Vertex vertex;
+                vertex.position = glm::vec3(mesh->mVertices[v].x, mesh->mVertices[v].y, mesh->mVertices[v].z);
+                vertex.normal = mesh->mNormals ? glm::vec3(mesh->mNormals[v].x, mesh->mNormals[v].y, mesh->mNormals[v].z) : glm::vec3(0.0f);
+                vertex.texCoords = mesh->mTextureCoords[0] ? glm::vec2(mesh->mTextureCoords[0][v].x, mesh->mTextureCoords[0][v].y) : glm::vec2(0.0f);
+                meshVertices[i].push_back(vertex);
+            }
+
+            for (unsigned int f = 0; f < mesh->mNumFaces; f++)
+            {
+                meshIndices[i].insert(meshIndices[i].end(), mesh->mFaces[f].mIndices, mesh->mFaces[f].mIndices + mesh->mFaces[f].mNumIndices);
+            }
+
+            vertexCount += mesh->mNumVertices;
+        }
+
+        for (unsigned int i = 0; i < joinedScene->mNumMeshes; i++)
+        {
+            joinedVertexCount += joinedScene->mMeshes[i]->mNumVertices;
+        }
+
+        Timer weldTimer;
+        weldedVertexCount = 0;
+        for (size_t i = 0; i < meshVertices.size(); i++)
+        {
+            weldedVertexCount += VertexWelder::weld(meshVertices[i], meshIndices[i]).weldedVertexCount;
+        }
+
+        double weldTime = weldTimer.elapsedMilliseconds();
+
+        bestImportTime = run == 0 ? importTime : min(bestImportTime, importTime);
+        bestJoinedImportTime = run == 0 ? joinedImportTime : min(bestJoinedImportTime, joinedImportTime);
+        bestWeldTime = run == 0 ? weldTime : min(bestWeldTime, weldTime);
+    }
+
+    cout << "MODEL::WELD_BENCHMARK::" << path << ", best of " << runs << ": aiProcess_JoinIdenticalVertices "
+        << bestJoinedImportTime - bestImportTime << " ms (" << vertexCount << " -> " << joinedVertexCount << " vertices), VertexWelder "
+        << bestWeldTime << " ms (" << vertexCount << " -> " << weldedVertexCount << " vertices)" << endl;
+}
+
+#endif
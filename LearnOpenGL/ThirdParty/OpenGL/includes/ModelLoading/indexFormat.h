@@ -0,0 +1,49 @@
+#ifndef INDEX_FORMAT_H
+#define INDEX_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <glad/glad.h>
+#include <vector>
+
+using namespace std;
+
+// Largest number of vertices a mesh can have and still be drawn with 16-bit indices
+const size_t MAX_16_BIT_INDEXED_VERTICES = 65536;
+
+// Narrowest index type that can address vertexCount vertices. Halving the index size halves index memory and the
+// bandwidth the GPU spends fetching indices, so anything that fits gets GL_UNSIGNED_SHORT.
+inline GLenum indexTypeFor(size_t vertexCount)
+{
+    return vertexCount <= MAX_16_BIT_INDEXED_VERTICES ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+inline size_t indexTypeSize(GLenum indexType)
+{
+    return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+// Writes indices into destination converted to the given index type, ready for glBufferData. Several index lists can
+// be packed one after another into the same buffer. destination needs room for indices.size() *
+// indexTypeSize(indexType) bytes, and every index has to fit in the type.
+inline void packIndices(const vector<unsigned int>& indices, GLenum indexType, unsigned char* destination)
+{
+    if (indexType == GL_UNSIGNED_SHORT)
+    {
+        uint16_t* shortIndices = reinterpret_cast<uint16_t*>(destination);
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            shortIndices[i] = static_cast<uint16_t>(indices[i]);
+        }
+    }
+    else
+    {
+        uint32_t* intIndices = reinterpret_cast<uint32_t*>(destination);
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            intIndices[i] = indices[i];
+        }
+    }
+}
+
+#endif
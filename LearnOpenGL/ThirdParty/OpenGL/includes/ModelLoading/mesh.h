@@ -4,31 +4,28 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <ModelLoading/boundingVolume.h>
+#include <ModelLoading/geometryArena.h>
+#include <ModelLoading/indexFormat.h>
+#include <ModelLoading/meshletBuilder.h>
+#include <ModelLoading/modelData.h>
+#include <ModelLoading/vertex.h>
+#include <ModelLoading/vertexQuantization.h>
+#include <Rendering/glStateCache.h>
+#include <Rendering/instanceBuffer.h>
 #include <Shaders/shader.h>
 #include <string>
 #include <vector>
 
 using namespace std;
 
-struct Vertex
-{
-    // Model space position coordinate
-    glm::vec3 position;
-
-    // Model space normal vector
-    glm::vec3 normal;
-
-    // Texture coordinates
-    glm::vec2 texCoords;
-};
-
 struct Texture
 {
     // Texture id
     unsigned int id;
 
     // The name of a texture, in the format of
-    // "texture_diffuseN" or "texture_specularN", where
+    // "texture_diffuseN", "texture_specularN" or "texture_normalN", where
     // N is a number ranging from 1 to the maximum
     // number of textures allowed by OpenGL
     string type;
@@ -37,42 +34,330 @@ struct Texture
     string path;
 };
 
+// A renderable mesh that owns its slice of the shared GeometryArena.
+//
+// Mesh is move-only: its arena allocation is freed when the Mesh is destroyed, so a copy would leave two objects
+// freeing the same allocation. Geometry is moved in rather than copied, and the CPU-side copies can be dropped once
+// they've been uploaded.
 class Mesh
 {
     public:
-        // Mesh data
-        vector<Vertex>       vertices;
-        vector<unsigned int> indices;
-        vector<Texture>      textures;
+        // Mesh data (the vertices and indices are empty after releaseCpuData()).
+        // Only the vertex vector matching format() is filled in, and indices is the full detail level only.
+        vector<Vertex>          vertices;
+        vector<QuantizedVertex> quantizedVertices;
+        vector<unsigned int>    indices;
+        vector<Texture>         textures;
+
+        // Our material's id for sorting draws by (see allocateMaterialIds()), shared by every mesh using the same
+        // material. Set by whoever creates the mesh, 0 if nobody does.
+        unsigned int materialId = 0;
+
+        // Mesh constructor. Takes ownership of the geometry, so pass it in with std::move to avoid a copy.
+        // bounds are the model space bounds of the vertices (see BoundsBuilder), lods the optional simplified index
+        // lists, coarsest last, and meshlets the optional clusters of indices (see MeshletBuilder).
+        Mesh(vector<Vertex>&& vertices, vector<unsigned int>&& indices, vector<Texture> textures, const BoundingVolume& bounds,
+            vector<MeshLod>&& lods = vector<MeshLod>(), vector<MeshletData>&& meshlets = vector<MeshletData>())
+            : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)), meshlets(std::move(meshlets)),
+              boundingVolume(bounds)
+        {
+            this->setupMesh(lods);
+        }
 
-        // Vertex Array Object
-        unsigned int VAO;
+        // Same as above, but for geometry that's already been through VertexQuantizer
+        Mesh(QuantizedVertexData&& quantizedData, vector<unsigned int>&& indices, vector<Texture> textures, const BoundingVolume& bounds,
+            vector<MeshLod>&& lods = vector<MeshLod>(), vector<MeshletData>&& meshlets = vector<MeshletData>())
+            : quantizedVertices(std::move(quantizedData.vertices)), indices(std::move(indices)), textures(std::move(textures)),
+              meshlets(std::move(meshlets)), vertexFormat(VertexFormat::Quantized), positionOffset(quantizedData.positionOffset), positionScale(quantizedData.positionScale),
+              boundingVolume(bounds)
+        {
+            this->setupMesh(lods);
+        }
+
+        ~Mesh()
+        {
+            this->freeResources();
+        }
+
+        Mesh(const Mesh&) = delete;
+        Mesh& operator=(const Mesh&) = delete;
+
+        Mesh(Mesh&& other) noexcept
+            : vertices(std::move(other.vertices)), quantizedVertices(std::move(other.quantizedVertices)), indices(std::move(other.indices)),
+              textures(std::move(other.textures)), materialId(other.materialId), meshlets(std::move(other.meshlets)), allocation(other.allocation), lodRanges(std::move(other.lodRanges)),
+              indexType(other.indexType),
+              vertexFormat(other.vertexFormat), positionOffset(other.positionOffset), positionScale(other.positionScale),
+              boundingVolume(other.boundingVolume), uniforms(std::move(other.uniforms))
+        {
+            other.allocation = GeometryArena::INVALID_ALLOCATION;
+        }
 
-        // Mesh constructor
-        Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+        Mesh& operator=(Mesh&& other) noexcept
         {
-            this->vertices = vertices;
-            this->indices = indices;
-            this->textures = textures;
-            this->setupMesh();
+            if (this != &other)
+            {
+                this->freeResources();
+
+                this->vertices = std::move(other.vertices);
+                this->quantizedVertices = std::move(other.quantizedVertices);
+                this->indices = std::move(other.indices);
+                this->textures = std::move(other.textures);
+                this->materialId = other.materialId;
+                this->meshlets = std::move(other.meshlets);
+                this->allocation = other.allocation;
+                this->lodRanges = std::move(other.lodRanges);
+                this->indexType = other.indexType;
+                this->vertexFormat = other.vertexFormat;
+                this->positionOffset = other.positionOffset;
+                this->positionScale = other.positionScale;
+                this->boundingVolume = other.boundingVolume;
+                this->uniforms = std::move(other.uniforms);
+
+                other.allocation = GeometryArena::INVALID_ALLOCATION;
+            }
+
+            return *this;
         }
 
-        // Renders the mesh
+        // Renders the mesh. Nothing is unbound afterwards, the next draw only rebinds what it needs to change.
         void draw(Shader& shader)
         {
-            unsigned int diffuseIndex = 1,
-                specularIndex = 1;
+            GeometryArena::instance(this->vertexFormat).bind();
+            this->drawInBoundArena(shader);
+        }
+
+        // Renders the given detail level of the mesh (0 is full detail), assuming the GeometryArena for format() is
+        // already bound. Lets a Model draw all of its meshes with a single VAO bind.
+        //
+        // If a culler is given and we're drawing full detail, meshlets facing away from the camera or outside the
+        // frustum are skipped and only the surviving index ranges are drawn, tallying up what was culled in cullingStats.
+        void drawInBoundArena(Shader& shader, unsigned int lod = 0, const MeshletCuller* culler = nullptr, MeshletCullingStats* cullingStats = nullptr)
+        {
+            if (this->allocation == GeometryArena::INVALID_ALLOCATION || this->lodRanges.empty())
+            {
+                return;
+            }
+
+            this->bindMaterial(shader);
+
+            // Render. Our indices are relative to our own vertices, the base vertex offsets them to where those
+            // vertices live in the arena. Every LOD's indices follow the previous one's in the same allocation.
+            const LodRange& range = this->lodRanges[min<size_t>(lod, this->lodRanges.size() - 1)];
+            const GeometryArena& arena = GeometryArena::instance(this->vertexFormat);
+            const char* indexOffset = static_cast<const char*>(arena.indexOffset(this->allocation)) + range.firstIndex * indexTypeSize(this->indexType);
+            if (culler && range.firstIndex == 0 && !this->meshlets.empty())
+            {
+                this->drawVisibleMeshlets(*culler, indexOffset, arena.baseVertex(this->allocation), cullingStats);
+            }
+            else
+            {
+                glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, this->indexType, indexOffset, arena.baseVertex(this->allocation));
+            }
+        }
+
+        // Renders one copy of the given detail level per instance in instances, in a single draw call. The shader has to
+        // be built with INSTANCED_SHADER_DEFINE, so it takes its transforms from the instance attributes.
+        void drawInstanced(Shader& shader, InstanceBuffer& instances, unsigned int lod = 0)
+        {
+            if (this->allocation == GeometryArena::INVALID_ALLOCATION || this->lodRanges.empty() || instances.instanceCount() == 0)
+            {
+                return;
+            }
+
+            GLStateCache::instance().bindVertexArray(instances.vertexArrayFor(this->vertexFormat));
+            this->bindMaterial(shader);
+
+            const LodRange& range = this->lodRanges[min<size_t>(lod, this->lodRanges.size() - 1)];
+            const GeometryArena& arena = GeometryArena::instance(this->vertexFormat);
+            const char* indexOffset = static_cast<const char*>(arena.indexOffset(this->allocation)) + range.firstIndex * indexTypeSize(this->indexType);
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount, this->indexType, indexOffset, instances.instanceCount(),
+                arena.baseVertex(this->allocation));
+        }
+
+        VertexFormat format() const
+        {
+            return this->vertexFormat;
+        }
+
+        // Number of detail levels, including the full detail one
+        unsigned int lodCount() const
+        {
+            return static_cast<unsigned int>(this->lodRanges.size());
+        }
+
+        // Model space distance a LOD's surface can be from the full detail surface (0 for LOD 0)
+        float lodError(unsigned int lod) const
+        {
+            return this->lodRanges[lod].error;
+        }
+
+        unsigned int lodTriangleCount(unsigned int lod) const
+        {
+            return this->lodRanges[lod].indexCount / 3;
+        }
+
+        // Model space box and sphere enclosing every vertex, kept after releaseCpuData()
+        const BoundingVolume& bounds() const
+        {
+            return this->boundingVolume;
+        }
+
+        // Shorthands for the bounding sphere
+        const glm::vec3& center() const
+        {
+            return this->boundingVolume.center;
+        }
+
+        float radius() const
+        {
+            return this->boundingVolume.radius;
+        }
+
+        // Drops the CPU-side copy of the geometry. Everything needed to draw already lives on the GPU,
+        // so this just gives the memory back.
+        void releaseCpuData()
+        {
+            vector<Vertex>().swap(this->vertices);
+            vector<QuantizedVertex>().swap(this->quantizedVertices);
+            vector<unsigned int>().swap(this->indices);
+        }
+
+        // Returns our geometry to the arena. Safe to call more than once (the destructor calls it too).
+        void freeResources()
+        {
+            if (this->allocation != GeometryArena::INVALID_ALLOCATION)
+            {
+                GeometryArena::instance(this->vertexFormat).free(this->allocation);
+            }
+
+            this->allocation = GeometryArena::INVALID_ALLOCATION;
+        }
+
+    private:
+        // Clusters of our full detail indices, kept around (even after releaseCpuData()) for culling
+        vector<MeshletData> meshlets;
+
+        // Scratch space for the multi-draw of visible meshlets, reused every frame
+        vector<GLsizei> meshletDrawCounts;
+        vector<const void*> meshletDrawOffsets;
+        vector<GLint> meshletDrawBaseVertices;
+
+        // Handle of our vertex and index ranges in the GeometryArena
+        unsigned int allocation = GeometryArena::INVALID_ALLOCATION;
+
+        // Where each detail level's indices are within our index allocation. Outlives the CPU-side index vector.
+        struct LodRange
+        {
+            unsigned int firstIndex;
+            unsigned int indexCount;
+            float error;
+        };
+
+        vector<LodRange> lodRanges;
+
+        // GL_UNSIGNED_SHORT whenever the mesh has few enough vertices, otherwise GL_UNSIGNED_INT
+        GLenum indexType = GL_UNSIGNED_INT;
+
+        // How our vertices are laid out (which also picks the arena), plus the bounding box quantized positions are
+        // relative to
+        VertexFormat vertexFormat = VertexFormat::Float;
+        glm::vec3 positionOffset = glm::vec3(0.0f);
+        glm::vec3 positionScale = glm::vec3(1.0f);
+
+        // Computed at import (or read from the mesh cache) from the full precision positions, for LOD selection and culling
+        BoundingVolume boundingVolume;
+
+        // Handles of the uniforms we set in the program we were last drawn with, so drawing doesn't look up (or even
+        // build) uniform names every frame. Resolved again whenever we're drawn with a different program.
+        struct MeshUniforms
+        {
+            unsigned int program = 0;
+
+            // Sampler for each of our textures, e.g. texture_diffuse2 for the second diffuse one
+            vector<UniformHandle> textures;
+            unsigned int normalMapCount = 0;
+
+            UniformHandle hasNormalMap;
+            UniformHandle positionOffset;
+            UniformHandle positionScale;
+            UniformHandle octahedralNormals;
+        };
+
+        MeshUniforms uniforms;
+
+        // Copies our vertices and every detail level's indices into the arena
+        void setupMesh(const vector<MeshLod>& lods)
+        {
+            bool quantized = this->vertexFormat == VertexFormat::Quantized;
+            const void* vertexData = quantized ? (const void*)this->quantizedVertices.data() : (const void*)this->vertices.data();
+            size_t vertexCount = quantized ? this->quantizedVertices.size() : this->vertices.size();
+
+            // All detail levels go into one index allocation, full detail first, each packed straight into its
+            // place in the narrowest type that can address all of our vertices
+            this->indexType = indexTypeFor(vertexCount);
+            size_t indexSize = indexTypeSize(this->indexType);
+
+            size_t indexCount = this->indices.size();
+            for (const MeshLod& lod : lods)
+            {
+                indexCount += lod.indices.size();
+            }
+
+            vector<unsigned char> packedIndices(indexCount * indexSize);
+            packIndices(this->indices, this->indexType, packedIndices.data());
+            this->lodRanges.push_back({ 0, static_cast<unsigned int>(this->indices.size()), 0.0f });
+
+            size_t firstIndex = this->indices.size();
+            for (const MeshLod& lod : lods)
+            {
+                packIndices(lod.indices, this->indexType, packedIndices.data() + firstIndex * indexSize);
+                this->lodRanges.push_back({ static_cast<unsigned int>(firstIndex), static_cast<unsigned int>(lod.indices.size()), lod.error });
+                firstIndex += lod.indices.size();
+            }
+
+            this->allocation = GeometryArena::instance(this->vertexFormat).allocate(vertexData, vertexCount, packedIndices.data(), packedIndices.size());
+        }
+
+        // Binds our textures and sets the uniforms describing them and our vertices
+        void bindMaterial(Shader& shader)
+        {
+            this->resolveUniforms(shader);
 
             for (unsigned int i = 0; i < this->textures.size(); i++)
             {
-                Texture currentTexture = this->textures[i];
+                // Texture i goes on unit i. Meshes sharing a texture leave it bound there for each other.
+                shader.setInt(this->uniforms.textures[i], i);
+                GLStateCache::instance().bindTexture(i, GL_TEXTURE_2D, this->textures[i].id);
+            }
+
+            // Without a normal map the shader sticks to the interpolated vertex normal
+            shader.setBool(this->uniforms.hasNormalMap, this->uniforms.normalMapCount > 0);
+
+            // Tell the vertex shader how to decode our vertices (the defaults leave float vertices untouched)
+            bool quantized = this->vertexFormat == VertexFormat::Quantized;
+            shader.setVec3(this->uniforms.positionOffset, this->positionOffset);
+            shader.setVec3(this->uniforms.positionScale, this->positionScale);
+            shader.setBool(this->uniforms.octahedralNormals, quantized);
+        }
+
+        void resolveUniforms(const Shader& shader)
+        {
+            if (this->uniforms.program == shader.ID && this->uniforms.textures.size() == this->textures.size())
+            {
+                return;
+            }
 
-                // GL_TEXTUREN are just sequential ints which is why we can 
-                // just add the current index here
-                glActiveTexture(GL_TEXTURE0 + i);
+            this->uniforms = MeshUniforms();
+            this->uniforms.program = shader.ID;
 
+            unsigned int diffuseIndex = 1,
+                specularIndex = 1,
+                normalIndex = 1;
+
+            for (const Texture& texture : this->textures)
+            {
                 int typedTextureIndex = 0;
-                string name = currentTexture.type;
+                const string& name = texture.type;
 
                 // TODO: Might be better off using an enum and switch case here as opposed to hard coding the string
                 // Also we should define the strings in a central location instead of having "magic" variables
@@ -86,68 +371,72 @@ class Mesh
                     typedTextureIndex = specularIndex;
                     specularIndex++;
                 }
+                else if (name == "texture_normal")
+                {
+                    typedTextureIndex = normalIndex;
+                    normalIndex++;
+                }
 
-                string uniform = /*"material." +*/ name + to_string(typedTextureIndex);
-                shader.setInt(uniform.c_str(), i);
-
-                glBindTexture(GL_TEXTURE_2D, currentTexture.id);
+                this->uniforms.textures.push_back(shader.uniform(/*"material." +*/ name + to_string(typedTextureIndex)));
             }
 
-            // Render
-            glBindVertexArray(VAO);
-            glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(this->indices.size()), GL_UNSIGNED_INT, 0);
-
-            // Unbind VAO and reset Active Texture
-            glBindVertexArray(0);
-            glActiveTexture(GL_TEXTURE0);
-        }
-
-        void freeResources()
-        {
-            glDeleteVertexArrays(1, &(this->VAO));
-            glDeleteBuffers(1, &(this->VBO));
-            glDeleteBuffers(1, &(this->EBO));
+            this->uniforms.normalMapCount = normalIndex - 1;
+            this->uniforms.hasNormalMap = shader.uniform("hasNormalMap");
+            this->uniforms.positionOffset = shader.uniform("positionOffset");
+            this->uniforms.positionScale = shader.uniform("positionScale");
+            this->uniforms.octahedralNormals = shader.uniform("octahedralNormals");
         }
 
-    private:
-        // Render data (Vertex Buffer Object and Element Buffer Object)
-        unsigned int VBO, EBO;
-
-        // Initializes our VAO, VBO, and EBO
-        void setupMesh()
+        // Draws only the meshlets that pass the culler. Visible meshlets are contiguous in the index buffer whenever
+        // their neighbours are visible too, so runs of them are merged into a single range of the multi-draw.
+        void drawVisibleMeshlets(const MeshletCuller& culler, const char* indexOffset, GLint baseVertex, MeshletCullingStats* cullingStats)
         {
-            glGenVertexArrays(1, &(this->VAO));
-            glGenBuffers(1, &(this->VBO));
-            glGenBuffers(1, &(this->EBO));
+            this->meshletDrawCounts.clear();
+            this->meshletDrawOffsets.clear();
 
-            glBindVertexArray(this->VAO);
+            size_t indexSize = indexTypeSize(this->indexType);
+            size_t culledMeshletCount = 0, culledTriangleCount = 0;
+            unsigned int runEnd = ~0u;
 
-            glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
-            // Note using sizeof(vertices) instead of vertices.size() * sizeof(Vertex) results in an error (same situation for EBO/indices below)
-            // Why though???
-            // Answer: sizeof() returns the compile-time size of a given object. Vectors encapsulate dynamic size arrays, resizing as needed during run-time,
-            // so sizeof(vector) has no knowledge of the number of elements actually stored in the vector. Instead, sizeof(vector) returns the compile-time
-            // memory used by the vector class, rather than the memory taken up by the elements currently stored in this particular vector object during run-time.
-            glBufferData(GL_ARRAY_BUFFER, this->vertices.size() * sizeof(Vertex), &(this->vertices[0]), GL_STATIC_DRAW);
+            for (const MeshletData& meshlet : this->meshlets)
+            {
+                if (!culler.isVisible(meshlet))
+                {
+                    culledMeshletCount++;
+                    culledTriangleCount += meshlet.triangleCount;
+                    continue;
+                }
 
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->EBO);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->indices.size() * sizeof(unsigned int), &(this->indices[0]), GL_STATIC_DRAW);
+                GLsizei meshletIndexCount = static_cast<GLsizei>(meshlet.triangleCount * 3);
+                if (meshlet.firstIndex == runEnd)
+                {
+                    this->meshletDrawCounts.back() += meshletIndexCount;
+                }
+                else
+                {
+                    this->meshletDrawCounts.push_back(meshletIndexCount);
+                    this->meshletDrawOffsets.push_back(indexOffset + meshlet.firstIndex * indexSize);
+                }
 
-            // Set up Vertex position attribute
-            glEnableVertexAttribArray(0);
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+                runEnd = meshlet.firstIndex + meshlet.triangleCount * 3;
+            }
 
-            // Set up Vertex normal attribute
-            glEnableVertexAttribArray(1);
-            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+            if (cullingStats)
+            {
+                cullingStats->meshletCount += this->meshlets.size();
+                cullingStats->culledMeshletCount += culledMeshletCount;
+                cullingStats->culledTriangleCount += culledTriangleCount;
+            }
 
-            // Set up Vertex texture coordinates attribute
-            glEnableVertexAttribArray(2);
-            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
+            if (this->meshletDrawCounts.empty())
+            {
+                return;
+            }
 
-            // Unbind VAO
-            glBindVertexArray(0);
+            this->meshletDrawBaseVertices.assign(this->meshletDrawCounts.size(), baseVertex);
+            glMultiDrawElementsBaseVertex(GL_TRIANGLES, this->meshletDrawCounts.data(), this->indexType, this->meshletDrawOffsets.data(),
+                static_cast<GLsizei>(this->meshletDrawCounts.size()), this->meshletDrawBaseVertices.data());
         }
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,418 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <ModelLoading/boundingVolume.h>
+#include <ModelLoading/modelData.h>
+#include <string>
+#include <Utility/assets.h>
+#include <Utility/hash.h>
+#include <vector>
+
+using namespace std;
+
+// Binary cache of an imported model, written next to the source asset (e.g. backpack.obj.meshcache).
+//
+// Importing through Assimp means parsing the whole OBJ as text and rebuilding every Vertex, which dominates our
+// startup time. The cache stores the already-processed ModelData so a warm start is just a single memory-mapped
+// read plus a few memcpys.
+//
+// File layout (all offsets are from the start of the file, blobs are 16 byte aligned):
+//
+//      MeshCacheHeader
+//      Material table  - per material: uint32 textureCount, then per texture:
+//                        uint32 typeLength, uint32 pathLength, type chars, path chars
+//      Mesh table      - MeshCacheRange per mesh
+//      LOD table       - MeshCacheLod per simplified level, each mesh's levels back to back
+//      Meshlet table   - MeshletData per meshlet, each mesh's meshlets back to back
+//      Vertex blob     - every mesh's interleaved vertices, back to back
+//      Index blob      - every mesh's indices followed by its LODs' indices, back to back (still relative to their own mesh)
+//
+// A cache is only used if its magic, version, vertex layout and source hash all match, so editing the source asset
+// or changing the import pipeline (bump MESH_CACHE_VERSION!) automatically falls back to a full import. Callers fold
+// their import settings into the source hash too, see ModelLoadOptions::importHash().
+// Note that only the source file itself is hashed, so delete the cache by hand after editing a referenced .mtl.
+// Caches are read through Assets like the source is, so an archive can ship them; new ones are written as loose files.
+
+const uint32_t MESH_CACHE_MAGIC = 0x434D4F4C; // "LOMC"
+const uint32_t MESH_CACHE_VERSION = 6;
+const char* const MESH_CACHE_EXTENSION = ".meshcache";
+
+struct MeshCacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceHash;
+
+    // sizeof(Vertex) when the cache was written, guards against layout changes we forgot to version
+    uint32_t vertexStride;
+    uint32_t meshCount;
+    uint32_t materialCount;
+    uint32_t reserved;
+
+    uint64_t vertexCount;
+    uint64_t indexCount;
+    uint64_t lodCount;
+    uint64_t meshletCount;
+
+    uint64_t materialTableOffset;
+    uint64_t meshTableOffset;
+    uint64_t lodTableOffset;
+    uint64_t meshletTableOffset;
+    uint64_t vertexDataOffset;
+    uint64_t indexDataOffset;
+
+    // Total size of the file, so a truncated write is never mistaken for a valid cache
+    uint64_t fileSize;
+};
+
+struct MeshCacheRange
+{
+    uint64_t firstVertex;
+    uint64_t firstIndex;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t materialIndex;
+    uint32_t lodCount;
+    uint64_t firstLod;
+    uint64_t firstMeshlet;
+    uint32_t meshletCount;
+    uint32_t reserved;
+    BoundingVolume bounds;
+};
+
+static_assert(sizeof(BoundingVolume) == 10 * sizeof(float), "BoundingVolume is written to the mesh cache as plain floats");
+
+struct MeshCacheLod
+{
+    uint64_t firstIndex;
+    uint32_t indexCount;
+    float error;
+};
+
+class MeshCache
+{
+    public:
+        // Where the cache for a given source asset lives
+        static string cachePathFor(const string& sourcePath)
+        {
+            return sourcePath + MESH_CACHE_EXTENSION;
+        }
+
+        // Hashes the contents of the source asset. Returns false if the file can't be read.
+        static bool hashSourceFile(const string& sourcePath, uint64_t& hash)
+        {
+            AssetData source = Assets::instance().read(sourcePath);
+            if (!source.isOpen())
+            {
+                return false;
+            }
+
+            hash = hashBytes(source.data(), source.size());
+            return true;
+        }
+
+        // Loads a cache into modelData. Returns false (leaving modelData empty) if the cache is missing, stale,
+        // or malformed in any way, in which case the caller should fall back to a full import.
+        static bool read(const string& cachePath, uint64_t sourceHash, ModelData& modelData)
+        {
+            modelData = ModelData();
+
+            AssetData cache = Assets::instance().read(cachePath);
+            if (!cache.isOpen() || cache.size() < sizeof(MeshCacheHeader))
+            {
+                return false;
+            }
+
+            const unsigned char* data = cache.data();
+            size_t size = cache.size();
+
+            MeshCacheHeader header;
+            memcpy(&header, data, sizeof(MeshCacheHeader));
+
+            if (header.magic != MESH_CACHE_MAGIC
+                || header.version != MESH_CACHE_VERSION
+                || header.sourceHash != sourceHash
+                || header.vertexStride != sizeof(Vertex)
+                || header.fileSize != size)
+            {
+                return false;
+            }
+
+            // Make sure every section actually fits inside the file before we read any of it
+            if (!fitsInFile(header.meshTableOffset, uint64_t(header.meshCount) * sizeof(MeshCacheRange), size)
+                || !fitsInFile(header.lodTableOffset, header.lodCount * sizeof(MeshCacheLod), size)
+                || !fitsInFile(header.meshletTableOffset, header.meshletCount * sizeof(MeshletData), size)
+                || !fitsInFile(header.vertexDataOffset, header.vertexCount * sizeof(Vertex), size)
+                || !fitsInFile(header.indexDataOffset, header.indexCount * sizeof(unsigned int), size)
+                || header.materialTableOffset < sizeof(MeshCacheHeader)
+                || header.materialTableOffset > header.meshTableOffset
+                || uint64_t(header.materialCount) * sizeof(uint32_t) > header.meshTableOffset - header.materialTableOffset)
+            {
+                return false;
+            }
+
+            // Material table
+            size_t cursor = static_cast<size_t>(header.materialTableOffset);
+            size_t materialTableEnd = static_cast<size_t>(header.meshTableOffset);
+            modelData.materials.resize(header.materialCount);
+            for (uint32_t i = 0; i < header.materialCount; i++)
+            {
+                uint32_t textureCount;
+                if (!readValue(data, materialTableEnd, cursor, textureCount))
+                {
+                    modelData = ModelData();
+                    return false;
+                }
+
+                vector<MaterialTextureData>& textures = modelData.materials[i].textures;
+                for (uint32_t j = 0; j < textureCount; j++)
+                {
+                    MaterialTextureData texture;
+                    uint32_t typeLength, pathLength;
+                    if (!readValue(data, materialTableEnd, cursor, typeLength)
+                        || !readValue(data, materialTableEnd, cursor, pathLength)
+                        || !readString(data, materialTableEnd, cursor, typeLength, texture.type)
+                        || !readString(data, materialTableEnd, cursor, pathLength, texture.path))
+                    {
+                        modelData = ModelData();
+                        return false;
+                    }
+
+                    textures.push_back(texture);
+                }
+            }
+
+            // Mesh ranges, vertices and indices
+            const Vertex* vertexData = reinterpret_cast<const Vertex*>(data + header.vertexDataOffset);
+            const unsigned int* indexData = reinterpret_cast<const unsigned int*>(data + header.indexDataOffset);
+
+            modelData.meshes.resize(header.meshCount);
+            for (uint32_t i = 0; i < header.meshCount; i++)
+            {
+                MeshCacheRange range;
+                memcpy(&range, data + header.meshTableOffset + i * sizeof(MeshCacheRange), sizeof(MeshCacheRange));
+
+                if (range.firstVertex + range.vertexCount > header.vertexCount
+                    || range.firstIndex + range.indexCount > header.indexCount
+                    || range.firstLod + range.lodCount > header.lodCount
+                    || range.firstMeshlet + range.meshletCount > header.meshletCount
+                    || (range.materialIndex >= header.materialCount && header.materialCount > 0))
+                {
+                    modelData = ModelData();
+                    return false;
+                }
+
+                MeshData& mesh = modelData.meshes[i];
+                mesh.vertices.assign(vertexData + range.firstVertex, vertexData + range.firstVertex + range.vertexCount);
+                mesh.indices.assign(indexData + range.firstIndex, indexData + range.firstIndex + range.indexCount);
+                mesh.materialIndex = range.materialIndex;
+                mesh.bounds = range.bounds;
+
+                mesh.lods.resize(range.lodCount);
+                for (uint32_t j = 0; j < range.lodCount; j++)
+                {
+                    MeshCacheLod lod;
+                    memcpy(&lod, data + header.lodTableOffset + (range.firstLod + j) * sizeof(MeshCacheLod), sizeof(MeshCacheLod));
+                    if (lod.firstIndex + lod.indexCount > header.indexCount)
+                    {
+                        modelData = ModelData();
+                        return false;
+                    }
+
+                    mesh.lods[j].indices.assign(indexData + lod.firstIndex, indexData + lod.firstIndex + lod.indexCount);
+                    mesh.lods[j].error = lod.error;
+                }
+
+                mesh.meshlets.resize(range.meshletCount);
+                memcpy(mesh.meshlets.data(), data + header.meshletTableOffset + range.firstMeshlet * sizeof(MeshletData),
+                    range.meshletCount * sizeof(MeshletData));
+                for (const MeshletData& meshlet : mesh.meshlets)
+                {
+                    if (uint64_t(meshlet.firstIndex) + uint64_t(meshlet.triangleCount) * 3 > range.indexCount)
+                    {
+                        modelData = ModelData();
+                        return false;
+                    }
+                }
+            }
+
+            return true;
+        }
+
+        // Serializes modelData to the given cache path. Returns false if the file couldn't be written.
+        static bool write(const string& cachePath, uint64_t sourceHash, const ModelData& modelData)
+        {
+            MeshCacheHeader header = {};
+            header.magic = MESH_CACHE_MAGIC;
+            header.version = MESH_CACHE_VERSION;
+            header.sourceHash = sourceHash;
+            header.vertexStride = sizeof(Vertex);
+            header.meshCount = static_cast<uint32_t>(modelData.meshes.size());
+            header.materialCount = static_cast<uint32_t>(modelData.materials.size());
+
+            // Material table
+            vector<unsigned char> materialTable;
+            for (const MaterialData& material : modelData.materials)
+            {
+                appendValue(materialTable, static_cast<uint32_t>(material.textures.size()));
+                for (const MaterialTextureData& texture : material.textures)
+                {
+                    appendValue(materialTable, static_cast<uint32_t>(texture.type.size()));
+                    appendValue(materialTable, static_cast<uint32_t>(texture.path.size()));
+                    materialTable.insert(materialTable.end(), texture.type.begin(), texture.type.end());
+                    materialTable.insert(materialTable.end(), texture.path.begin(), texture.path.end());
+                }
+            }
+
+            // Mesh and LOD tables
+            vector<MeshCacheRange> ranges;
+            vector<MeshCacheLod> lods;
+            vector<MeshletData> meshlets;
+            ranges.reserve(modelData.meshes.size());
+            for (const MeshData& mesh : modelData.meshes)
+            {
+                MeshCacheRange range = {};
+                range.firstVertex = header.vertexCount;
+                range.firstIndex = header.indexCount;
+                range.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+                range.indexCount = static_cast<uint32_t>(mesh.indices.size());
+                range.materialIndex = mesh.materialIndex;
+                range.lodCount = static_cast<uint32_t>(mesh.lods.size());
+                range.firstLod = lods.size();
+                range.meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+                range.firstMeshlet = meshlets.size();
+                range.bounds = mesh.bounds;
+                ranges.push_back(range);
+
+                meshlets.insert(meshlets.end(), mesh.meshlets.begin(), mesh.meshlets.end());
+
+                header.vertexCount += mesh.vertices.size();
+                header.indexCount += mesh.indices.size();
+
+                for (const MeshLod& meshLod : mesh.lods)
+                {
+                    MeshCacheLod lod = {};
+                    lod.firstIndex = header.indexCount;
+                    lod.indexCount = static_cast<uint32_t>(meshLod.indices.size());
+                    lod.error = meshLod.error;
+                    lods.push_back(lod);
+
+                    header.indexCount += meshLod.indices.size();
+                }
+            }
+
+            header.lodCount = lods.size();
+            header.meshletCount = meshlets.size();
+
+            header.materialTableOffset = sizeof(MeshCacheHeader);
+            header.meshTableOffset = alignOffset(header.materialTableOffset + materialTable.size());
+            header.lodTableOffset = alignOffset(header.meshTableOffset + ranges.size() * sizeof(MeshCacheRange));
+            header.meshletTableOffset = alignOffset(header.lodTableOffset + lods.size() * sizeof(MeshCacheLod));
+            header.vertexDataOffset = alignOffset(header.meshletTableOffset + meshlets.size() * sizeof(MeshletData));
+            header.indexDataOffset = alignOffset(header.vertexDataOffset + header.vertexCount * sizeof(Vertex));
+            header.fileSize = header.indexDataOffset + header.indexCount * sizeof(unsigned int);
+
+            ofstream cacheFile(Assets::instance().resolvePath(cachePath), ios::binary | ios::trunc);
+            if (!cacheFile)
+            {
+                return false;
+            }
+
+            // Stream each section straight out of modelData rather than assembling the file in memory first,
+            // which would briefly double the model's footprint
+            writeBytes(cacheFile, &header, sizeof(MeshCacheHeader));
+            writeBytes(cacheFile, materialTable.data(), materialTable.size());
+            writePadding(cacheFile, header.meshTableOffset);
+            writeBytes(cacheFile, ranges.data(), ranges.size() * sizeof(MeshCacheRange));
+            writePadding(cacheFile, header.lodTableOffset);
+            writeBytes(cacheFile, lods.data(), lods.size() * sizeof(MeshCacheLod));
+            writePadding(cacheFile, header.meshletTableOffset);
+            writeBytes(cacheFile, meshlets.data(), meshlets.size() * sizeof(MeshletData));
+            writePadding(cacheFile, header.vertexDataOffset);
+            for (const MeshData& mesh : modelData.meshes)
+            {
+                writeBytes(cacheFile, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+            }
+
+            writePadding(cacheFile, header.indexDataOffset);
+            for (const MeshData& mesh : modelData.meshes)
+            {
+                writeBytes(cacheFile, mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+                for (const MeshLod& meshLod : mesh.lods)
+                {
+                    writeBytes(cacheFile, meshLod.indices.data(), meshLod.indices.size() * sizeof(unsigned int));
+                }
+            }
+
+            return static_cast<bool>(cacheFile);
+        }
+
+    private:
+        static const uint64_t BLOB_ALIGNMENT = 16;
+
+        static uint64_t alignOffset(uint64_t offset)
+        {
+            return (offset + BLOB_ALIGNMENT - 1) & ~(BLOB_ALIGNMENT - 1);
+        }
+
+        static bool fitsInFile(uint64_t offset, uint64_t length, size_t fileSize)
+        {
+            return offset <= fileSize && length <= fileSize - offset;
+        }
+
+        template <typename T>
+        static void appendValue(vector<unsigned char>& buffer, const T& value)
+        {
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+            buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+        }
+
+        static void writeBytes(ofstream& file, const void* source, size_t length)
+        {
+            if (length > 0)
+            {
+                file.write(static_cast<const char*>(source), length);
+            }
+        }
+
+        // Zero fills up to the given (aligned) section offset
+        static void writePadding(ofstream& file, uint64_t sectionOffset)
+        {
+            const char zeros[BLOB_ALIGNMENT] = {};
+            uint64_t position = static_cast<uint64_t>(file.tellp());
+            if (position < sectionOffset)
+            {
+                file.write(zeros, static_cast<streamsize>(sectionOffset - position));
+            }
+        }
+
+        template <typename T>
+        static bool readValue(const unsigned char* data, size_t end, size_t& cursor, T& value)
+        {
+            if (cursor + sizeof(T) > end)
+            {
+                return false;
+            }
+
+            memcpy(&value, data + cursor, sizeof(T));
+            cursor += sizeof(T);
+            return true;
+        }
+
+        static bool readString(const unsigned char* data, size_t end, size_t& cursor, uint32_t length, string& value)
+        {
+            if (cursor + length > end)
+            {
+                return false;
+            }
+
+            value.assign(reinterpret_cast<const char*>(data + cursor), length);
+            cursor += length;
+            return true;
+        }
+};
+
+#endif
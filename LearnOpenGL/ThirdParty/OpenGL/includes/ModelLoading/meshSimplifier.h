@@ -0,0 +1,432 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <ModelLoading/vertex.h>
+#include <unordered_map>
+#include <Utility/hash.h>
+#include <vector>
+
+using namespace std;
+
+// Quadric error metric edge collapse simplifier (Garland & Heckbert), used to build LOD chains at import time.
+//
+// Only the index buffer is simplified: every collapse moves a vertex onto one of its neighbours, so each LOD is
+// just another index list over the mesh's existing vertices and all LODs share one vertex buffer.
+//
+// Vertices that sit on a UV/normal seam (several vertices with the same position) are never moved, so the
+// simplified mesh can't tear open along its seams. Vertices on an open border only slide along that border.
+class MeshSimplifier
+{
+    public:
+        // Collapses edges, cheapest first, until the mesh is down to targetIndexCount indices or the next collapse
+        // would move the surface further than targetError (in model space units). resultError receives the largest
+        // error actually introduced.
+        static vector<unsigned int> simplify(const vector<Vertex>& vertices, const vector<unsigned int>& indices,
+            size_t targetIndexCount, float targetError, float& resultError)
+        {
+            resultError = 0.0f;
+
+            size_t vertexCount = vertices.size();
+            vector<unsigned int> result(indices.begin(), indices.begin() + (indices.size() - indices.size() % 3));
+            if (vertexCount == 0 || result.size() <= targetIndexCount)
+            {
+                return result;
+            }
+
+            // Vertices that share a position are wedges of the same point on the surface
+            vector<unsigned int> canonical(vertexCount);
+            vector<unsigned int> wedgeCount(vertexCount, 0);
+            unordered_map<glm::vec3, unsigned int, PositionHasher> positionIndices;
+            positionIndices.reserve(vertexCount);
+            for (unsigned int i = 0; i < vertexCount; i++)
+            {
+                canonical[i] = positionIndices.emplace(vertices[i].position, i).first->second;
+                wedgeCount[canonical[i]]++;
+            }
+
+            // Classify every position, and build its quadric from the planes of the triangles around it
+            unordered_map<uint64_t, unsigned int> edgeCounts = countEdges(result, canonical);
+
+            vector<VertexKind> kinds(vertexCount, VertexKind::Manifold);
+            for (unsigned int i = 0; i < vertexCount; i++)
+            {
+                if (wedgeCount[i] > 1)
+                {
+                    kinds[i] = VertexKind::Locked;
+                }
+            }
+
+            vector<Quadric> quadrics(vertexCount);
+            for (size_t i = 0; i < result.size(); i += 3)
+            {
+                unsigned int corners[3] = { canonical[result[i]], canonical[result[i + 1]], canonical[result[i + 2]] };
+                glm::dvec3 p0 = glm::dvec3(vertices[corners[0]].position);
+                glm::dvec3 p1 = glm::dvec3(vertices[corners[1]].position);
+                glm::dvec3 p2 = glm::dvec3(vertices[corners[2]].position);
+
+                glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+                double doubleArea = glm::length(normal);
+                if (doubleArea <= 0.0)
+                {
+                    continue;
+                }
+
+                normal /= doubleArea;
+                Quadric faceQuadric = Quadric::fromPlane(normal, -glm::dot(normal, p0), doubleArea * 0.5);
+                for (unsigned int corner : corners)
+                {
+                    quadrics[corner] += faceQuadric;
+                }
+
+                // Open border edges get an extra plane at right angles to the face, which keeps the border in place
+                for (int edge = 0; edge < 3; edge++)
+                {
+                    unsigned int a = corners[edge], b = corners[(edge + 1) % 3];
+                    unsigned int count = edgeCounts[edgeKey(a, b)];
+                    if (count == 1)
+                    {
+                        glm::dvec3 pa = glm::dvec3(vertices[a].position), pb = glm::dvec3(vertices[b].position);
+                        glm::dvec3 edgeVector = pb - pa;
+                        glm::dvec3 borderNormal = glm::cross(edgeVector, normal);
+                        double borderLength = glm::length(borderNormal);
+                        if (borderLength > 0.0)
+                        {
+                            borderNormal /= borderLength;
+                            Quadric borderQuadric = Quadric::fromPlane(borderNormal, -glm::dot(borderNormal, pa),
+                                glm::dot(edgeVector, edgeVector) * BORDER_WEIGHT);
+                            quadrics[a] += borderQuadric;
+                            quadrics[b] += borderQuadric;
+                        }
+
+                        kinds[a] = kinds[a] == VertexKind::Locked ? VertexKind::Locked : VertexKind::Border;
+                        kinds[b] = kinds[b] == VertexKind::Locked ? VertexKind::Locked : VertexKind::Border;
+                    }
+                    else if (count > 2)
+                    {
+                        // Non-manifold edge, leave it alone
+                        kinds[a] = kinds[b] = VertexKind::Locked;
+                    }
+                }
+            }
+
+            // Collapse in passes. Each pass picks every vertex's cheapest collapse, then performs them in order of cost,
+            // skipping any that touch a vertex whose neighbourhood already changed in this pass.
+            double errorLimit = double(targetError) * double(targetError);
+            double maxError = 0.0;
+            size_t triangleCount = result.size() / 3;
+            size_t targetTriangleCount = targetIndexCount / 3;
+
+            vector<unsigned int> triangleOffsets, vertexTriangles;
+            vector<unsigned int> collapseTargets(vertexCount);
+            vector<double> collapseCosts(vertexCount);
+            vector<unsigned char> touched(vertexCount);
+            vector<unsigned int> remap(vertexCount);
+            vector<unsigned int> candidates;
+
+            while (triangleCount > targetTriangleCount)
+            {
+                edgeCounts = countEdges(result, canonical);
+                buildAdjacency(result, vertexCount, triangleOffsets, vertexTriangles);
+
+                // Cheapest legal collapse for every movable vertex
+                fill(collapseTargets.begin(), collapseTargets.end(), INVALID_VERTEX);
+                for (size_t i = 0; i < result.size(); i += 3)
+                {
+                    for (int edge = 0; edge < 3; edge++)
+                    {
+                        unsigned int a = result[i + edge], b = result[i + (edge + 1) % 3];
+                        considerCollapse(a, b, vertices, canonical, kinds, quadrics, edgeCounts, collapseTargets, collapseCosts);
+                        considerCollapse(b, a, vertices, canonical, kinds, quadrics, edgeCounts, collapseTargets, collapseCosts);
+                    }
+                }
+
+                candidates.clear();
+                for (unsigned int i = 0; i < vertexCount; i++)
+                {
+                    if (collapseTargets[i] != INVALID_VERTEX && collapseCosts[i] <= errorLimit)
+                    {
+                        candidates.push_back(i);
+                    }
+                }
+
+                sort(candidates.begin(), candidates.end(), [&collapseCosts](unsigned int a, unsigned int b)
+                {
+                    return collapseCosts[a] < collapseCosts[b];
+                });
+
+                fill(touched.begin(), touched.end(), static_cast<unsigned char>(0));
+                for (unsigned int i = 0; i < vertexCount; i++)
+                {
+                    remap[i] = i;
+                }
+
+                size_t collapseCount = 0;
+
+                for (unsigned int source : candidates)
+                {
+                    if (triangleCount <= targetTriangleCount)
+                    {
+                        break;
+                    }
+
+                    unsigned int target = collapseTargets[source];
+                    unsigned int sourcePosition = canonical[source], targetPosition = canonical[target];
+                    if (touched[sourcePosition] || touched[targetPosition]
+                        || flipsTriangles(source, target, vertices, canonical, result, triangleOffsets, vertexTriangles))
+                    {
+                        continue;
+                    }
+
+                    // The triangles around source that also use target become degenerate and disappear. Everything
+                    // around source is marked touched, since those triangles are about to change.
+                    for (unsigned int t = triangleOffsets[source]; t < triangleOffsets[source + 1]; t++)
+                    {
+                        unsigned int triangle = vertexTriangles[t];
+                        bool removed = false;
+                        for (int corner = 0; corner < 3; corner++)
+                        {
+                            unsigned int cornerPosition = canonical[result[triangle * 3 + corner]];
+                            touched[cornerPosition] = 1;
+                            removed = removed || cornerPosition == targetPosition;
+                        }
+
+                        triangleCount -= removed ? 1 : 0;
+                    }
+
+                    remap[source] = target;
+                    quadrics[targetPosition] += quadrics[sourcePosition];
+                    maxError = max(maxError, collapseCosts[source]);
+                    collapseCount++;
+                }
+
+                if (collapseCount == 0)
+                {
+                    break;
+                }
+
+                // Apply this pass's collapses, and drop the triangles they made degenerate
+                size_t writeIndex = 0;
+                for (size_t i = 0; i < result.size(); i += 3)
+                {
+                    unsigned int triangle[3] = { remap[result[i]], remap[result[i + 1]], remap[result[i + 2]] };
+
+                    unsigned int c0 = canonical[triangle[0]], c1 = canonical[triangle[1]], c2 = canonical[triangle[2]];
+                    if (c0 == c1 || c1 == c2 || c0 == c2)
+                    {
+                        continue;
+                    }
+
+                    result[writeIndex++] = triangle[0];
+                    result[writeIndex++] = triangle[1];
+                    result[writeIndex++] = triangle[2];
+                }
+
+                result.resize(writeIndex);
+                triangleCount = result.size() / 3;
+            }
+
+            resultError = static_cast<float>(sqrt(maxError));
+            return result;
+        }
+
+    private:
+        static constexpr unsigned int INVALID_VERTEX = ~0u;
+
+        // How strongly open borders resist moving, relative to the surface itself
+        static constexpr double BORDER_WEIGHT = 10.0;
+
+        // Smallest cosine allowed between a triangle's normal before and after a collapse (about 75 degrees)
+        static constexpr double MAX_NORMAL_CHANGE_COSINE = 0.25;
+
+        enum class VertexKind : unsigned char
+        {
+            // Interior vertex with a single wedge, free to collapse onto any neighbour
+            Manifold,
+
+            // On an open border, may only collapse along it
+            Border,
+
+            // On a seam or a non-manifold edge, never moves
+            Locked
+        };
+
+        // Sum of squared distances to a set of planes, weighted (by triangle area) and normalized by the total
+        // weight so evaluate() gives an average squared distance in model space units
+        struct Quadric
+        {
+            double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+            double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+            double c = 0.0;
+            double weight = 0.0;
+
+            // Plane n.p + d = 0, with n unit length
+            static Quadric fromPlane(const glm::dvec3& n, double d, double weight)
+            {
+                Quadric quadric;
+                quadric.a00 = n.x * n.x * weight;
+                quadric.a01 = n.x * n.y * weight;
+                quadric.a02 = n.x * n.z * weight;
+                quadric.a11 = n.y * n.y * weight;
+                quadric.a12 = n.y * n.z * weight;
+                quadric.a22 = n.z * n.z * weight;
+                quadric.b0 = n.x * d * weight;
+                quadric.b1 = n.y * d * weight;
+                quadric.b2 = n.z * d * weight;
+                quadric.c = d * d * weight;
+                quadric.weight = weight;
+                return quadric;
+            }
+
+            Quadric& operator+=(const Quadric& other)
+            {
+                this->a00 += other.a00;
+                this->a01 += other.a01;
+                this->a02 += other.a02;
+                this->a11 += other.a11;
+                this->a12 += other.a12;
+                this->a22 += other.a22;
+                this->b0 += other.b0;
+                this->b1 += other.b1;
+                this->b2 += other.b2;
+                this->c += other.c;
+                this->weight += other.weight;
+                return *this;
+            }
+
+            double evaluate(const glm::vec3& position) const
+            {
+                if (this->weight <= 0.0)
+                {
+                    return 0.0;
+                }
+
+                double x = position.x, y = position.y, z = position.z;
+                double error = this->a00 * x * x + this->a11 * y * y + this->a22 * z * z
+                    + 2.0 * (this->a01 * x * y + this->a02 * x * z + this->a12 * y * z)
+                    + 2.0 * (this->b0 * x + this->b1 * y + this->b2 * z)
+                    + this->c;
+
+                return max(error / this->weight, 0.0);
+            }
+        };
+
+        struct PositionHasher
+        {
+            size_t operator()(const glm::vec3& position) const
+            {
+                return static_cast<size_t>(hashBytes(&position, sizeof(glm::vec3)));
+            }
+        };
+
+        static uint64_t edgeKey(unsigned int a, unsigned int b)
+        {
+            return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+        }
+
+        // Number of triangles using each edge, by position. 1 means an open border.
+        static unordered_map<uint64_t, unsigned int> countEdges(const vector<unsigned int>& indices, const vector<unsigned int>& canonical)
+        {
+            unordered_map<uint64_t, unsigned int> edgeCounts;
+            edgeCounts.reserve(indices.size());
+            for (size_t i = 0; i < indices.size(); i += 3)
+            {
+                for (int edge = 0; edge < 3; edge++)
+                {
+                    edgeCounts[edgeKey(canonical[indices[i + edge]], canonical[indices[i + (edge + 1) % 3]])]++;
+                }
+            }
+
+            return edgeCounts;
+        }
+
+        // Lists the triangles around each vertex: vertexTriangles[triangleOffsets[v] .. triangleOffsets[v + 1])
+        static void buildAdjacency(const vector<unsigned int>& indices, size_t vertexCount, vector<unsigned int>& triangleOffsets,
+            vector<unsigned int>& vertexTriangles)
+        {
+            triangleOffsets.assign(vertexCount + 1, 0);
+            for (unsigned int index : indices)
+            {
+                triangleOffsets[index + 1]++;
+            }
+
+            for (size_t i = 0; i < vertexCount; i++)
+            {
+                triangleOffsets[i + 1] += triangleOffsets[i];
+            }
+
+            vertexTriangles.resize(indices.size());
+            vector<unsigned int> cursors(triangleOffsets.begin(), triangleOffsets.end() - 1);
+            for (size_t i = 0; i < indices.size(); i++)
+            {
+                vertexTriangles[cursors[indices[i]]++] = static_cast<unsigned int>(i / 3);
+            }
+        }
+
+        static void considerCollapse(unsigned int source, unsigned int target, const vector<Vertex>& vertices, const vector<unsigned int>& canonical,
+            const vector<VertexKind>& kinds, const vector<Quadric>& quadrics, const unordered_map<uint64_t, unsigned int>& edgeCounts,
+            vector<unsigned int>& collapseTargets, vector<double>& collapseCosts)
+        {
+            unsigned int sourcePosition = canonical[source], targetPosition = canonical[target];
+            VertexKind kind = kinds[sourcePosition];
+            if (sourcePosition == targetPosition || kind == VertexKind::Locked)
+            {
+                return;
+            }
+
+            if (kind == VertexKind::Border)
+            {
+                auto edgeCount = edgeCounts.find(edgeKey(sourcePosition, targetPosition));
+                if (edgeCount == edgeCounts.end() || edgeCount->second != 1)
+                {
+                    return;
+                }
+            }
+
+            double cost = quadrics[sourcePosition].evaluate(vertices[target].position);
+            if (collapseTargets[source] == INVALID_VERTEX || cost < collapseCosts[source])
+            {
+                collapseTargets[source] = target;
+                collapseCosts[source] = cost;
+            }
+        }
+
+        // Would moving source onto target turn any of the surviving triangles around source inside out?
+        static bool flipsTriangles(unsigned int source, unsigned int target, const vector<Vertex>& vertices, const vector<unsigned int>& canonical,
+            const vector<unsigned int>& indices, const vector<unsigned int>& triangleOffsets, const vector<unsigned int>& vertexTriangles)
+        {
+            unsigned int targetPosition = canonical[target];
+            glm::dvec3 newPosition = glm::dvec3(vertices[target].position);
+
+            for (unsigned int t = triangleOffsets[source]; t < triangleOffsets[source + 1]; t++)
+            {
+                const unsigned int* triangle = &indices[vertexTriangles[t] * 3];
+                if (canonical[triangle[0]] == targetPosition || canonical[triangle[1]] == targetPosition || canonical[triangle[2]] == targetPosition)
+                {
+                    continue;
+                }
+
+                glm::dvec3 corners[3], movedCorners[3];
+                for (int corner = 0; corner < 3; corner++)
+                {
+                    corners[corner] = glm::dvec3(vertices[triangle[corner]].position);
+                    movedCorners[corner] = triangle[corner] == source ? newPosition : corners[corner];
+                }
+
+                glm::dvec3 oldNormal = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+                glm::dvec3 newNormal = glm::cross(movedCorners[1] - movedCorners[0], movedCorners[2] - movedCorners[0]);
+                if (glm::dot(oldNormal, newNormal) < MAX_NORMAL_CHANGE_COSINE * glm::length(oldNormal) * glm::length(newNormal))
+                {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+};
+
+#endif
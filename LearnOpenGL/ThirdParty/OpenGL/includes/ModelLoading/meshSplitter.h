@@ -0,0 +1,86 @@
+#ifndef MESH_SPLITTER_H
+#define MESH_SPLITTER_H
+
+#include <cstddef>
+#include <ModelLoading/indexFormat.h>
+#include <ModelLoading/modelData.h>
+#include <vector>
+
+using namespace std;
+
+// Breaks meshes that are too big for 16-bit indices into several smaller ones that aren't.
+class MeshSplitter
+{
+    public:
+        // Splits meshData into pieces with at most maxVertices vertices each, keeping triangles in their original
+        // order. Run it after the vertex cache optimization so each piece is a run of neighbouring triangles (and
+        // keeps its cache friendly order). Meshes that are already small enough come back as a single piece.
+        static vector<MeshData> split(MeshData&& meshData, size_t maxVertices = MAX_16_BIT_INDEXED_VERTICES)
+        {
+            vector<MeshData> pieces;
+
+            if (meshData.vertices.size() <= maxVertices || maxVertices < 3)
+            {
+                pieces.push_back(std::move(meshData));
+                return pieces;
+            }
+
+            // Maps each source vertex to its index in the current piece. Entries from earlier pieces are told apart
+            // by the piece number, so the table never has to be cleared.
+            const unsigned int UNASSIGNED = ~0u;
+            vector<unsigned int> remap(meshData.vertices.size(), UNASSIGNED);
+            vector<unsigned int> remapPiece(meshData.vertices.size(), 0);
+
+            unsigned int pieceNumber = 0;
+            MeshData piece;
+            piece.materialIndex = meshData.materialIndex;
+
+            size_t indexCount = meshData.indices.size() - meshData.indices.size() % 3;
+            for (size_t i = 0; i < indexCount; i += 3)
+            {
+                // Count how many new vertices this triangle would pull into the current piece
+                size_t newVertexCount = 0;
+                for (size_t corner = 0; corner < 3; corner++)
+                {
+                    unsigned int vertex = meshData.indices[i + corner];
+                    bool seenInCorner = (corner > 0 && meshData.indices[i] == vertex) || (corner > 1 && meshData.indices[i + 1] == vertex);
+                    if (!seenInCorner && (remap[vertex] == UNASSIGNED || remapPiece[vertex] != pieceNumber))
+                    {
+                        newVertexCount++;
+                    }
+                }
+
+                if (piece.vertices.size() + newVertexCount > maxVertices)
+                {
+                    pieces.push_back(std::move(piece));
+
+                    piece = MeshData();
+                    piece.materialIndex = meshData.materialIndex;
+                    pieceNumber++;
+                }
+
+                for (size_t corner = 0; corner < 3; corner++)
+                {
+                    unsigned int vertex = meshData.indices[i + corner];
+                    if (remap[vertex] == UNASSIGNED || remapPiece[vertex] != pieceNumber)
+                    {
+                        remap[vertex] = static_cast<unsigned int>(piece.vertices.size());
+                        remapPiece[vertex] = pieceNumber;
+                        piece.vertices.push_back(meshData.vertices[vertex]);
+                    }
+
+                    piece.indices.push_back(remap[vertex]);
+                }
+            }
+
+            if (!piece.indices.empty())
+            {
+                pieces.push_back(std::move(piece));
+            }
+
+            meshData = MeshData();
+            return pieces;
+        }
+};
+
+#endif
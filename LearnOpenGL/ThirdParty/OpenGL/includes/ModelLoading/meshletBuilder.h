@@ -0,0 +1,300 @@
+#ifndef MESHLET_BUILDER_H
+#define MESHLET_BUILDER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <ModelLoading/modelData.h>
+#include <vector>
+
+using namespace std;
+
+// Meshlet size limits. 64 vertices / 124 triangles is the usual sweet spot for mesh shading hardware, and keeps
+// clusters small enough that their bounds are tight enough to cull well.
+const unsigned int MESHLET_MAX_VERTICES = 64;
+const unsigned int MESHLET_MAX_TRIANGLES = 124;
+
+// Splits a mesh's triangles into meshlets and computes their culling bounds.
+//
+// We don't have mesh shaders, so a meshlet here is just a contiguous run of the mesh's index buffer: build() reorders
+// the triangles so each meshlet's are back to back, and drawing a set of meshlets is a multi-draw over index ranges.
+class MeshletBuilder
+{
+    public:
+        // Groups indices into meshlets, rewriting indices in meshlet order. Each meshlet is grown from a seed triangle
+        // by repeatedly adding the neighbouring triangle that brings in the fewest new vertices (ties going to the
+        // one facing most like the meshlet so far), which keeps meshlets compact and their normal cones narrow.
+        static vector<MeshletData> build(const vector<Vertex>& vertices, vector<unsigned int>& indices)
+        {
+            vector<MeshletData> meshlets;
+
+            size_t triangleCount = indices.size() / 3;
+            if (triangleCount == 0)
+            {
+                return meshlets;
+            }
+
+            vector<glm::vec3> triangleNormals(triangleCount);
+            for (size_t i = 0; i < triangleCount; i++)
+            {
+                triangleNormals[i] = triangleNormal(vertices, &indices[i * 3]);
+            }
+
+            // Triangles around each vertex: vertexTriangles[triangleOffsets[v] .. triangleOffsets[v + 1])
+            vector<unsigned int> triangleOffsets(vertices.size() + 1, 0);
+            for (size_t i = 0; i < triangleCount * 3; i++)
+            {
+                triangleOffsets[indices[i] + 1]++;
+            }
+            for (size_t i = 0; i < vertices.size(); i++)
+            {
+                triangleOffsets[i + 1] += triangleOffsets[i];
+            }
+
+            vector<unsigned int> vertexTriangles(triangleCount * 3);
+            vector<unsigned int> cursors(triangleOffsets.begin(), triangleOffsets.end() - 1);
+            for (size_t i = 0; i < triangleCount * 3; i++)
+            {
+                vertexTriangles[cursors[indices[i]]++] = static_cast<unsigned int>(i / 3);
+            }
+
+            // vertexMeshlet[v] == meshletNumber while v is part of the meshlet being built (meshlet numbers start at 1)
+            vector<unsigned int> vertexMeshlet(vertices.size(), 0);
+            vector<unsigned char> emitted(triangleCount, 0);
+            vector<unsigned int> orderedIndices;
+            orderedIndices.reserve(triangleCount * 3);
+
+            vector<unsigned int> meshletVertices;
+            vector<unsigned int> candidates;
+            size_t nextSeed = 0;
+
+            while (orderedIndices.size() < triangleCount * 3)
+            {
+                while (emitted[nextSeed])
+                {
+                    nextSeed++;
+                }
+
+                unsigned int meshletNumber = static_cast<unsigned int>(meshlets.size()) + 1;
+                MeshletData meshlet = {};
+                meshlet.firstIndex = static_cast<unsigned int>(orderedIndices.size());
+
+                meshletVertices.clear();
+                candidates.clear();
+                glm::vec3 normalSum = glm::vec3(0.0f);
+
+                unsigned int triangle = static_cast<unsigned int>(nextSeed);
+                while (true)
+                {
+                    // Add the triangle, and queue up the triangles around any vertex it brought in
+                    emitted[triangle] = 1;
+                    meshlet.triangleCount++;
+                    normalSum += triangleNormals[triangle];
+
+                    for (int corner = 0; corner < 3; corner++)
+                    {
+                        unsigned int vertex = indices[triangle * 3 + corner];
+                        orderedIndices.push_back(vertex);
+
+                        if (vertexMeshlet[vertex] != meshletNumber)
+                        {
+                            vertexMeshlet[vertex] = meshletNumber;
+                            meshletVertices.push_back(vertex);
+                            candidates.insert(candidates.end(), vertexTriangles.begin() + triangleOffsets[vertex],
+                                vertexTriangles.begin() + triangleOffsets[vertex + 1]);
+                        }
+                    }
+
+                    if (meshlet.triangleCount >= MESHLET_MAX_TRIANGLES)
+                    {
+                        break;
+                    }
+
+                    // Pick the next triangle, dropping candidates that have been emitted since they were queued
+                    unsigned int bestTriangle = ~0u;
+                    unsigned int bestNewVertices = 4;
+                    float bestFacing = -2.0f;
+                    size_t liveCandidates = 0;
+                    for (unsigned int candidate : candidates)
+                    {
+                        if (emitted[candidate])
+                        {
+                            continue;
+                        }
+
+                        candidates[liveCandidates++] = candidate;
+
+                        unsigned int newVertices = 0;
+                        for (int corner = 0; corner < 3; corner++)
+                        {
+                            newVertices += vertexMeshlet[indices[candidate * 3 + corner]] != meshletNumber ? 1 : 0;
+                        }
+
+                        if (meshletVertices.size() + newVertices > MESHLET_MAX_VERTICES)
+                        {
+                            continue;
+                        }
+
+                        float facing = glm::dot(triangleNormals[candidate], normalSum);
+                        if (newVertices < bestNewVertices || (newVertices == bestNewVertices && facing > bestFacing))
+                        {
+                            bestTriangle = candidate;
+                            bestNewVertices = newVertices;
+                            bestFacing = facing;
+                        }
+                    }
+
+                    candidates.resize(liveCandidates);
+
+                    if (bestTriangle == ~0u)
+                    {
+                        break;
+                    }
+
+                    triangle = bestTriangle;
+                }
+
+                computeBounds(vertices, orderedIndices, meshletVertices, meshlet);
+                meshlets.push_back(meshlet);
+            }
+
+            indices = std::move(orderedIndices);
+            return meshlets;
+        }
+
+    private:
+        // Unit normal, or zero for a degenerate triangle
+        static glm::vec3 triangleNormal(const vector<Vertex>& vertices, const unsigned int* triangle)
+        {
+            glm::vec3 p0 = vertices[triangle[0]].position;
+            glm::vec3 normal = glm::cross(vertices[triangle[1]].position - p0, vertices[triangle[2]].position - p0);
+            float length = glm::length(normal);
+            return length > 0.0f ? normal / length : glm::vec3(0.0f);
+        }
+
+        static void computeBounds(const vector<Vertex>& vertices, const vector<unsigned int>& orderedIndices,
+            const vector<unsigned int>& meshletVertices, MeshletData& meshlet)
+        {
+            // Bounding sphere around the center of the bounding box
+            glm::vec3 boundsMin = vertices[meshletVertices[0]].position, boundsMax = boundsMin;
+            for (unsigned int vertex : meshletVertices)
+            {
+                boundsMin = glm::min(boundsMin, vertices[vertex].position);
+                boundsMax = glm::max(boundsMax, vertices[vertex].position);
+            }
+
+            glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+            float radius = 0.0f;
+            for (unsigned int vertex : meshletVertices)
+            {
+                radius = max(radius, glm::length(vertices[vertex].position - center));
+            }
+
+            meshlet.center[0] = center.x;
+            meshlet.center[1] = center.y;
+            meshlet.center[2] = center.z;
+            meshlet.radius = radius;
+
+            // Normal cone: the average facing direction, and how far the triangles stray from it
+            glm::vec3 axis = glm::vec3(0.0f);
+            size_t firstTriangle = meshlet.firstIndex / 3;
+            vector<glm::vec3> normals;
+            normals.reserve(meshlet.triangleCount);
+            for (size_t i = 0; i < meshlet.triangleCount; i++)
+            {
+                glm::vec3 normal = triangleNormal(vertices, &orderedIndices[(firstTriangle + i) * 3]);
+                if (normal != glm::vec3(0.0f))
+                {
+                    normals.push_back(normal);
+                    axis += normal;
+                }
+            }
+
+            float axisLength = glm::length(axis);
+            float minDot = 1.0f;
+            if (axisLength > 0.0f)
+            {
+                axis /= axisLength;
+                for (const glm::vec3& normal : normals)
+                {
+                    minDot = min(minDot, glm::dot(axis, normal));
+                }
+            }
+            else
+            {
+                axis = glm::vec3(0.0f, 0.0f, 1.0f);
+                minDot = -1.0f;
+            }
+
+            meshlet.coneAxis[0] = axis.x;
+            meshlet.coneAxis[1] = axis.y;
+            meshlet.coneAxis[2] = axis.z;
+
+            // Stored as the sine of the cone's half angle. A cone of 90 degrees or more can't be backface culled,
+            // and a cutoff of 1 makes sure MeshletCuller never tries.
+            meshlet.coneCutoff = minDot > 0.0f ? sqrt(1.0f - minDot * minDot) : 1.0f;
+        }
+};
+
+// Decides which meshlets of a mesh can be skipped for the current view. Everything is done in the mesh's model space,
+// so the per-meshlet tests don't need any transforms. Assumes the model matrix doesn't scale non-uniformly.
+struct MeshletCuller
+{
+    // Camera position in model space
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+
+    // Frustum planes in model space (xyz = normal pointing inwards, w = distance), normalized so a sphere's distance
+    // to them is in model space units
+    glm::vec4 frustumPlanes[6];
+
+    static MeshletCuller fromMatrices(const glm::mat4& modelMatrix, const glm::mat4& viewProjection, const glm::vec3& worldCameraPosition)
+    {
+        MeshletCuller culler;
+        culler.cameraPosition = glm::vec3(glm::inverse(modelMatrix) * glm::vec4(worldCameraPosition, 1.0f));
+
+        // Gribb/Hartmann plane extraction from the model-view-projection matrix
+        glm::mat4 clip = glm::transpose(viewProjection * modelMatrix);
+        culler.frustumPlanes[0] = clip[3] + clip[0];
+        culler.frustumPlanes[1] = clip[3] - clip[0];
+        culler.frustumPlanes[2] = clip[3] + clip[1];
+        culler.frustumPlanes[3] = clip[3] - clip[1];
+        culler.frustumPlanes[4] = clip[3] + clip[2];
+        culler.frustumPlanes[5] = clip[3] - clip[2];
+        for (glm::vec4& plane : culler.frustumPlanes)
+        {
+            plane /= glm::length(glm::vec3(plane));
+        }
+
+        return culler;
+    }
+
+    bool isVisible(const MeshletData& meshlet) const
+    {
+        glm::vec3 center = glm::vec3(meshlet.center[0], meshlet.center[1], meshlet.center[2]);
+
+        for (const glm::vec4& plane : this->frustumPlanes)
+        {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -meshlet.radius)
+            {
+                return false;
+            }
+        }
+
+        // Backfacing if the camera is outside the cone of directions the meshlet's triangles face,
+        // padded by the bounding sphere so it holds for every triangle in the meshlet
+        glm::vec3 toCenter = center - this->cameraPosition;
+        glm::vec3 axis = glm::vec3(meshlet.coneAxis[0], meshlet.coneAxis[1], meshlet.coneAxis[2]);
+        return glm::dot(toCenter, axis) < meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius;
+    }
+};
+
+// What culling did during a draw
+struct MeshletCullingStats
+{
+    size_t meshletCount = 0;
+    size_t culledMeshletCount = 0;
+    size_t culledTriangleCount = 0;
+};
+
+#endif
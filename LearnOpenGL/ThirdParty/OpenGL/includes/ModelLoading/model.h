@@ -1,9 +1,12 @@
 #ifndef MODEL_H
 #define MODEL_H
 
+#include <algorithm>
+#include <array>
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
+#include <cmath>
 #include <fstream>
 #include <glad/glad.h> 
 #include <glm/glm.hpp>
@@ -11,33 +14,212 @@
 #include <iostream>
 #include <map>
 #include <ModelLoading/mesh.h>
+#include <ModelLoading/assetIOSystem.h>
+#include <ModelLoading/boundingVolume.h>
+#include <ModelLoading/geometryArena.h>
+#include <ModelLoading/indexFormat.h>
+#include <ModelLoading/meshCache.h>
+#include <ModelLoading/meshletBuilder.h>
+#include <ModelLoading/meshSimplifier.h>
+#include <ModelLoading/meshSplitter.h>
+#include <ModelLoading/modelData.h>
+#include <ModelLoading/tangentGenerator.h>
+#include <ModelLoading/vertex.h>
+#include <ModelLoading/vertexCacheOptimizer.h>
+#include <ModelLoading/vertexQuantization.h>
+#include <ModelLoading/vertexWelder.h>
+#include <Rendering/renderQueue.h>
 #include <Shaders/shader.h>
 #include <string>
 #include <sstream>
-#include <Textures/stb_image.h>
+#include <Textures/textureCompression.h>
+#include <Textures/textureRegistry.h>
+#include <Textures/textureStreamer.h>
+#include <unordered_map>
+#include <Utility/assets.h>
+#include <Utility/hash.h>
+#include <Utility/threadPool.h>
+#include <Utility/timer.h>
 #include <vector>
 
 using namespace std;
 
-unsigned int configureTexture(const char* path, const string& directory);
+// Knobs for how a Model is imported and kept around
+struct ModelLoadOptions
+{
+    // Keep each Mesh's vertices and indices in RAM after upload. Only needed if something wants to read the
+    // geometry back on the CPU later, otherwise it's just duplicated memory.
+    bool keepCpuMeshData = false;
+
+    // Merge each mesh's duplicate vertices at import time (OBJ files come in with one per face corner). Vertices
+    // closer than weldTolerances in every attribute are merged, see VertexWelder.
+    bool weldVertices = true;
+    VertexWeldTolerances weldTolerances;
+
+    // Build MikkTSpace style tangents at import time for normal mapping (see TangentGenerator). Meshes imported without
+    // them get a zero tangent and draw without their normal maps.
+    bool generateTangents = true;
+
+    // Reorder each mesh's triangles and vertices for GPU vertex cache and fetch locality at import time
+    bool optimizeVertexCache = true;
+
+    // Split meshes with more than 65536 vertices into pieces that can all use 16-bit indices
+    bool splitLargeMeshes = true;
+
+    // GPU vertex layout. Quantized nearly halves the vertex size at the cost of a little precision (the errors are
+    // logged on load). The mesh cache always stores full precision vertices, so this doesn't affect importHash().
+    VertexFormat vertexFormat = VertexFormat::Float;
+
+    // Block compression for each kind of material texture, None uploads them uncompressed. Compressed textures are
+    // cached next to their source image, so only the first load pays for the encode. Normal maps keep just x and y
+    // in BC5, so shaders have to rebuild z.
+    TextureCompression diffuseCompression = TextureCompression::BC7;
+    TextureCompression specularCompression = TextureCompression::BC1;
+    TextureCompression normalCompression = TextureCompression::BC5;
+
+    // Stream each material texture's mip levels in and out according to how big the model is on screen (needs
+    // draw() with a DrawView, otherwise textures stay at their low resolution tail), instead of uploading them whole
+    bool streamTextures = true;
+
+    // Number of simplified detail levels to build for each mesh, on top of the full detail one (0 turns LODs off).
+    // Each level aims for lodTriangleRatio of the previous level's triangles, without letting the surface move
+    // further than its lodTargetErrors entry (as a fraction of the mesh's bounding box diagonal). A mesh that can't
+    // be simplified further within its error budget ends up with fewer levels.
+    unsigned int lodLevels = 4;
+    float lodTriangleRatio = 0.5f;
+    float lodTargetErrors[MAX_MESH_LODS - 1] = { 0.002f, 0.005f, 0.01f, 0.02f };
+
+    // Group each mesh's full detail triangles into meshlets, so draws can skip the ones facing away from the camera
+    // or outside the frustum
+    bool buildMeshlets = true;
+
+    // Hash of every option that changes the imported geometry, so the mesh cache can tell when it was built
+    // with different settings
+    uint64_t importHash() const
+    {
+        uint64_t hash = FNV_OFFSET_BASIS;
+        hash = hashBytes(&this->weldVertices, sizeof(this->weldVertices), hash);
+        hash = hashBytes(&this->weldTolerances, sizeof(this->weldTolerances), hash);
+        hash = hashBytes(&this->generateTangents, sizeof(this->generateTangents), hash);
+        hash = hashBytes(&this->optimizeVertexCache, sizeof(this->optimizeVertexCache), hash);
+        hash = hashBytes(&this->splitLargeMeshes, sizeof(this->splitLargeMeshes), hash);
+        hash = hashBytes(&this->lodLevels, sizeof(this->lodLevels), hash);
+        hash = hashBytes(&this->lodTriangleRatio, sizeof(this->lodTriangleRatio), hash);
+        hash = hashBytes(this->lodTargetErrors, sizeof(this->lodTargetErrors), hash);
+        hash = hashBytes(&this->buildMeshlets, sizeof(this->buildMeshlets), hash);
+        return hash;
+    }
+};
+
+// What Model::draw needs to know about the camera to pick a detail level for each mesh and cull its meshlets
+struct DrawView
+{
+    // World space camera position
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+
+    // Transform the Model is being drawn with
+    glm::mat4 modelMatrix = glm::mat4(1.0f);
+
+    // Camera projection * view, for frustum culling
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+
+    // Pixels covered by one world space unit, one unit in front of the camera (see projectionScaleFor())
+    float projectionScale = 1.0f;
+
+    // Largest geometric error, in pixels, we're willing to let a simplified mesh put on screen
+    float maxScreenError = 1.0f;
+
+    // Skip meshlets that face away from the camera or are outside the frustum (full detail meshes only)
+    bool cullMeshlets = true;
+
+    static float projectionScaleFor(float viewportHeight, float verticalFieldOfViewRadians)
+    {
+        return viewportHeight / (2.0f * tan(verticalFieldOfViewRadians * 0.5f));
+    }
+};
+
+// What the last Model::draw actually drew at each detail level, and what meshlet culling saved
+struct ModelDrawStats
+{
+    array<unsigned int, MAX_MESH_LODS> meshCounts = {};
+    array<size_t, MAX_MESH_LODS> triangleCounts = {};
+    MeshletCullingStats meshletCulling;
+
+    // Only compares the detail levels, culling changes with every camera move
+    bool sameLods(const ModelDrawStats& other) const
+    {
+        return this->meshCounts == other.meshCounts && this->triangleCounts == other.triangleCounts;
+    }
+};
+
+// Closer to a mesh's bounding sphere than this and we treat the camera as inside it
+const float MIN_VIEW_DISTANCE = 1e-3f;
 
 class Model
 {
     public:
-        Model(const char* path)
+        Model(const char* path, const ModelLoadOptions& options = ModelLoadOptions())
+            : options(options)
         {
             this->loadModel(path);
         }
 
+        // Draws every mesh at full detail
         void draw(Shader& shader)
         {
-            unsigned int meshCount = this->meshes.size();
-            for (unsigned int i = 0; i < meshCount; i++)
+            this->drawQueue.clear();
+            this->submitMeshes(this->drawQueue, shader, nullptr);
+            this->drawQueue.execute();
+        }
+
+        // Draws every mesh at the coarsest detail level whose error projects to no more than view.maxScreenError
+        // pixels, culling the meshlets of full detail meshes if view.cullMeshlets is set
+        void draw(Shader& shader, const DrawView& view)
+        {
+            this->drawQueue.clear();
+            this->submitMeshes(this->drawQueue, shader, &view);
+            this->drawQueue.execute();
+        }
+
+        // Same as draw(shader, view), but adds the meshes to a queue shared with the rest of the frame, to be sorted
+        // along with everything else. The draw stats are complete once the queue has been executed, and the queue
+        // has to be executed before this Model is submitted again.
+        void submit(RenderQueue& queue, Shader& shader, const DrawView& view)
+        {
+            this->submitMeshes(queue, shader, &view);
+        }
+
+        // Draws every mesh at full detail once per instance, a draw call per mesh rather than per mesh per instance.
+        // The shader has to be built with INSTANCED_SHADER_DEFINE.
+        void drawInstanced(Shader& shader, InstanceBuffer& instances)
+        {
+            for (Mesh& mesh : this->meshes)
             {
-                this->meshes[i].draw(shader);
+                mesh.drawInstanced(shader, instances);
             }
         }
 
+        const ModelDrawStats& lastDrawStats() const
+        {
+            return this->drawStats;
+        }
+
+        // Model space bounds of every mesh together. Each mesh's own are in Mesh::bounds().
+        const BoundingVolume& bounds() const
+        {
+            return this->modelBounds;
+        }
+
+        size_t meshCount() const
+        {
+            return this->meshes.size();
+        }
+
+        const Mesh& mesh(size_t index) const
+        {
+            return this->meshes[index];
+        }
+
         void freeResources()
         {
             unsigned int meshCount = this->meshes.size();
@@ -45,17 +227,185 @@ class Model
             {
                 this->meshes[i].freeResources();
             }
+
+            // Our geometry left holes in the arena, squeeze them out if they're worth it
+            GeometryArena::instance(this->options.vertexFormat).compactIfFragmented();
+
+            // Textures can be shared with other Models, so just drop our references and let the registry decide
+            for (const auto& loadedTexture : this->loadedTextures)
+            {
+                TextureRegistry::instance().release(loadedTexture.second);
+            }
+
+            this->loadedTextures.clear();
         }
 
     private:
         // Model data
-        vector<Texture> loadedTextures;
+        // Maps each texture's type and path (relative to the model's directory) to the GL texture we hold a reference to
+        unordered_map<string, unsigned int> loadedTextures;
         vector<Mesh> meshes;
+        BoundingVolume modelBounds;
         string directory;
+        ModelLoadOptions options;
+        ModelDrawStats drawStats;
+
+        // Brings the camera into model space for meshlet culling, for the draws of the last submit
+        MeshletCuller culler;
+
+        // For when we're drawn on our own, rather than as part of someone else's queue
+        RenderQueue drawQueue;
+
+        // Submits every mesh, at full detail and without culling if view is null
+        void submitMeshes(RenderQueue& queue, Shader& shader, const DrawView* view)
+        {
+            this->drawStats = ModelDrawStats();
+
+            // The largest scale in the model matrix turns model space errors and radii into (upper bounds on) world space ones
+            float modelScale = 1.0f;
+            if (view)
+            {
+                const glm::mat4& modelMatrix = view->modelMatrix;
+                modelScale = max(glm::length(glm::vec3(modelMatrix[0])), max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+            }
+
+            // Every mesh shares the model matrix, so the camera only has to be brought into model space once
+            bool culling = view && view->cullMeshlets;
+            if (culling)
+            {
+                this->culler = MeshletCuller::fromMatrices(view->modelMatrix, view->viewProjection, view->cameraPosition);
+            }
+
+            unsigned int meshCount = this->meshes.size();
+            for (unsigned int i = 0; i < meshCount; i++)
+            {
+                Mesh& mesh = this->meshes[i];
+                unsigned int lod = view ? this->selectLod(mesh, *view, modelScale) : 0;
+
+                // The queue groups meshes by their material and textures, and then orders them front to back
+                DrawSubmission submission;
+                submission.shader = &shader;
+                submission.material = mesh.materialId;
+                submission.mesh = &mesh;
+                submission.lod = lod;
+                submission.culler = culling ? &this->culler : nullptr;
+                submission.cullingStats = &this->drawStats.meshletCulling;
+                submission.depth = view ? this->distanceToBounds(mesh, *view, modelScale) + mesh.radius() * modelScale : 0.0f;
+                queue.submit(submission);
+
+                // Let the streamer know how much of our textures can actually be seen
+                if (view && this->options.streamTextures)
+                {
+                    float screenSize = this->screenDiameter(mesh, *view, modelScale);
+                    for (const Texture& texture : mesh.textures)
+                    {
+                        TextureStreamer::instance().requestScreenSize(texture.id, screenSize);
+                    }
+                }
+
+                if (lod < mesh.lodCount())
+                {
+                    this->drawStats.meshCounts[lod]++;
+                    this->drawStats.triangleCounts[lod] += mesh.lodTriangleCount(lod);
+                }
+            }
+        }
+
+        // Picks the coarsest LOD whose error, projected from the nearest point of the mesh's bounding sphere,
+        // stays within the screen space error budget
+        unsigned int selectLod(const Mesh& mesh, const DrawView& view, float modelScale) const
+        {
+            float distance = this->distanceToBounds(mesh, view, modelScale);
+
+            // Inside (or right up against) the bounding sphere, anything but full detail could be visible
+            if (distance < MIN_VIEW_DISTANCE)
+            {
+                return 0;
+            }
+
+            unsigned int selectedLod = 0;
+            for (unsigned int lod = 1; lod < mesh.lodCount(); lod++)
+            {
+                float screenError = mesh.lodError(lod) * modelScale / distance * view.projectionScale;
+                if (screenError > view.maxScreenError)
+                {
+                    break;
+                }
+
+                selectedLod = lod;
+            }
+
+            return selectedLod;
+        }
+
+        // Distance from the camera to the nearest point of the mesh's bounding sphere (negative inside it)
+        float distanceToBounds(const Mesh& mesh, const DrawView& view, float modelScale) const
+        {
+            glm::vec3 worldCenter = glm::vec3(view.modelMatrix * glm::vec4(mesh.center(), 1.0f));
+            return glm::length(worldCenter - view.cameraPosition) - mesh.radius() * modelScale;
+        }
+
+        // Roughly how many pixels across the mesh covers on screen
+        float screenDiameter(const Mesh& mesh, const DrawView& view, float modelScale) const
+        {
+            float distance = max(this->distanceToBounds(mesh, view, modelScale), MIN_VIEW_DISTANCE);
+            return 2.0f * mesh.radius() * modelScale / distance * view.projectionScale;
+        }
 
         void loadModel(string path)
         {
+            Timer loadTimer;
+            this->directory = path.substr(0, path.find_last_of('/'));
+
+            // Try the binary mesh cache first so warm starts skip Assimp entirely
+            ModelData modelData;
+            string cachePath = MeshCache::cachePathFor(path);
+            uint64_t sourceHash = 0;
+            bool sourceHashed = MeshCache::hashSourceFile(path, sourceHash);
+
+            // The cache also has to be rebuilt if we'd now import the same file differently
+            uint64_t importHash = this->options.importHash();
+            sourceHash = hashBytes(&importHash, sizeof(importHash), sourceHash);
+
+            if (sourceHashed && MeshCache::read(cachePath, sourceHash, modelData))
+            {
+                double cacheReadTime = loadTimer.elapsedMilliseconds();
+                this->setupMeshes(std::move(modelData));
+
+                cout << "MODEL::MESH_CACHE_HIT::" << path << " (cache read " << cacheReadTime << " ms, total "
+                    << loadTimer.elapsedMilliseconds() << " ms)" << endl;
+                return;
+            }
+
+            if (!this->importModel(path, modelData))
+            {
+                return;
+            }
+
+            double importTime = loadTimer.elapsedMilliseconds();
+
+            Timer cacheWriteTimer;
+            bool cacheWritten = sourceHashed && MeshCache::write(cachePath, sourceHash, modelData);
+            double cacheWriteTime = cacheWriteTimer.elapsedMilliseconds();
+
+            if (!cacheWritten)
+            {
+                cout << "ERROR::MESH_CACHE::Failed to write " << cachePath << endl;
+            }
+
+            this->setupMeshes(std::move(modelData));
+
+            cout << "MODEL::MESH_CACHE_MISS::" << path << " (import " << importTime << " ms using "
+                << sharedThreadPool().threadCount() + 1 << " threads, cache write " << cacheWriteTime
+                << " ms, total " << loadTimer.elapsedMilliseconds() << " ms)" << endl;
+        }
+
+        // Runs the full Assimp import, converting the scene into our own CPU-side ModelData
+        bool importModel(const string& path, ModelData& modelData)
+        {
+            // Assimp opens the OBJ and everything it references through Assets too, straight out of the mapping
             Assimp::Importer import;
+            import.SetIOHandler(new AssetIOSystem());
             const aiScene* scene = import.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
 
             if (!scene
@@ -63,50 +413,297 @@ class Model
                 || !scene->mRootNode)
             {
                 cout << "ERROR::ASSIMP::" << import.GetErrorString() << endl;
+                return false;
+            }
+
+            unsigned int materialCount = scene->mNumMaterials;
+            modelData.materials.reserve(materialCount);
+            for (unsigned int i = 0; i < materialCount; i++)
+            {
+                modelData.materials.push_back(this->processMaterial(scene->mMaterials[i]));
+            }
+
+            // Walk the node tree up front to get a flat list of meshes in traversal order, then convert them all in
+            // parallel. Each worker writes into its own slot, so the final mesh order is the same as a serial walk.
+            vector<const aiMesh*> meshWorkItems;
+            this->processNode(scene->mRootNode, scene, meshWorkItems);
+
+            size_t meshCount = meshWorkItems.size();
+            modelData.meshes.resize(meshCount);
+            vector<VertexCacheStats> statsBefore(meshCount), statsAfter(meshCount);
+            vector<VertexWeldStats> weldStats(meshCount);
+            vector<TangentGenerationStats> tangentStats(meshCount);
+            sharedThreadPool().parallelFor(meshCount, [&](size_t i)
+            {
+                MeshData& meshData = modelData.meshes[i];
+                meshData = this->processMesh(meshWorkItems[i]);
+
+                if (this->options.weldVertices)
+                {
+                    weldStats[i] = VertexWelder::weld(meshData.vertices, meshData.indices, this->options.weldTolerances);
+                }
+
+                // After welding, so each vertex averages the tangents of every triangle sharing it
+                if (this->options.generateTangents)
+                {
+                    tangentStats[i] = TangentGenerator::generate(meshData.vertices, meshData.indices);
+                }
+
+                if (this->options.optimizeVertexCache)
+                {
+                    statsBefore[i] = VertexCacheOptimizer::analyze(meshData.indices, meshData.vertices.size());
+                    VertexCacheOptimizer::optimizeVertexCache(meshData.indices, meshData.vertices.size());
+                    VertexCacheOptimizer::optimizeVertexFetch(meshData.vertices, meshData.indices);
+                    statsAfter[i] = VertexCacheOptimizer::analyze(meshData.indices, meshData.vertices.size());
+                }
+            });
+
+            if (this->options.weldVertices)
+            {
+                this->reportWeld(path, meshWorkItems, weldStats);
+            }
+
+            if (this->options.generateTangents)
+            {
+                TangentGenerationStats totalTangentStats;
+                for (const TangentGenerationStats& stats : tangentStats)
+                {
+                    totalTangentStats += stats;
+                }
+
+                cout << "MODEL::TANGENTS::" << path << " " << totalTangentStats.vertexCount << " vertices, "
+                    << totalTangentStats.splitVertexCount << " split at mirrored UV seams, " << totalTangentStats.degenerateUvTriangleCount
+                    << " triangles without UV area" << endl;
+            }
+
+            if (this->options.optimizeVertexCache)
+            {
+                VertexCacheStats totalBefore, totalAfter;
+                for (size_t i = 0; i < meshCount; i++)
+                {
+                    totalBefore += statsBefore[i];
+                    totalAfter += statsAfter[i];
+                }
+
+                cout << "MODEL::VERTEX_CACHE::" << path << " ACMR " << totalBefore.acmr() << " -> " << totalAfter.acmr()
+                    << ", ATVR " << totalBefore.atvr() << " -> " << totalAfter.atvr() << endl;
+            }
+
+            if (this->options.splitLargeMeshes)
+            {
+                this->splitLargeMeshes(modelData);
+            }
+
+            // Once the meshes are in their final pieces, and before the LODs, which are sized by the bounds
+            this->computeBounds(path, modelData);
+
+            if (this->options.lodLevels > 0)
+            {
+                this->generateLods(path, modelData);
+            }
+
+            // Last, as it reorders the full detail triangles (the LODs have been built from them by now)
+            if (this->options.buildMeshlets)
+            {
+                this->buildMeshlets(path, modelData);
+            }
+
+            return true;
+        }
+
+        void reportWeld(const string& path, const vector<const aiMesh*>& meshes, const vector<VertexWeldStats>& weldStats)
+        {
+            VertexWeldStats total;
+            for (size_t i = 0; i < weldStats.size(); i++)
+            {
+                const VertexWeldStats& stats = weldStats[i];
+                total += stats;
+
+                cout << "MODEL::WELD::" << path << " mesh " << i << " (" << meshes[i]->mName.C_Str() << ") " << stats.vertexCount
+                    << " -> " << stats.weldedVertexCount << " vertices (" << stats.reduction() * 100.0f << "% fewer)";
+                if (stats.degenerateTriangleCount > 0)
+                {
+                    cout << ", " << stats.degenerateTriangleCount << " collapsed triangles dropped";
+                }
+
+                cout << endl;
+            }
+
+            cout << "MODEL::WELD::" << path << " total " << total.vertexCount << " -> " << total.weldedVertexCount << " vertices ("
+                << total.reduction() * 100.0f << "% fewer)" << endl;
+        }
+
+        // Replaces every mesh that's too big for 16-bit indices with pieces that aren't, keeping the mesh order
+        void splitLargeMeshes(ModelData& modelData)
+        {
+            vector<MeshData> splitMeshes;
+            splitMeshes.reserve(modelData.meshes.size());
+
+            for (MeshData& meshData : modelData.meshes)
+            {
+                for (MeshData& piece : MeshSplitter::split(std::move(meshData)))
+                {
+                    splitMeshes.push_back(std::move(piece));
+                }
+            }
+
+            modelData.meshes = std::move(splitMeshes);
+        }
+
+        void computeBounds(const string& path, ModelData& modelData)
+        {
+            Timer boundsTimer;
+            sharedThreadPool().parallelFor(modelData.meshes.size(), [&](size_t i)
+            {
+                MeshData& meshData = modelData.meshes[i];
+                meshData.bounds = BoundsBuilder::build(meshData.vertices);
+            });
+
+            BoundingVolume bounds;
+            for (const MeshData& meshData : modelData.meshes)
+            {
+                bounds.merge(meshData.bounds);
+            }
+
+            glm::vec3 size = bounds.size();
+            cout << "MODEL::BOUNDS::" << path << " (" << boundsTimer.elapsedMilliseconds() << " ms) box " << size.x << " x " << size.y
+                << " x " << size.z << ", sphere radius " << bounds.radius << endl;
+        }
+
+        // Builds each mesh's simplified detail levels on the worker threads, then logs the triangle counts per level
+        void generateLods(const string& path, ModelData& modelData)
+        {
+            Timer lodTimer;
+            sharedThreadPool().parallelFor(modelData.meshes.size(), [&](size_t i)
+            {
+                this->generateMeshLods(modelData.meshes[i]);
+            });
+
+            array<size_t, MAX_MESH_LODS> triangleCounts = {};
+            array<float, MAX_MESH_LODS> maxErrors = {};
+            for (const MeshData& meshData : modelData.meshes)
+            {
+                triangleCounts[0] += meshData.indices.size() / 3;
+                for (size_t lod = 0; lod < meshData.lods.size(); lod++)
+                {
+                    triangleCounts[lod + 1] += meshData.lods[lod].indices.size() / 3;
+                    maxErrors[lod + 1] = max(maxErrors[lod + 1], meshData.lods[lod].error);
+                }
+            }
+
+            cout << "MODEL::LOD::" << path << " (" << lodTimer.elapsedMilliseconds() << " ms)";
+            for (unsigned int lod = 0; lod < MAX_MESH_LODS && triangleCounts[lod] > 0; lod++)
+            {
+                cout << (lod == 0 ? " " : ", ") << "LOD" << lod << " " << triangleCounts[lod] << " triangles";
+                if (lod > 0)
+                {
+                    cout << " (max error " << maxErrors[lod] << ")";
+                }
+            }
+
+            cout << endl;
+        }
+
+        void buildMeshlets(const string& path, ModelData& modelData)
+        {
+            Timer meshletTimer;
+            sharedThreadPool().parallelFor(modelData.meshes.size(), [&](size_t i)
+            {
+                MeshData& meshData = modelData.meshes[i];
+                meshData.meshlets = MeshletBuilder::build(meshData.vertices, meshData.indices);
+            });
+
+            size_t meshletCount = 0, triangleCount = 0, cullableCount = 0;
+            for (const MeshData& meshData : modelData.meshes)
+            {
+                meshletCount += meshData.meshlets.size();
+                triangleCount += meshData.indices.size() / 3;
+                for (const MeshletData& meshlet : meshData.meshlets)
+                {
+                    cullableCount += meshlet.coneCutoff < 1.0f ? 1 : 0;
+                }
+            }
+
+            cout << "MODEL::MESHLETS::" << path << " (" << meshletTimer.elapsedMilliseconds() << " ms) " << meshletCount << " meshlets, "
+                << (meshletCount > 0 ? static_cast<float>(triangleCount) / meshletCount : 0.0f) << " triangles each on average, "
+                << cullableCount << " backface cullable" << endl;
+        }
+
+        void generateMeshLods(MeshData& meshData)
+        {
+            if (meshData.vertices.empty())
+            {
                 return;
             }
 
-            this->directory = path.substr(0, path.find_last_of('/'));
+            float meshSize = glm::length(meshData.bounds.size());
+
+            // Each level is simplified from the one before it, so its error is at most the sum of the errors so far
+            unsigned int levelCount = min(this->options.lodLevels, MAX_MESH_LODS - 1);
+            meshData.lods.reserve(levelCount);
+
+            float accumulatedError = 0.0f;
+            for (unsigned int level = 0; level < levelCount; level++)
+            {
+                const vector<unsigned int>& source = level == 0 ? meshData.indices : meshData.lods.back().indices;
+                size_t targetIndexCount = static_cast<size_t>(source.size() / 3 * this->options.lodTriangleRatio) * 3;
+                float errorBudget = this->options.lodTargetErrors[level] * meshSize - accumulatedError;
+                if (errorBudget <= 0.0f)
+                {
+                    break;
+                }
 
-            this->processNode(scene->mRootNode, scene, 1);
-            // cout << "Finished loading model" << endl;
+                float levelError;
+                vector<unsigned int> lodIndices = MeshSimplifier::simplify(meshData.vertices, source, targetIndexCount, errorBudget, levelError);
+
+                // A level that barely removes anything costs index memory without saving any work
+                const float MIN_LOD_REDUCTION = 0.9f;
+                if (lodIndices.empty() || lodIndices.size() > source.size() * MIN_LOD_REDUCTION)
+                {
+                    break;
+                }
+
+                if (this->options.optimizeVertexCache)
+                {
+                    VertexCacheOptimizer::optimizeVertexCache(lodIndices, meshData.vertices.size());
+                }
+
+                accumulatedError += levelError;
+
+                MeshLod lod;
+                lod.indices = std::move(lodIndices);
+                lod.error = accumulatedError;
+                meshData.lods.push_back(std::move(lod));
+            }
         }
 
-        void processNode(aiNode* node, const aiScene* scene, int count)
+        void processNode(const aiNode* node, const aiScene* scene, vector<const aiMesh*>& meshWorkItems)
         {
-            // Process this node's meshes
+            // Queue up this node's meshes
             unsigned int meshCount = node->mNumMeshes;
-            //cout << "Mesh count for node " << count << " is " << meshCount << endl;
             for (unsigned int i = 0; i < meshCount; i++)
             {
                 unsigned int meshIndex = node->mMeshes[i];
-                aiMesh* mesh = scene->mMeshes[meshIndex];
-
-                Mesh processedMesh = processMesh(mesh, scene);
-                meshes.push_back(processedMesh);
+                meshWorkItems.push_back(scene->mMeshes[meshIndex]);
             }
 
-            //cout << "Finished processing meshes for node " << count << endl;
-
             // Recursively process this node's child nodes
             unsigned int childCount = node->mNumChildren;
-
-            //cout << "Child count for node " << count << " is " << childCount << endl;
-
             for (unsigned int i = 0; i < childCount; i++)
             {
-                aiNode* child = node->mChildren[i];
-                processNode(child, scene, ++count);
+                const aiNode* child = node->mChildren[i];
+                processNode(child, scene, meshWorkItems);
             }
         }
 
-        Mesh processMesh(aiMesh* mesh, const aiScene* scene)
+        // Converts a single aiMesh into our vertex/index layout. Only reads from the scene, so it's safe to run
+        // on several meshes at once from the worker threads.
+        MeshData processMesh(const aiMesh* mesh)
         {
-            vector<Vertex> vertices;
-            vector<unsigned int> indices;
-            vector<Texture> textures;
+            MeshData meshData;
 
             unsigned int numVertices = mesh->mNumVertices;
+            meshData.vertices.reserve(numVertices);
             for (unsigned int i = 0; i < numVertices; i++)
             {
                 Vertex vertex;
@@ -137,131 +734,210 @@ class Model
                     vertex.texCoords = glm::vec2(0.0f, 0.0f);
                 }
 
-                vertices.push_back(vertex);
+                meshData.vertices.push_back(vertex);
             }
 
-            // Process indices
+            // Process indices (aiProcess_Triangulate guarantees 3 per face)
+            meshData.indices.reserve(mesh->mNumFaces * 3);
             for (unsigned int i = 0; i < mesh->mNumFaces; i++)
             {
-                aiFace face = mesh->mFaces[i];
+                const aiFace& face = mesh->mFaces[i];
 
                 unsigned int numIndices = face.mNumIndices;
                 for (unsigned int j = 0; j < numIndices; j++)
                 {
                     unsigned int index = face.mIndices[j];
-                    indices.push_back(index);
+                    meshData.indices.push_back(index);
                 }
             }
 
-            // Process material
-            // 
-            // Question: mMaterialIndex is an unsigned int, so is the following check necessary?
-            // Doesn't it have to be 0 or larger?
-            unsigned int meshMaterialIndex = mesh->mMaterialIndex;
-            if (meshMaterialIndex >= 0)
-            {
-                aiMaterial* material = scene->mMaterials[meshMaterialIndex];
+            meshData.materialIndex = mesh->mMaterialIndex;
+            return meshData;
+        }
 
-                // TODO: We really should store the "texture_diffuse" and "texture_specular" strings as global constants somewhere
-                // so they only have to be updated in a single location
-                vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-                textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+        MaterialData processMaterial(aiMaterial* material)
+        {
+            MaterialData materialData;
 
-                vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-                textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-            }
+            // TODO: We really should store the "texture_diffuse" and "texture_specular" strings as global constants somewhere
+            // so they only have to be updated in a single location
+            this->processMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", materialData);
+            this->processMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", materialData);
+
+            // Assimp files an OBJ's map_Bump under height maps, but like most exporters Blender writes the normal map
+            // there, so we take those as normal maps too
+            this->processMaterialTextures(material, aiTextureType_NORMALS, "texture_normal", materialData);
+            this->processMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal", materialData);
 
-            return Mesh(vertices, indices, textures);
+            return materialData;
         }
 
-        vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName)
+        void processMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName, MaterialData& materialData)
         {
-            vector<Texture> textures;
-
             unsigned int textureCount = mat->GetTextureCount(type);
             for (unsigned int i = 0; i < textureCount; i++)
             {
-                bool skip = false;
-                Texture currentTexture;
-
                 aiString filePath;
                 mat->GetTexture(type, i, &filePath);
 
-                unsigned int loadedTexturesCount = this->loadedTextures.size();
-                for (unsigned int j = 0; j < loadedTexturesCount; j++)
+                MaterialTextureData texture;
+                texture.type = typeName;
+                texture.path = filePath.C_Str();
+                materialData.textures.push_back(texture);
+            }
+        }
+
+        // Loads every material's textures and creates the GPU side meshes. Needs the GL context.
+        // The geometry is moved straight into each Mesh, so modelData is left empty.
+        void setupMeshes(ModelData&& modelData)
+        {
+            unsigned int materialCount = modelData.materials.size();
+            vector<vector<Texture>> materialTextures(materialCount);
+            for (unsigned int i = 0; i < materialCount; i++)
+            {
+                materialTextures[i] = this->loadMaterialTextures(modelData.materials[i]);
+            }
+
+            // Ids of our own for the materials, so the render queue keeps each one's meshes together without
+            // mistaking another model's material for ours
+            unsigned int firstMaterialId = allocateMaterialIds(std::max(materialCount, 1u));
+
+            unsigned int meshCount = modelData.meshes.size();
+
+            // Quantization only needs the CPU side data, so it can run across the worker threads before we touch GL
+            bool quantize = this->options.vertexFormat == VertexFormat::Quantized;
+            vector<QuantizedVertexData> quantizedMeshes;
+            if (quantize)
+            {
+                Timer quantizeTimer;
+                quantizedMeshes.resize(meshCount);
+                vector<QuantizationError> quantizationErrors(meshCount);
+                sharedThreadPool().parallelFor(meshCount, [&](size_t i)
                 {
-                    currentTexture = this->loadedTextures[j];
-                    if (std::strcmp(currentTexture.path.data(), filePath.C_Str()) == 0)
-                    {
-                        textures.push_back(currentTexture);
+                    quantizedMeshes[i] = VertexQuantizer::quantize(modelData.meshes[i].vertices, quantizationErrors[i]);
+                });
 
-                        skip = true;
-                        break;
-                    }
+                QuantizationError totalError;
+                for (const QuantizationError& error : quantizationErrors)
+                {
+                    totalError += error;
                 }
 
-                if (!skip)
+                cout << "MODEL::VERTEX_QUANTIZATION::" << totalError.vertexCount << " vertices, " << sizeof(Vertex) << " -> "
+                    << sizeof(QuantizedVertex) << " bytes/vertex in " << quantizeTimer.elapsedMilliseconds() << " ms (position error max "
+                    << totalError.maxPositionError << " avg " << totalError.averagePositionError() << ", normal error max "
+                    << totalError.maxNormalError << " avg " << totalError.averageNormalError() << " degrees, UV error max "
+                    << totalError.maxTexCoordError << ")" << endl;
+            }
+
+            size_t shortIndexedMeshCount = 0, indexBytes = 0, intIndexBytes = 0;
+            for (const MeshData& meshData : modelData.meshes)
+            {
+                GLenum indexType = indexTypeFor(meshData.vertices.size());
+                shortIndexedMeshCount += indexType == GL_UNSIGNED_SHORT ? 1 : 0;
+                size_t indexCount = meshData.indices.size();
+                for (const MeshLod& lod : meshData.lods)
                 {
-                    Texture currentTexture;
-                    currentTexture.id = configureTexture(filePath.C_Str(), directory);
-                    currentTexture.type = typeName;
-                    currentTexture.path = filePath.C_Str();
-                    textures.push_back(currentTexture);
-                    this->loadedTextures.push_back(currentTexture);
+                    indexCount += lod.indices.size();
                 }
+
+                indexBytes += indexCount * indexTypeSize(indexType);
+                intIndexBytes += indexCount * sizeof(unsigned int);
             }
 
-            return textures;
-        }
-};
+            cout << "MODEL::INDEX_BUFFERS::" << shortIndexedMeshCount << "/" << meshCount << " meshes use 16-bit indices ("
+                << indexBytes / 1024 << " KB instead of " << intIndexBytes / 1024 << " KB)" << endl;
 
-unsigned int configureTexture(const char* path, const string& directory)
-{
-    unsigned int texture;
-    int width, height, nrChannels;
+            this->meshes.reserve(this->meshes.size() + meshCount);
+            for (unsigned int i = 0; i < meshCount; i++)
+            {
+                MeshData& meshData = modelData.meshes[i];
 
-    string filename = string(path);
-    filename = directory + '/' + filename;
+                vector<Texture> textures;
+                if (meshData.materialIndex < materialCount)
+                {
+                    textures = materialTextures[meshData.materialIndex];
+                }
 
-    unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrChannels, 0);
+                if (quantize)
+                {
+                    this->meshes.emplace_back(std::move(quantizedMeshes[i]), std::move(meshData.indices), std::move(textures), meshData.bounds,
+                        std::move(meshData.lods), std::move(meshData.meshlets));
+                }
+                else
+                {
+                    this->meshes.emplace_back(std::move(meshData.vertices), std::move(meshData.indices), std::move(textures), meshData.bounds,
+                        std::move(meshData.lods), std::move(meshData.meshlets));
+                }
 
-    if (data)
-    {
-        glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        // TODO: Again, is this a proper initialization? We need a good default to avoid the unitialized memory issue
-        GLenum format = 0;
-        if (nrChannels == 1)
-        {
-            format = GL_RED;
-        }
-        else if (nrChannels == 3)
-        {
-            format = GL_RGB;
+                this->meshes.back().materialId = firstMaterialId + (meshData.materialIndex < materialCount ? meshData.materialIndex : 0);
+                this->modelBounds.merge(meshData.bounds);
+
+                if (!this->options.keepCpuMeshData)
+                {
+                    this->meshes.back().releaseCpuData();
+                }
+            }
+
+            GeometryArenaStats arenaStats = GeometryArena::instance(this->options.vertexFormat).stats();
+            cout << "MODEL::GEOMETRY_ARENA::" << arenaStats.allocationCount << " meshes, vertices " << arenaStats.verticesUsed << "/"
+                << arenaStats.vertexCapacity << " (" << arenaStats.vertexOccupancy() * 100.0f << "% used, " << arenaStats.vertexFragmentation * 100.0f
+                << "% fragmented), indices " << arenaStats.indexBytesUsed / 1024 << "/" << arenaStats.indexCapacityBytes / 1024 << " KB ("
+                << arenaStats.indexOccupancy() * 100.0f << "% used, " << arenaStats.indexFragmentation * 100.0f << "% fragmented)" << endl;
         }
-        else if (nrChannels == 4)
+
+        vector<Texture> loadMaterialTextures(const MaterialData& material)
         {
-            format = GL_RGBA;
+            vector<Texture> textures;
+            textures.reserve(material.textures.size());
+
+            for (const MaterialTextureData& materialTexture : material.textures)
+            {
+                TextureLoadParameters parameters = this->loadParametersFor(materialTexture.type);
+
+                // Only take one registry reference per texture per Model, however many meshes use it
+                string textureKey = materialTexture.type + ':' + materialTexture.path;
+                auto loadedTexture = this->loadedTextures.find(textureKey);
+                if (loadedTexture == this->loadedTextures.end())
+                {
+                    string texturePath = this->directory + '/' + materialTexture.path;
+                    unsigned int id = this->options.streamTextures
+                        ? TextureRegistry::instance().acquireStreamed(texturePath, parameters)
+                        : TextureRegistry::instance().acquireAsync(texturePath, parameters);
+                    loadedTexture = this->loadedTextures.emplace(textureKey, id).first;
+                }
+
+                Texture currentTexture;
+                currentTexture.id = loadedTexture->second;
+                currentTexture.type = materialTexture.type;
+                currentTexture.path = materialTexture.path;
+                textures.push_back(currentTexture);
+            }
+
+            return textures;
         }
 
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        // Only diffuse maps hold colour, everything else is data and mustn't be filtered as sRGB
+        TextureLoadParameters loadParametersFor(const string& textureType) const
+        {
+            TextureLoadParameters parameters;
+            parameters.srgbEncoded = textureType == "texture_diffuse";
 
-        stbi_image_free(data);
-        return texture;
-    }
-    else
-    {
-        cout << "Failed to load texture" << endl;
+            if (textureType == "texture_diffuse")
+            {
+                parameters.compression = this->options.diffuseCompression;
+            }
+            else if (textureType == "texture_specular")
+            {
+                parameters.compression = this->options.specularCompression;
+            }
+            else if (textureType == "texture_normal")
+            {
+                parameters.compression = this->options.normalCompression;
+            }
 
-        stbi_image_free(data);
-        return 0;
-    }
-}
+            return parameters;
+        }
+};
 
 #endif
\ No newline at end of file
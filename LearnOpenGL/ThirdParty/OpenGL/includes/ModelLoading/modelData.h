@@ -0,0 +1,89 @@
+#ifndef MODEL_DATA_H
+#define MODEL_DATA_H
+
+#include <ModelLoading/boundingVolume.h>
+#include <ModelLoading/vertex.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// CPU-side representation of a model, sitting between the importer (or the mesh cache) and the GPU.
+//
+// Nothing in here touches OpenGL, so it can be built, processed and serialized without a context.
+// Model turns it into Mesh objects once it's complete.
+
+// Most detail levels a mesh can have, including the full detail one
+const unsigned int MAX_MESH_LODS = 5;
+
+// A simplified version of a mesh. It reuses the mesh's vertices, only the triangle list differs.
+struct MeshLod
+{
+    vector<unsigned int> indices;
+
+    // How far (in model space units) this level's surface can be from the full detail one
+    float error = 0.0f;
+};
+
+// A cluster of at most MESHLET_MAX_VERTICES vertices / MESHLET_MAX_TRIANGLES triangles of a mesh, with the bounds
+// used to cull it. Plain floats rather than glm types so it can be written to the mesh cache as is.
+struct MeshletData
+{
+    // Range of the mesh's (full detail) index buffer holding this meshlet's triangles
+    unsigned int firstIndex;
+    unsigned int triangleCount;
+
+    // Model space bounding sphere
+    float center[3];
+    float radius;
+
+    // Normal cone: every triangle faces within asin(coneCutoff) of coneAxis
+    float coneAxis[3];
+    float coneCutoff;
+};
+
+struct MeshData
+{
+    // Interleaved vertices, exactly as they'll be uploaded
+    vector<Vertex> vertices;
+
+    // Triangle list indices, relative to this mesh's own vertices
+    vector<unsigned int> indices;
+
+    // Progressively coarser versions of indices (LOD1, LOD2, ...), empty if LODs weren't generated
+    vector<MeshLod> lods;
+
+    // Clusters of indices, which are sorted so every meshlet's triangles are contiguous. Empty if meshlets weren't built.
+    vector<MeshletData> meshlets;
+
+    // Index into ModelData::materials
+    unsigned int materialIndex = 0;
+
+    // Model space box and sphere around the vertices, empty until the importer computes them
+    BoundingVolume bounds;
+};
+
+struct MaterialTextureData
+{
+    // Texture type name, i.e. "texture_diffuse" or "texture_specular"
+    string type;
+
+    // Filepath relative to the model's directory
+    string path;
+};
+
+struct MaterialData
+{
+    vector<MaterialTextureData> textures;
+};
+
+struct ModelData
+{
+    // Meshes in node traversal order
+    vector<MeshData> meshes;
+
+    // Materials in the same order as the source scene's material list
+    vector<MaterialData> materials;
+};
+
+#endif
@@ -0,0 +1,359 @@
+#ifndef TANGENT_GENERATOR_H
+#define TANGENT_GENERATOR_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <ModelLoading/vertex.h>
+#include <Utility/threadPool.h>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define TANGENT_GENERATOR_SSE2
+    #include <emmintrin.h>
+#endif
+
+using namespace std;
+
+struct TangentGenerationStats
+{
+    size_t vertexCount = 0;
+
+    // Triangles with no area in UV space, which have no tangent direction of their own to contribute
+    size_t degenerateUvTriangleCount = 0;
+
+    // Vertices shared by mirrored and unmirrored triangles, which had to be split in two
+    size_t splitVertexCount = 0;
+
+    TangentGenerationStats& operator+=(const TangentGenerationStats& other)
+    {
+        this->vertexCount += other.vertexCount;
+        this->degenerateUvTriangleCount += other.degenerateUvTriangleCount;
+        this->splitVertexCount += other.splitVertexCount;
+        return *this;
+    }
+};
+
+// Builds the per-vertex tangent frames normal maps are authored against.
+//
+// Follows the same conventions as MikkTSpace, which is what Blender, Substance and most bakers use, so the maps
+// come out the way they were baked: each triangle's tangent is the direction of increasing U, projected onto each
+// corner's normal plane and weighted by the corner's angle; the bitangent is never stored, just its sign, with
+// bitangent = sign * cross(normal, tangent); and vertices shared by mirrored and unmirrored triangles get split, so
+// the two sides never average into each other. Unlike MikkTSpace, vertices are shared as they come out of the
+// welder rather than by re-matching positions, and corner angles are measured in the triangle's own plane.
+//
+// Triangle tangents are computed four at a time with SSE, and both passes are spread across the thread pool.
+class TangentGenerator
+{
+    public:
+        // Fills in every vertex's tangent. May append vertices (see splitVertexCount) and point triangles at them.
+        static TangentGenerationStats generate(vector<Vertex>& vertices, vector<unsigned int>& indices)
+        {
+            TangentGenerationStats stats;
+            size_t triangleCount = indices.size() / 3;
+
+            vector<TriangleFrame> frames(triangleCount);
+            size_t taskCount = (triangleCount + TRIANGLES_PER_TASK - 1) / TRIANGLES_PER_TASK;
+            sharedThreadPool().parallelFor(taskCount, [&](size_t task)
+            {
+                size_t first = task * TRIANGLES_PER_TASK;
+                size_t last = min(first + TRIANGLES_PER_TASK, triangleCount);
+                computeTriangleFrames(vertices, indices, frames, first, last);
+            });
+
+            for (const TriangleFrame& frame : frames)
+            {
+                stats.degenerateUvTriangleCount += frame.orientation == 0.0f ? 1 : 0;
+            }
+
+            // Corners grouped by vertex, so each vertex can gather its own without racing anyone
+            vector<unsigned int> cornerStart(vertices.size() + 1, 0);
+            for (unsigned int index : indices)
+            {
+                cornerStart[index + 1]++;
+            }
+
+            for (size_t i = 0; i < vertices.size(); i++)
+            {
+                cornerStart[i + 1] += cornerStart[i];
+            }
+
+            vector<unsigned int> corners(triangleCount * 3);
+            vector<unsigned int> cornerFill(cornerStart.begin(), cornerStart.end() - 1);
+            for (size_t corner = 0; corner < triangleCount * 3; corner++)
+            {
+                corners[cornerFill[indices[corner]]++] = static_cast<unsigned int>(corner);
+            }
+
+            // Each vertex sums what its mirrored and unmirrored triangles want separately
+            vector<glm::vec3> mirroredTangents(vertices.size());
+            vector<float> keptSigns(vertices.size(), 1.0f);
+            vector<char> hasMirrored(vertices.size(), 0);
+            size_t vertexTaskCount = (vertices.size() + VERTICES_PER_TASK - 1) / VERTICES_PER_TASK;
+            sharedThreadPool().parallelFor(vertexTaskCount, [&](size_t task)
+            {
+                size_t last = min((task + 1) * VERTICES_PER_TASK, vertices.size());
+                for (size_t vertex = task * VERTICES_PER_TASK; vertex < last; vertex++)
+                {
+                    glm::vec3 normal = safeNormalize(vertices[vertex].normal, glm::vec3(0.0f, 0.0f, 1.0f));
+                    glm::vec3 tangents[2] = { glm::vec3(0.0f), glm::vec3(0.0f) };
+                    float weights[2] = { 0.0f, 0.0f };
+
+                    for (unsigned int i = cornerStart[vertex]; i < cornerStart[vertex + 1]; i++)
+                    {
+                        unsigned int corner = corners[i];
+                        const TriangleFrame& frame = frames[corner / 3];
+                        if (frame.orientation == 0.0f)
+                        {
+                            continue;
+                        }
+
+                        glm::vec3 projected = frame.tangent - normal * glm::dot(normal, frame.tangent);
+                        float length = glm::length(projected);
+                        if (length > 0.0f)
+                        {
+                            int side = frame.orientation < 0.0f ? 1 : 0;
+                            tangents[side] += projected * (frame.cornerAngles[corner % 3] / length);
+                            weights[side] += frame.cornerAngles[corner % 3];
+                        }
+                    }
+
+                    // The vertex keeps whichever side most of it faces, the other (if any) gets split off afterwards
+                    int kept = weights[1] > weights[0] ? 1 : 0;
+                    keptSigns[vertex] = kept == 1 ? -1.0f : 1.0f;
+                    vertices[vertex].tangent = packTangent(normal, tangents[kept], keptSigns[vertex]);
+                    if (weights[1 - kept] > 0.0f)
+                    {
+                        hasMirrored[vertex] = 1;
+                        mirroredTangents[vertex] = tangents[1 - kept];
+                    }
+                }
+            });
+
+            size_t originalVertexCount = vertices.size();
+            for (size_t vertex = 0; vertex < originalVertexCount; vertex++)
+            {
+                if (!hasMirrored[vertex])
+                {
+                    continue;
+                }
+
+                float keptSign = keptSigns[vertex];
+                Vertex split = vertices[vertex];
+                split.tangent = packTangent(safeNormalize(split.normal, glm::vec3(0.0f, 0.0f, 1.0f)), mirroredTangents[vertex], -keptSign);
+
+                unsigned int splitIndex = static_cast<unsigned int>(vertices.size());
+                vertices.push_back(split);
+                stats.splitVertexCount++;
+
+                for (unsigned int i = cornerStart[vertex]; i < cornerStart[vertex + 1]; i++)
+                {
+                    unsigned int corner = corners[i];
+                    float orientation = frames[corner / 3].orientation;
+                    if (orientation != 0.0f && orientation != keptSign)
+                    {
+                        indices[corner] = splitIndex;
+                    }
+                }
+            }
+
+            stats.vertexCount = vertices.size();
+            return stats;
+        }
+
+        // Tangent direction in xyz and bitangent sign in w, as signed normalized 10:10:10:2 (GL_INT_2_10_10_10_REV)
+        static uint32_t packTangent(const glm::vec3& tangent, float bitangentSign)
+        {
+            return glm::packSnorm3x10_1x2(glm::vec4(tangent, bitangentSign));
+        }
+
+        static glm::vec4 unpackTangent(uint32_t packed)
+        {
+            return glm::unpackSnorm3x10_1x2(packed);
+        }
+
+    private:
+        static const size_t TRIANGLES_PER_TASK = 4096;
+        static const size_t VERTICES_PER_TASK = 4096;
+
+        // Below this much UV area (twice the signed area) a triangle is treated as having none
+        static constexpr float MIN_UV_AREA = 1e-20f;
+
+        struct TriangleFrame
+        {
+            // Unit direction of increasing U across the triangle
+            glm::vec3 tangent;
+
+            // +1 if the UVs wind the same way as the positions, -1 if they're mirrored, 0 if they have no area
+            float orientation;
+
+            float cornerAngles[3];
+        };
+
+        static glm::vec3 safeNormalize(const glm::vec3& vector, const glm::vec3& fallback)
+        {
+            float length = glm::length(vector);
+            return length > 0.0f ? vector / length : fallback;
+        }
+
+        // Orthonormalizes the tangent against the normal and packs it, falling back on any direction perpendicular
+        // to the normal if the tangent is unusable (no UVs, or only degenerate triangles)
+        static uint32_t packTangent(const glm::vec3& normal, const glm::vec3& tangent, float sign)
+        {
+            glm::vec3 projected = tangent - normal * glm::dot(normal, tangent);
+            float length = glm::length(projected);
+            if (!(length > 1e-12f))
+            {
+                glm::vec3 axis = fabs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+                projected = glm::normalize(glm::cross(glm::cross(normal, axis), normal));
+                length = 1.0f;
+            }
+
+            return packTangent(projected / length, sign);
+        }
+
+        static void computeTriangleFrames(const vector<Vertex>& vertices, const vector<unsigned int>& indices,
+            vector<TriangleFrame>& frames, size_t first, size_t last)
+        {
+            size_t triangle = first;
+
+#ifdef TANGENT_GENERATOR_SSE2
+            for (; triangle + 4 <= last; triangle += 4)
+            {
+                // Gather four triangles' corners into structure of arrays form, one register per component
+                alignas(16) float p[3][3][4];
+                alignas(16) float uv[3][2][4];
+                for (int lane = 0; lane < 4; lane++)
+                {
+                    for (int corner = 0; corner < 3; corner++)
+                    {
+                        const Vertex& vertex = vertices[indices[(triangle + lane) * 3 + corner]];
+                        for (int axis = 0; axis < 3; axis++)
+                        {
+                            p[corner][axis][lane] = vertex.position[axis];
+                        }
+
+                        uv[corner][0][lane] = vertex.texCoords.x;
+                        uv[corner][1][lane] = vertex.texCoords.y;
+                    }
+                }
+
+                __m128 edge1[3], edge2[3], edge3[3];
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    __m128 p0 = _mm_load_ps(p[0][axis]), p1 = _mm_load_ps(p[1][axis]), p2 = _mm_load_ps(p[2][axis]);
+                    edge1[axis] = _mm_sub_ps(p1, p0);
+                    edge2[axis] = _mm_sub_ps(p2, p0);
+                    edge3[axis] = _mm_sub_ps(p2, p1);
+                }
+
+                __m128 u0 = _mm_load_ps(uv[0][0]), v0 = _mm_load_ps(uv[0][1]);
+                __m128 du1 = _mm_sub_ps(_mm_load_ps(uv[1][0]), u0), dv1 = _mm_sub_ps(_mm_load_ps(uv[1][1]), v0);
+                __m128 du2 = _mm_sub_ps(_mm_load_ps(uv[2][0]), u0), dv2 = _mm_sub_ps(_mm_load_ps(uv[2][1]), v0);
+                __m128 uvArea = _mm_sub_ps(_mm_mul_ps(du1, dv2), _mm_mul_ps(du2, dv1));
+
+                // tangent = dv2 * edge1 - dv1 * edge2, flipped for mirrored triangles so it always points along +U
+                __m128 tangent[3];
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    tangent[axis] = _mm_sub_ps(_mm_mul_ps(dv2, edge1[axis]), _mm_mul_ps(dv1, edge2[axis]));
+                }
+
+                __m128 tangentLength = _mm_sqrt_ps(dot3(tangent, tangent));
+
+                // Corner angles from the normalized edges: corner 0 between edge1 and edge2, corner 1 between -edge1
+                // and edge3, corner 2 between -edge2 and -edge3
+                __m128 inverseLength1 = inverseLength(edge1), inverseLength2 = inverseLength(edge2), inverseLength3 = inverseLength(edge3);
+                alignas(16) float cosines[3][4];
+                _mm_store_ps(cosines[0], _mm_mul_ps(dot3(edge1, edge2), _mm_mul_ps(inverseLength1, inverseLength2)));
+                _mm_store_ps(cosines[1], _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(dot3(edge1, edge3), _mm_mul_ps(inverseLength1, inverseLength3))));
+                _mm_store_ps(cosines[2], _mm_mul_ps(dot3(edge2, edge3), _mm_mul_ps(inverseLength2, inverseLength3)));
+
+                alignas(16) float tangentOut[3][4], lengthOut[4], areaOut[4];
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    _mm_store_ps(tangentOut[axis], tangent[axis]);
+                }
+
+                _mm_store_ps(lengthOut, tangentLength);
+                _mm_store_ps(areaOut, uvArea);
+
+                for (int lane = 0; lane < 4; lane++)
+                {
+                    glm::vec3 laneTangent(tangentOut[0][lane], tangentOut[1][lane], tangentOut[2][lane]);
+                    float laneCosines[3] = { cosines[0][lane], cosines[1][lane], cosines[2][lane] };
+                    finishFrame(frames[triangle + lane], laneTangent, lengthOut[lane], areaOut[lane], laneCosines);
+                }
+            }
+#endif
+
+            for (; triangle < last; triangle++)
+            {
+                const Vertex& vertex0 = vertices[indices[triangle * 3]];
+                const Vertex& vertex1 = vertices[indices[triangle * 3 + 1]];
+                const Vertex& vertex2 = vertices[indices[triangle * 3 + 2]];
+
+                glm::vec3 edge1 = vertex1.position - vertex0.position;
+                glm::vec3 edge2 = vertex2.position - vertex0.position;
+                glm::vec3 edge3 = vertex2.position - vertex1.position;
+                glm::vec2 deltaUv1 = vertex1.texCoords - vertex0.texCoords;
+                glm::vec2 deltaUv2 = vertex2.texCoords - vertex0.texCoords;
+
+                float uvArea = deltaUv1.x * deltaUv2.y - deltaUv2.x * deltaUv1.y;
+                glm::vec3 tangent = deltaUv2.y * edge1 - deltaUv1.y * edge2;
+
+                float length1 = glm::length(edge1), length2 = glm::length(edge2), length3 = glm::length(edge3);
+                float inverseLength1 = length1 > 0.0f ? 1.0f / length1 : 0.0f;
+                float inverseLength2 = length2 > 0.0f ? 1.0f / length2 : 0.0f;
+                float inverseLength3 = length3 > 0.0f ? 1.0f / length3 : 0.0f;
+                float cosines[3] =
+                {
+                    glm::dot(edge1, edge2) * inverseLength1 * inverseLength2,
+                    -glm::dot(edge1, edge3) * inverseLength1 * inverseLength3,
+                    glm::dot(edge2, edge3) * inverseLength2 * inverseLength3
+                };
+
+                finishFrame(frames[triangle], tangent, glm::length(tangent), uvArea, cosines);
+            }
+        }
+
+#ifdef TANGENT_GENERATOR_SSE2
+        static __m128 dot3(const __m128* a, const __m128* b)
+        {
+            return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])), _mm_mul_ps(a[2], b[2]));
+        }
+
+        // 1 / |v|, or 0 for zero length edges (so their corners get no weight rather than NaNs)
+        static __m128 inverseLength(const __m128* vector)
+        {
+            __m128 length = _mm_sqrt_ps(dot3(vector, vector));
+            __m128 nonZero = _mm_cmpgt_ps(length, _mm_setzero_ps());
+            return _mm_and_ps(nonZero, _mm_div_ps(_mm_set1_ps(1.0f), length));
+        }
+#endif
+
+        static void finishFrame(TriangleFrame& frame, const glm::vec3& tangent, float tangentLength, float uvArea, const float* cosines)
+        {
+            if (fabs(uvArea) < MIN_UV_AREA || !(tangentLength > 0.0f))
+            {
+                frame.tangent = glm::vec3(0.0f);
+                frame.orientation = 0.0f;
+            }
+            else
+            {
+                frame.orientation = uvArea > 0.0f ? 1.0f : -1.0f;
+                frame.tangent = tangent * (frame.orientation / tangentLength);
+            }
+
+            for (int corner = 0; corner < 3; corner++)
+            {
+                frame.cornerAngles[corner] = acos(glm::clamp(cosines[corner], -1.0f, 1.0f));
+            }
+        }
+};
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef VERTEX_H
+#define VERTEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+using namespace std;
+
+struct Vertex
+{
+    // Model space position coordinate
+    glm::vec3 position;
+
+    // Model space normal vector
+    glm::vec3 normal;
+
+    // Texture coordinates
+    glm::vec2 texCoords;
+
+    // Model space tangent for normal mapping, packed as snorm 10:10:10:2. xyz is the direction of increasing U and w
+    // the sign to build the bitangent with: bitangent = w * cross(normal, tangent). See TangentGenerator.
+    uint32_t tangent = 0;
+};
+
+// Just over half the size of a Vertex (20 bytes instead of 36), for when vertex bandwidth and VRAM matter more than
+// precision. See VertexQuantizer for how the values are encoded.
+struct QuantizedVertex
+{
+    // Position within the mesh's bounding box, as unorm16. The shader maps it back into model space with the
+    // mesh's positionOffset/positionScale uniforms.
+    uint16_t position[3];
+    uint16_t padding;
+
+    // Octahedral encoded unit normal, as snorm16
+    int16_t normal[2];
+
+    // Texture coordinates as half floats (so tiling UVs outside [0, 1] still work)
+    uint16_t texCoords[2];
+
+    // Same packed tangent as Vertex, already as small as it gets
+    uint32_t tangent;
+};
+
+static_assert(sizeof(QuantizedVertex) == 20, "QuantizedVertex should be tightly packed");
+
+enum class VertexFormat
+{
+    // Vertex: float3 position, float3 normal, float2 UV, packed tangent (36 bytes)
+    Float,
+
+    // QuantizedVertex: unorm16 position, octahedral snorm16 normal, half float UV, packed tangent (20 bytes)
+    Quantized
+};
+
+// One glVertexAttribPointer call's worth of information
+struct VertexAttribute
+{
+    GLuint location;
+    GLint components;
+    GLenum type;
+    GLboolean normalized;
+    size_t offset;
+};
+
+struct VertexLayout
+{
+    GLsizei stride;
+    vector<VertexAttribute> attributes;
+};
+
+// Attribute setup for each vertex format. The locations match the layout qualifiers in our shaders
+// (0 = position, 1 = normal, 2 = texture coordinates, 3 = tangent).
+inline const VertexLayout& vertexLayoutFor(VertexFormat format)
+{
+    static const VertexLayout floatLayout =
+    {
+        sizeof(Vertex),
+        {
+            { 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, position) },
+            { 1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, normal) },
+            { 2, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, texCoords) },
+            { 3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(Vertex, tangent) }
+        }
+    };
+
+    static const VertexLayout quantizedLayout =
+    {
+        sizeof(QuantizedVertex),
+        {
+            { 0, 3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(QuantizedVertex, position) },
+            { 1, 2, GL_SHORT, GL_TRUE, offsetof(QuantizedVertex, normal) },
+            { 2, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(QuantizedVertex, texCoords) },
+            { 3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(QuantizedVertex, tangent) }
+        }
+    };
+
+    return format == VertexFormat::Quantized ? quantizedLayout : floatLayout;
+}
+
+#endif
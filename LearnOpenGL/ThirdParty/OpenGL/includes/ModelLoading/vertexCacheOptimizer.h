@@ -0,0 +1,380 @@
+#ifndef VERTEX_CACHE_OPTIMIZER_H
+#define VERTEX_CACHE_OPTIMIZER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <ModelLoading/vertex.h>
+#include <vector>
+
+using namespace std;
+
+// Post-transform vertex cache statistics for an index buffer.
+//
+// ACMR (average cache miss ratio) is transformed vertices per triangle: 3.0 means every corner gets shaded,
+// ~0.5-0.7 is about as good as a typical closed mesh gets.
+// ATVR (average transformed vertex ratio) is transformed vertices per unique vertex, where 1.0 is perfect.
+struct VertexCacheStats
+{
+    size_t triangleCount = 0;
+    size_t uniqueVertexCount = 0;
+    size_t transformedVertexCount = 0;
+
+    float acmr() const
+    {
+        return this->triangleCount > 0 ? float(this->transformedVertexCount) / float(this->triangleCount) : 0.0f;
+    }
+
+    float atvr() const
+    {
+        return this->uniqueVertexCount > 0 ? float(this->transformedVertexCount) / float(this->uniqueVertexCount) : 0.0f;
+    }
+
+    VertexCacheStats& operator+=(const VertexCacheStats& other)
+    {
+        this->triangleCount += other.triangleCount;
+        this->uniqueVertexCount += other.uniqueVertexCount;
+        this->transformedVertexCount += other.transformedVertexCount;
+        return *this;
+    }
+};
+
+// Import-time reordering of triangle lists for better GPU vertex reuse.
+//
+// optimizeVertexCache() reorders triangles with Tom Forsyth's "Linear-Speed Vertex Cache Optimisation" so that
+// triangles sharing vertices are drawn close together, and optimizeVertexFetch() then renumbers the vertices in the
+// order they're first referenced so the vertex fetches walk through memory linearly too.
+class VertexCacheOptimizer
+{
+    public:
+        // Size of the simulated FIFO cache used for the ACMR/ATVR numbers (roughly what current hardware reuses)
+        static const unsigned int ANALYSIS_CACHE_SIZE = 16;
+
+        // Simulates a FIFO post-transform cache over the index buffer
+        static VertexCacheStats analyze(const vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize = ANALYSIS_CACHE_SIZE)
+        {
+            VertexCacheStats stats;
+            stats.triangleCount = indices.size() / 3;
+
+            // A vertex is still in the cache if fewer than cacheSize misses have happened since it was last loaded
+            vector<unsigned int> cacheTimestamps(vertexCount, 0);
+            vector<bool> referenced(vertexCount, false);
+            unsigned int timestamp = cacheSize + 1;
+
+            for (unsigned int index : indices)
+            {
+                if (!referenced[index])
+                {
+                    referenced[index] = true;
+                    stats.uniqueVertexCount++;
+                }
+
+                if (timestamp - cacheTimestamps[index] > cacheSize)
+                {
+                    cacheTimestamps[index] = timestamp++;
+                    stats.transformedVertexCount++;
+                }
+            }
+
+            return stats;
+        }
+
+        // Reorders the triangles in a triangle list index buffer for post-transform cache locality
+        static void optimizeVertexCache(vector<unsigned int>& indices, size_t vertexCount)
+        {
+            size_t triangleCount = indices.size() / 3;
+            if (triangleCount == 0 || vertexCount == 0)
+            {
+                return;
+            }
+
+            // Build vertex -> triangle adjacency. Each vertex owns the range [triangleOffset, triangleOffset + remainingTriangles)
+            // of adjacentTriangles, and emitted triangles get swapped out of the end of that range.
+            vector<OptimizerVertex> vertices(vertexCount);
+            for (unsigned int index : indices)
+            {
+                vertices[index].remainingTriangles++;
+            }
+
+            unsigned int offset = 0;
+            for (OptimizerVertex& vertex : vertices)
+            {
+                vertex.triangleOffset = offset;
+                offset += vertex.remainingTriangles;
+                vertex.remainingTriangles = 0;
+            }
+
+            vector<unsigned int> adjacentTriangles(indices.size());
+            for (size_t triangle = 0; triangle < triangleCount; triangle++)
+            {
+                for (size_t corner = 0; corner < 3; corner++)
+                {
+                    OptimizerVertex& vertex = vertices[indices[triangle * 3 + corner]];
+                    adjacentTriangles[vertex.triangleOffset + vertex.remainingTriangles++] = static_cast<unsigned int>(triangle);
+                }
+            }
+
+            for (OptimizerVertex& vertex : vertices)
+            {
+                vertex.score = vertexScore(vertex.cachePosition, vertex.remainingTriangles);
+            }
+
+            vector<float> triangleScores(triangleCount);
+            vector<bool> emitted(triangleCount, false);
+            for (size_t triangle = 0; triangle < triangleCount; triangle++)
+            {
+                triangleScores[triangle] = triangleScore(indices, vertices, triangle);
+            }
+
+            // LRU cache of vertex indices, with room for the 3 we push in front before trimming
+            vector<unsigned int> cache;
+            vector<unsigned int> newCache;
+            cache.reserve(FORSYTH_CACHE_SIZE + 3);
+            newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+            vector<unsigned int> optimizedIndices;
+            optimizedIndices.reserve(indices.size());
+
+            size_t bestTriangle = bestOfAll(triangleScores, emitted, 0);
+            size_t fallbackCursor = 0;
+
+            for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+            {
+                // Nothing in the cache has triangles left, so just carry on from the next unemitted triangle
+                if (bestTriangle == INVALID_TRIANGLE)
+                {
+                    while (emitted[fallbackCursor])
+                    {
+                        fallbackCursor++;
+                    }
+
+                    bestTriangle = fallbackCursor;
+                }
+
+                emitted[bestTriangle] = true;
+
+                newCache.clear();
+                for (size_t corner = 0; corner < 3; corner++)
+                {
+                    unsigned int index = indices[bestTriangle * 3 + corner];
+                    optimizedIndices.push_back(index);
+
+                    removeAdjacentTriangle(vertices[index], adjacentTriangles, static_cast<unsigned int>(bestTriangle));
+
+                    if (!contains(newCache, index))
+                    {
+                        newCache.push_back(index);
+                    }
+                }
+
+                // newCache only holds this triangle's (up to 3) vertices so far, so this check stays cheap
+                size_t triangleVertexCount = newCache.size();
+                for (unsigned int index : cache)
+                {
+                    if (find(newCache.begin(), newCache.begin() + triangleVertexCount, index) == newCache.begin() + triangleVertexCount)
+                    {
+                        newCache.push_back(index);
+                    }
+                }
+
+                // Update positions (and scores) for everything still cached, and evict whatever fell off the end
+                for (size_t position = 0; position < newCache.size(); position++)
+                {
+                    OptimizerVertex& vertex = vertices[newCache[position]];
+                    vertex.cachePosition = position < FORSYTH_CACHE_SIZE ? int(position) : -1;
+                    vertex.score = vertexScore(vertex.cachePosition, vertex.remainingTriangles);
+                }
+
+                // Rescore the triangles touching any vertex whose score just changed, picking the best as we go
+                bestTriangle = INVALID_TRIANGLE;
+                float bestScore = -1.0f;
+                for (size_t position = 0; position < newCache.size(); position++)
+                {
+                    const OptimizerVertex& vertex = vertices[newCache[position]];
+                    for (unsigned int i = 0; i < vertex.remainingTriangles; i++)
+                    {
+                        unsigned int triangle = adjacentTriangles[vertex.triangleOffset + i];
+                        float score = triangleScore(indices, vertices, triangle);
+                        triangleScores[triangle] = score;
+
+                        if (score > bestScore)
+                        {
+                            bestScore = score;
+                            bestTriangle = triangle;
+                        }
+                    }
+                }
+
+                if (newCache.size() > FORSYTH_CACHE_SIZE)
+                {
+                    newCache.resize(FORSYTH_CACHE_SIZE);
+                }
+
+                cache.swap(newCache);
+            }
+
+            indices.swap(optimizedIndices);
+        }
+
+        // Renumbers vertices in the order the index buffer first references them, so vertex fetch walks forwards
+        // through memory. Vertices nothing references are dropped.
+        static void optimizeVertexFetch(vector<Vertex>& vertices, vector<unsigned int>& indices)
+        {
+            const unsigned int unassigned = numeric_limits<unsigned int>::max();
+            vector<unsigned int> remap(vertices.size(), unassigned);
+
+            unsigned int nextVertex = 0;
+            for (unsigned int& index : indices)
+            {
+                if (remap[index] == unassigned)
+                {
+                    remap[index] = nextVertex++;
+                }
+
+                index = remap[index];
+            }
+
+            vector<Vertex> reorderedVertices(nextVertex);
+            for (size_t i = 0; i < vertices.size(); i++)
+            {
+                if (remap[i] != unassigned)
+                {
+                    reorderedVertices[remap[i]] = vertices[i];
+                }
+            }
+
+            vertices.swap(reorderedVertices);
+        }
+
+    private:
+        // Tuning values from Forsyth's paper
+        static const unsigned int FORSYTH_CACHE_SIZE = 32;
+        static constexpr float CACHE_DECAY_POWER = 1.5f;
+        static constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+        static constexpr float VALENCE_BOOST_SCALE = 2.0f;
+        static constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+        static const size_t INVALID_TRIANGLE = numeric_limits<size_t>::max();
+
+        struct OptimizerVertex
+        {
+            int cachePosition = -1;
+            float score = 0.0f;
+            unsigned int remainingTriangles = 0;
+            unsigned int triangleOffset = 0;
+        };
+
+        // The score only depends on two small integers, so precompute it rather than calling pow() in the inner loop
+        static const unsigned int VALENCE_TABLE_SIZE = 64;
+
+        struct ScoreTables
+        {
+            float cachePosition[FORSYTH_CACHE_SIZE];
+            float valence[VALENCE_TABLE_SIZE];
+
+            ScoreTables()
+            {
+                for (unsigned int position = 0; position < FORSYTH_CACHE_SIZE; position++)
+                {
+                    if (position < 3)
+                    {
+                        // Used by the triangle we just emitted. Deliberately scored a bit lower than the next few slots
+                        // so we don't keep fanning around the same vertex.
+                        this->cachePosition[position] = LAST_TRIANGLE_SCORE;
+                    }
+                    else
+                    {
+                        const float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+                        this->cachePosition[position] = pow(1.0f - (position - 3) * scaler, CACHE_DECAY_POWER);
+                    }
+                }
+
+                this->valence[0] = 0.0f;
+                for (unsigned int remaining = 1; remaining < VALENCE_TABLE_SIZE; remaining++)
+                {
+                    this->valence[remaining] = valenceScore(remaining);
+                }
+            }
+        };
+
+        static const ScoreTables& scoreTables()
+        {
+            static const ScoreTables tables;
+            return tables;
+        }
+
+        // Boost vertices with only a few triangles left so we finish them off rather than leaving lone triangles behind
+        static float valenceScore(unsigned int remainingTriangles)
+        {
+            return VALENCE_BOOST_SCALE * pow(float(remainingTriangles), -VALENCE_BOOST_POWER);
+        }
+
+        static float vertexScore(int cachePosition, unsigned int remainingTriangles)
+        {
+            // No triangles left means this vertex will never be needed again
+            if (remainingTriangles == 0)
+            {
+                return -1.0f;
+            }
+
+            const ScoreTables& tables = scoreTables();
+
+            float score = cachePosition >= 0 ? tables.cachePosition[cachePosition] : 0.0f;
+            score += remainingTriangles < VALENCE_TABLE_SIZE ? tables.valence[remainingTriangles] : valenceScore(remainingTriangles);
+            return score;
+        }
+
+        static float triangleScore(const vector<unsigned int>& indices, const vector<OptimizerVertex>& vertices, size_t triangle)
+        {
+            return vertices[indices[triangle * 3]].score
+                + vertices[indices[triangle * 3 + 1]].score
+                + vertices[indices[triangle * 3 + 2]].score;
+        }
+
+        static size_t bestOfAll(const vector<float>& triangleScores, const vector<bool>& emitted, size_t start)
+        {
+            size_t bestTriangle = INVALID_TRIANGLE;
+            float bestScore = -1.0f;
+            for (size_t triangle = start; triangle < triangleScores.size(); triangle++)
+            {
+                if (!emitted[triangle] && triangleScores[triangle] > bestScore)
+                {
+                    bestScore = triangleScores[triangle];
+                    bestTriangle = triangle;
+                }
+            }
+
+            return bestTriangle;
+        }
+
+        static void removeAdjacentTriangle(OptimizerVertex& vertex, vector<unsigned int>& adjacentTriangles, unsigned int triangle)
+        {
+            unsigned int begin = vertex.triangleOffset;
+            unsigned int end = begin + vertex.remainingTriangles;
+            for (unsigned int i = begin; i < end; i++)
+            {
+                if (adjacentTriangles[i] == triangle)
+                {
+                    adjacentTriangles[i] = adjacentTriangles[end - 1];
+                    vertex.remainingTriangles--;
+                    return;
+                }
+            }
+        }
+
+        static bool contains(const vector<unsigned int>& cache, unsigned int index)
+        {
+            for (unsigned int cached : cache)
+            {
+                if (cached == index)
+                {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+};
+
+#endif
@@ -0,0 +1,187 @@
+#ifndef VERTEX_QUANTIZATION_H
+#define VERTEX_QUANTIZATION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <ModelLoading/vertex.h>
+#include <vector>
+
+using namespace std;
+
+// Quantized vertices for a single mesh, along with what the shader needs to decode the positions
+struct QuantizedVertexData
+{
+    vector<QuantizedVertex> vertices;
+
+    // Decoded position = unorm16 position * positionScale + positionOffset (i.e. the mesh's bounding box)
+    glm::vec3 positionOffset = glm::vec3(0.0f);
+    glm::vec3 positionScale = glm::vec3(1.0f);
+};
+
+// Worst case and average round trip error introduced by quantization
+struct QuantizationError
+{
+    size_t vertexCount = 0;
+
+    // In model space units
+    float maxPositionError = 0.0f;
+    double totalPositionError = 0.0;
+
+    // Angle between the original and decoded normal, in degrees
+    float maxNormalError = 0.0f;
+    double totalNormalError = 0.0;
+
+    float maxTexCoordError = 0.0f;
+
+    float averagePositionError() const
+    {
+        return this->vertexCount > 0 ? float(this->totalPositionError / this->vertexCount) : 0.0f;
+    }
+
+    float averageNormalError() const
+    {
+        return this->vertexCount > 0 ? float(this->totalNormalError / this->vertexCount) : 0.0f;
+    }
+
+    QuantizationError& operator+=(const QuantizationError& other)
+    {
+        this->vertexCount += other.vertexCount;
+        this->maxPositionError = max(this->maxPositionError, other.maxPositionError);
+        this->totalPositionError += other.totalPositionError;
+        this->maxNormalError = max(this->maxNormalError, other.maxNormalError);
+        this->totalNormalError += other.totalNormalError;
+        this->maxTexCoordError = max(this->maxTexCoordError, other.maxTexCoordError);
+        return *this;
+    }
+};
+
+// Converts float vertices into the compact QuantizedVertex layout.
+//
+// Every encode here has a decode that mirrors exactly what the GPU does with the attribute (and what assimpShader.vs
+// does on top of that), so the reported error is the error we'll actually see on screen.
+class VertexQuantizer
+{
+    public:
+        static QuantizedVertexData quantize(const vector<Vertex>& vertices, QuantizationError& error)
+        {
+            QuantizedVertexData quantized;
+            error = QuantizationError();
+
+            if (vertices.empty())
+            {
+                return quantized;
+            }
+
+            // Positions are stored relative to the bounding box so all 16 bits go towards the mesh's actual extent
+            glm::vec3 boundsMin = vertices[0].position;
+            glm::vec3 boundsMax = vertices[0].position;
+            for (const Vertex& vertex : vertices)
+            {
+                boundsMin = glm::min(boundsMin, vertex.position);
+                boundsMax = glm::max(boundsMax, vertex.position);
+            }
+
+            quantized.positionOffset = boundsMin;
+            quantized.positionScale = boundsMax - boundsMin;
+
+            quantized.vertices.resize(vertices.size());
+            error.vertexCount = vertices.size();
+
+            for (size_t i = 0; i < vertices.size(); i++)
+            {
+                const Vertex& vertex = vertices[i];
+                QuantizedVertex& quantizedVertex = quantized.vertices[i];
+
+                // Position
+                glm::vec3 decodedPosition;
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    float extent = quantized.positionScale[axis];
+                    float normalized = extent > 0.0f ? (vertex.position[axis] - boundsMin[axis]) / extent : 0.0f;
+                    quantizedVertex.position[axis] = encodeUnorm16(normalized);
+                    decodedPosition[axis] = decodeUnorm16(quantizedVertex.position[axis]) * extent + boundsMin[axis];
+                }
+
+                quantizedVertex.padding = 0;
+                quantizedVertex.tangent = vertex.tangent;
+
+                float positionError = glm::length(decodedPosition - vertex.position);
+                error.maxPositionError = max(error.maxPositionError, positionError);
+                error.totalPositionError += positionError;
+
+                // Normal
+                glm::vec3 normal = glm::length(vertex.normal) > 0.0f ? glm::normalize(vertex.normal) : glm::vec3(0.0f, 0.0f, 1.0f);
+                glm::vec2 octahedral = encodeOctahedral(normal);
+                quantizedVertex.normal[0] = encodeSnorm16(octahedral.x);
+                quantizedVertex.normal[1] = encodeSnorm16(octahedral.y);
+
+                glm::vec3 decodedNormal = decodeOctahedral(glm::vec2(decodeSnorm16(quantizedVertex.normal[0]), decodeSnorm16(quantizedVertex.normal[1])));
+                float cosine = glm::clamp(glm::dot(normal, decodedNormal), -1.0f, 1.0f);
+                float normalError = glm::degrees(acos(cosine));
+                error.maxNormalError = max(error.maxNormalError, normalError);
+                error.totalNormalError += normalError;
+
+                // Texture coordinates
+                for (int axis = 0; axis < 2; axis++)
+                {
+                    quantizedVertex.texCoords[axis] = glm::packHalf1x16(vertex.texCoords[axis]);
+                    float texCoordError = fabs(glm::unpackHalf1x16(quantizedVertex.texCoords[axis]) - vertex.texCoords[axis]);
+                    error.maxTexCoordError = max(error.maxTexCoordError, texCoordError);
+                }
+            }
+
+            return quantized;
+        }
+
+        // Octahedral normal encoding: project onto the octahedron |x| + |y| + |z| = 1, then fold the lower half
+        // over the upper one so the whole sphere maps onto the [-1, 1] square
+        static glm::vec2 encodeOctahedral(const glm::vec3& normal)
+        {
+            glm::vec2 projected = glm::vec2(normal.x, normal.y) / (fabs(normal.x) + fabs(normal.y) + fabs(normal.z));
+            if (normal.z < 0.0f)
+            {
+                glm::vec2 folded = glm::vec2(1.0f - fabs(projected.y), 1.0f - fabs(projected.x));
+                projected = glm::vec2(projected.x >= 0.0f ? folded.x : -folded.x, projected.y >= 0.0f ? folded.y : -folded.y);
+            }
+
+            return projected;
+        }
+
+        // Same as decodeOctahedral() in assimpShader.vs
+        static glm::vec3 decodeOctahedral(const glm::vec2& encoded)
+        {
+            glm::vec3 normal = glm::vec3(encoded.x, encoded.y, 1.0f - fabs(encoded.x) - fabs(encoded.y));
+            float fold = max(-normal.z, 0.0f);
+            normal.x += normal.x >= 0.0f ? -fold : fold;
+            normal.y += normal.y >= 0.0f ? -fold : fold;
+            return glm::normalize(normal);
+        }
+
+    private:
+        static uint16_t encodeUnorm16(float value)
+        {
+            return static_cast<uint16_t>(lround(glm::clamp(value, 0.0f, 1.0f) * 65535.0f));
+        }
+
+        // Matches GL's conversion for normalized GL_UNSIGNED_SHORT attributes
+        static float decodeUnorm16(uint16_t value)
+        {
+            return value / 65535.0f;
+        }
+
+        static int16_t encodeSnorm16(float value)
+        {
+            return static_cast<int16_t>(lround(glm::clamp(value, -1.0f, 1.0f) * 32767.0f));
+        }
+
+        // Matches GL's conversion for normalized GL_SHORT attributes
+        static float decodeSnorm16(int16_t value)
+        {
+            return max(value / 32767.0f, -1.0f);
+        }
+};
+
+#endif
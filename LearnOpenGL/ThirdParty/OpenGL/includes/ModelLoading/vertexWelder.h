@@ -0,0 +1,255 @@
+#ifndef VERTEX_WELDER_H
+#define VERTEX_WELDER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <ModelLoading/vertex.h>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define VERTEX_WELDER_SSE2
+    #include <emmintrin.h>
+#endif
+
+using namespace std;
+
+// How close two vertices have to be, attribute by attribute, to be merged into one. Zero only merges exact copies.
+struct VertexWeldTolerances
+{
+    // As a fraction of the mesh's bounding box diagonal, like the LOD errors, so it works whatever units the model
+    // was authored in
+    float position = 1e-6f;
+
+    // Per component of the unit normal
+    float normal = 1e-3f;
+
+    // Per component, in UV space
+    float texCoord = 1e-5f;
+};
+
+struct VertexWeldStats
+{
+    size_t vertexCount = 0;
+    size_t weldedVertexCount = 0;
+
+    // Triangles that lost an edge to the weld and were dropped
+    size_t degenerateTriangleCount = 0;
+
+    // Fraction of the vertices that were removed
+    float reduction() const
+    {
+        return this->vertexCount > 0 ? 1.0f - float(this->weldedVertexCount) / float(this->vertexCount) : 0.0f;
+    }
+
+    VertexWeldStats& operator+=(const VertexWeldStats& other)
+    {
+        this->vertexCount += other.vertexCount;
+        this->weldedVertexCount += other.weldedVertexCount;
+        this->degenerateTriangleCount += other.degenerateTriangleCount;
+        return *this;
+    }
+};
+
+// Merges duplicate vertices in an indexed triangle list.
+//
+// Assimp hands us OBJ faces with a vertex per face corner, so most vertices are shared by several copies. Each vertex
+// is snapped onto a grid one tolerance wide per attribute, and vertices landing in the same cell are merged, found
+// through an open addressing hash table keyed on the eight snapped values. Snapping happens for the whole vertex at
+// once, eight floats in two SSE registers. The first vertex in each cell is the one kept, with its exact values.
+//
+// Like any grid, two vertices closer than the tolerance can still straddle a cell boundary and stay separate, but
+// exact and near-exact copies, which is what an OBJ import is full of, always merge.
+class VertexWelder
+{
+    public:
+        static VertexWeldStats weld(vector<Vertex>& vertices, vector<unsigned int>& indices, const VertexWeldTolerances& tolerances = VertexWeldTolerances())
+        {
+            VertexWeldStats stats;
+            stats.vertexCount = vertices.size();
+            stats.weldedVertexCount = vertices.size();
+            if (vertices.empty())
+            {
+                return stats;
+            }
+
+            GridTransform grid = gridFor(vertices, tolerances);
+
+            size_t tableSize = 1;
+            while (tableSize < vertices.size() * 2)
+            {
+                tableSize *= 2;
+            }
+
+            // Each table slot holds the new index of a kept vertex, whose snapped key is in keys
+            vector<uint32_t> table(tableSize, EMPTY_SLOT);
+            vector<VertexKey> keys;
+            keys.reserve(vertices.size());
+
+            vector<unsigned int> remap(vertices.size());
+            vector<Vertex> weldedVertices;
+            weldedVertices.reserve(vertices.size());
+
+            for (size_t i = 0; i < vertices.size(); i++)
+            {
+                VertexKey key = snap(vertices[i], grid);
+                size_t slot = hashKey(key) & (tableSize - 1);
+
+                while (table[slot] != EMPTY_SLOT && !sameKey(keys[table[slot]], key))
+                {
+                    slot = (slot + 1) & (tableSize - 1);
+                }
+
+                if (table[slot] == EMPTY_SLOT)
+                {
+                    table[slot] = static_cast<uint32_t>(weldedVertices.size());
+                    keys.push_back(key);
+                    weldedVertices.push_back(vertices[i]);
+                }
+
+                remap[i] = table[slot];
+            }
+
+            // Rewrite the triangles, dropping any that welding collapsed onto a line or point
+            size_t indexCount = 0;
+            for (size_t i = 0; i + 2 < indices.size(); i += 3)
+            {
+                unsigned int a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+                if (a == b || b == c || a == c)
+                {
+                    stats.degenerateTriangleCount++;
+                    continue;
+                }
+
+                indices[indexCount++] = a;
+                indices[indexCount++] = b;
+                indices[indexCount++] = c;
+            }
+
+            indices.resize(indexCount);
+            vertices = std::move(weldedVertices);
+            stats.weldedVertexCount = vertices.size();
+            return stats;
+        }
+
+    private:
+        static constexpr uint32_t EMPTY_SLOT = 0xFFFFFFFF;
+
+        // Snapping works on the first 8 floats of the vertex: position, normal, UV. Tangents aren't compared, welding
+        // runs before they're generated.
+        static_assert(offsetof(Vertex, normal) == 3 * sizeof(float) && offsetof(Vertex, texCoords) == 6 * sizeof(float),
+            "VertexWelder expects Vertex to start with position, normal, UV");
+
+        // Keeps snapped values inside int32 (the largest float below 2^31), so far out values clamp instead of wrapping
+        static constexpr float MAX_CELL = 2147483520.0f;
+
+        struct alignas(16) VertexKey
+        {
+            int32_t values[8];
+        };
+
+        // cell = round((value - offset) * scale) per float of the vertex. A zero scale means that attribute only
+        // merges exact copies, and its key is the float's bits instead.
+        struct GridTransform
+        {
+            alignas(16) float offset[8];
+            alignas(16) float scale[8];
+        };
+
+        static GridTransform gridFor(const vector<Vertex>& vertices, const VertexWeldTolerances& tolerances)
+        {
+            glm::vec3 boundsMin = vertices[0].position;
+            glm::vec3 boundsMax = vertices[0].position;
+            for (const Vertex& vertex : vertices)
+            {
+                boundsMin = glm::min(boundsMin, vertex.position);
+                boundsMax = glm::max(boundsMax, vertex.position);
+            }
+
+            float positionCell = tolerances.position * glm::length(boundsMax - boundsMin);
+
+            GridTransform grid;
+            for (int i = 0; i < 8; i++)
+            {
+                float cell = i < 3 ? positionCell : i < 6 ? tolerances.normal : tolerances.texCoord;
+                grid.offset[i] = i < 3 ? boundsMin[i] : 0.0f;
+                grid.scale[i] = cell > 0.0f ? 1.0f / cell : 0.0f;
+            }
+
+            return grid;
+        }
+
+        static VertexKey snap(const Vertex& vertex, const GridTransform& grid)
+        {
+            const float* values = &vertex.position.x;
+            VertexKey key;
+
+#ifdef VERTEX_WELDER_SSE2
+            const __m128 maxCell = _mm_set1_ps(MAX_CELL);
+            const __m128 zero = _mm_setzero_ps();
+            for (int half = 0; half < 8; half += 4)
+            {
+                // Adding zero turns -0 into +0, so exact keys don't tell them apart
+                __m128 value = _mm_add_ps(_mm_loadu_ps(values + half), zero);
+                __m128 scale = _mm_load_ps(grid.scale + half);
+
+                __m128 cell = _mm_mul_ps(_mm_sub_ps(value, _mm_load_ps(grid.offset + half)), scale);
+                cell = _mm_max_ps(_mm_min_ps(cell, maxCell), _mm_sub_ps(zero, maxCell));
+                __m128i snapped = _mm_cvtps_epi32(cell);
+
+                __m128i exact = _mm_castps_si128(_mm_cmpeq_ps(scale, zero));
+                __m128i result = _mm_or_si128(_mm_and_si128(exact, _mm_castps_si128(value)), _mm_andnot_si128(exact, snapped));
+                _mm_store_si128(reinterpret_cast<__m128i*>(key.values + half), result);
+            }
+#else
+            for (int i = 0; i < 8; i++)
+            {
+                float value = values[i] + 0.0f;
+                if (grid.scale[i] == 0.0f)
+                {
+                    memcpy(&key.values[i], &value, sizeof(float));
+                }
+                else
+                {
+                    float cell = min(max((value - grid.offset[i]) * grid.scale[i], -MAX_CELL), MAX_CELL);
+                    key.values[i] = static_cast<int32_t>(nearbyint(cell));
+                }
+            }
+#endif
+
+            return key;
+        }
+
+        static uint32_t hashKey(const VertexKey& key)
+        {
+            uint32_t hash = 2166136261u;
+            for (int i = 0; i < 8; i++)
+            {
+                hash = (hash ^ static_cast<uint32_t>(key.values[i])) * 16777619u;
+            }
+
+            // FNV's low bits are weak on their own, and the table index only uses the low bits
+            hash ^= hash >> 15;
+            hash *= 0x2C1B3C6Du;
+            hash ^= hash >> 12;
+            return hash;
+        }
+
+        static bool sameKey(const VertexKey& a, const VertexKey& b)
+        {
+#ifdef VERTEX_WELDER_SSE2
+            __m128i low = _mm_cmpeq_epi32(_mm_load_si128(reinterpret_cast<const __m128i*>(a.values)),
+                _mm_load_si128(reinterpret_cast<const __m128i*>(b.values)));
+            __m128i high = _mm_cmpeq_epi32(_mm_load_si128(reinterpret_cast<const __m128i*>(a.values + 4)),
+                _mm_load_si128(reinterpret_cast<const __m128i*>(b.values + 4)));
+            return _mm_movemask_epi8(_mm_and_si128(low, high)) == 0xFFFF;
+#else
+            return memcmp(a.values, b.values, sizeof(a.values)) == 0;
+#endif
+        }
+};
+
+#endif
@@ -0,0 +1,339 @@
+#ifndef GL_STATE_CACHE_H
+#define GL_STATE_CACHE_H
+
+#include <cstddef>
+#include <glad/glad.h>
+
+// Texture units whose bindings are tracked. Binding on a unit past these still works, it just always goes to GL.
+const GLuint GL_STATE_CACHE_TEXTURE_UNITS = 32;
+
+// Indexed uniform buffer binding points that are tracked (GL 3.3 guarantees 36 in total, we use the first few)
+const GLuint GL_STATE_CACHE_UNIFORM_BINDINGS = 16;
+
+// Calls of one kind that went through to GL, and the ones that didn't because the state was already set
+struct GLBindCounts
+{
+    size_t issued = 0;
+    size_t filtered = 0;
+
+    GLBindCounts& operator+=(const GLBindCounts& other)
+    {
+        this->issued += other.issued;
+        this->filtered += other.filtered;
+        return *this;
+    }
+};
+
+struct GLStateStats
+{
+    GLBindCounts programs;
+    GLBindCounts vertexArrays;
+    GLBindCounts activeTextures;
+    GLBindCounts textures;
+    GLBindCounts buffers;
+
+    GLBindCounts total() const
+    {
+        GLBindCounts counts;
+        counts += this->programs;
+        counts += this->vertexArrays;
+        counts += this->activeTextures;
+        counts += this->textures;
+        counts += this->buffers;
+        return counts;
+    }
+};
+
+// Remembers what's bound and drops binds that wouldn't change anything, so code can bind what it needs without
+// worrying whether it's already bound, and without unbinding afterwards just to leave GL in a known state.
+//
+// It only works if every bind it tracks goes through it: the program, vertex arrays, the active texture unit,
+// 2D and buffer textures on each unit, and the buffer targets below. Deleting a bound object unbinds it in GL, so
+// those go through here too. Anything else that changes these behind our back has to call invalidate() afterwards.
+//
+// GL_ELEMENT_ARRAY_BUFFER is part of the bound vertex array's state rather than the context's, so those binds are
+// passed straight through.
+//
+// Like GL itself, only use this on the thread the context is current on.
+class GLStateCache
+{
+public:
+    static GLStateCache& instance()
+    {
+        static GLStateCache cache;
+        return cache;
+    }
+
+    GLStateCache(const GLStateCache&) = delete;
+    GLStateCache& operator=(const GLStateCache&) = delete;
+
+    void useProgram(GLuint program)
+    {
+        if (this->program == program)
+        {
+            this->counts.programs.filtered++;
+            return;
+        }
+
+        glUseProgram(program);
+        this->program = program;
+        this->counts.programs.issued++;
+    }
+
+    void bindVertexArray(GLuint vertexArray)
+    {
+        if (this->vertexArray == vertexArray)
+        {
+            this->counts.vertexArrays.filtered++;
+            return;
+        }
+
+        glBindVertexArray(vertexArray);
+        this->vertexArray = vertexArray;
+        this->counts.vertexArrays.issued++;
+    }
+
+    // Takes the unit's index, not GL_TEXTUREn
+    void activeTexture(GLuint unit)
+    {
+        if (this->activeUnit == unit)
+        {
+            this->counts.activeTextures.filtered++;
+            return;
+        }
+
+        glActiveTexture(GL_TEXTURE0 + unit);
+        this->activeUnit = unit;
+        this->counts.activeTextures.issued++;
+    }
+
+    // Binds to the given unit, making it the active one only if the texture isn't already bound there
+    void bindTexture(GLuint unit, GLenum target, GLuint texture)
+    {
+        GLuint* binding = this->textureBinding(unit, target);
+        if (binding && *binding == texture)
+        {
+            this->counts.textures.filtered++;
+            return;
+        }
+
+        this->activeTexture(unit);
+        glBindTexture(target, texture);
+        this->counts.textures.issued++;
+        if (binding)
+        {
+            *binding = texture;
+        }
+    }
+
+    // Binds to whichever unit is active, for code that only binds a texture to upload to it
+    void bindTexture(GLenum target, GLuint texture)
+    {
+        if (this->activeUnit == UNKNOWN)
+        {
+            this->activeTexture(0);
+        }
+
+        this->bindTexture(this->activeUnit, target, texture);
+    }
+
+    void bindBuffer(GLenum target, GLuint buffer)
+    {
+        GLuint* binding = this->bufferBinding(target);
+        if (binding && *binding == buffer)
+        {
+            this->counts.buffers.filtered++;
+            return;
+        }
+
+        glBindBuffer(target, buffer);
+        this->counts.buffers.issued++;
+        if (binding)
+        {
+            *binding = buffer;
+        }
+    }
+
+    // Also binds the buffer to target's generic binding point, like glBindBufferRange does
+    void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+    {
+        IndexedBinding* binding = target == GL_UNIFORM_BUFFER && index < GL_STATE_CACHE_UNIFORM_BINDINGS ? &this->uniformBindings[index] : nullptr;
+        if (binding && binding->buffer == buffer && binding->offset == offset && binding->size == size)
+        {
+            this->counts.buffers.filtered++;
+            return;
+        }
+
+        glBindBufferRange(target, index, buffer, offset, size);
+        this->counts.buffers.issued++;
+        if (binding)
+        {
+            binding->buffer = buffer;
+            binding->offset = offset;
+            binding->size = size;
+        }
+
+        if (GLuint* generic = this->bufferBinding(target))
+        {
+            *generic = buffer;
+        }
+    }
+
+    // These delete the object and forget any bindings of it GL drops along with it
+
+    void deleteProgram(GLuint program)
+    {
+        glDeleteProgram(program);
+
+        // A program stays in use after it's deleted, but its name can be reused once it's not
+        if (this->program == program)
+        {
+            this->program = UNKNOWN;
+        }
+    }
+
+    void deleteVertexArray(GLuint vertexArray)
+    {
+        glDeleteVertexArrays(1, &vertexArray);
+        if (this->vertexArray == vertexArray)
+        {
+            this->vertexArray = 0;
+        }
+    }
+
+    void deleteTexture(GLuint texture)
+    {
+        glDeleteTextures(1, &texture);
+        for (TextureUnit& unit : this->textureUnits)
+        {
+            forget(unit.texture2D, texture);
+            forget(unit.textureBuffer, texture);
+        }
+    }
+
+    void deleteBuffer(GLuint buffer)
+    {
+        glDeleteBuffers(1, &buffer);
+        forget(this->arrayBuffer, buffer);
+        forget(this->copyReadBuffer, buffer);
+        forget(this->copyWriteBuffer, buffer);
+        forget(this->uniformBuffer, buffer);
+        forget(this->textureBuffer, buffer);
+        for (IndexedBinding& binding : this->uniformBindings)
+        {
+            forget(binding.buffer, buffer);
+        }
+    }
+
+    // Forgets everything, so the next bind of each kind goes through to GL. For after code that binds things
+    // directly, or a context change.
+    void invalidate()
+    {
+        this->program = UNKNOWN;
+        this->vertexArray = UNKNOWN;
+        this->activeUnit = UNKNOWN;
+        for (TextureUnit& unit : this->textureUnits)
+        {
+            unit = TextureUnit();
+        }
+
+        this->arrayBuffer = this->copyReadBuffer = this->copyWriteBuffer = this->uniformBuffer = this->textureBuffer = UNKNOWN;
+        for (IndexedBinding& binding : this->uniformBindings)
+        {
+            binding = IndexedBinding();
+        }
+    }
+
+    // Calls issued and filtered since the last resetStats()
+    const GLStateStats& stats() const
+    {
+        return this->counts;
+    }
+
+    void resetStats()
+    {
+        this->counts = GLStateStats();
+    }
+
+private:
+    // Nothing is known until it's been bound through us once, so the first bind always goes through
+    static const GLuint UNKNOWN = 0xFFFFFFFF;
+
+    struct TextureUnit
+    {
+        GLuint texture2D = UNKNOWN;
+        GLuint textureBuffer = UNKNOWN;
+    };
+
+    struct IndexedBinding
+    {
+        GLuint buffer = UNKNOWN;
+        GLintptr offset = 0;
+        GLsizeiptr size = 0;
+    };
+
+    GLuint program = UNKNOWN;
+    GLuint vertexArray = UNKNOWN;
+    GLuint activeUnit = UNKNOWN;
+    TextureUnit textureUnits[GL_STATE_CACHE_TEXTURE_UNITS];
+
+    GLuint arrayBuffer = UNKNOWN;
+    GLuint copyReadBuffer = UNKNOWN;
+    GLuint copyWriteBuffer = UNKNOWN;
+    GLuint uniformBuffer = UNKNOWN;
+    GLuint textureBuffer = UNKNOWN;
+    IndexedBinding uniformBindings[GL_STATE_CACHE_UNIFORM_BINDINGS];
+
+    GLStateStats counts;
+
+    GLStateCache() = default;
+
+    // Where a target's binding is remembered, or null for one we don't track
+    GLuint* textureBinding(GLuint unit, GLenum target)
+    {
+        if (unit >= GL_STATE_CACHE_TEXTURE_UNITS)
+        {
+            return nullptr;
+        }
+
+        switch (target)
+        {
+        case GL_TEXTURE_2D:
+            return &this->textureUnits[unit].texture2D;
+        case GL_TEXTURE_BUFFER:
+            return &this->textureUnits[unit].textureBuffer;
+        default:
+            return nullptr;
+        }
+    }
+
+    GLuint* bufferBinding(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_ARRAY_BUFFER:
+            return &this->arrayBuffer;
+        case GL_COPY_READ_BUFFER:
+            return &this->copyReadBuffer;
+        case GL_COPY_WRITE_BUFFER:
+            return &this->copyWriteBuffer;
+        case GL_UNIFORM_BUFFER:
+            return &this->uniformBuffer;
+        case GL_TEXTURE_BUFFER:
+            return &this->textureBuffer;
+        default:
+            return nullptr;
+        }
+    }
+
+    // A deleted object's bindings revert to 0
+    static void forget(GLuint& binding, GLuint deleted)
+    {
+        if (binding == deleted)
+        {
+            binding = 0;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,170 @@
+#ifndef INSTANCE_BUFFER_H
+#define INSTANCE_BUFFER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <ModelLoading/geometryArena.h>
+#include <ModelLoading/vertex.h>
+#include <Rendering/glStateCache.h>
+#include <Utility/threadPool.h>
+#include <vector>
+
+// Attribute locations of the per-instance data, after the ones vertices use. A mat4 takes four locations and a mat3
+// three, one per column.
+const GLuint INSTANCE_MODEL_LOCATION = 4;
+const GLuint INSTANCE_NORMAL_MODEL_LOCATION = 8;
+
+// Pass this to Shader's defines to build the variant of a shader that reads its model and normal matrices from
+// the instance attributes instead of uniforms
+const char* const INSTANCED_SHADER_DEFINE = "INSTANCED";
+
+// Instances whose normal matrices are worked out by one pool task at a time
+const size_t INSTANCE_UPLOAD_BATCH = 1024;
+
+// What each instance gets, as vertex attributes stepping once per instance
+struct InstanceTransform
+{
+    glm::mat4 model = glm::mat4(1.0f);
+
+    // The inverse transpose of model's upper 3x3, so normals survive non-uniform scaling
+    glm::mat3 normalModel = glm::mat3(1.0f);
+};
+
+static_assert(sizeof(InstanceTransform) == 25 * sizeof(float), "InstanceTransform is uploaded as 25 tightly packed floats");
+
+// Per-instance transforms for drawing the same geometry many times with one instanced draw call.
+//
+// Transforms are uploaded once, with their normal matrices worked out up front (on the shared thread pool, for big
+// batches) rather than per vertex or per draw, and are read through attributes with a divisor of 1. Upload again
+// only when the instances change.
+//
+// attach() adds the attributes to a VAO of our own, for plain vertex arrays like the container cube. Meshes live in
+// a GeometryArena whose VAO every mesh shares, so for those vertexArrayFor() keeps a VAO per arena that has both the
+// arena's vertex layout and our instance attributes.
+//
+// Owns GL objects, so create, use and destroy it on the thread the GL context is current on.
+class InstanceBuffer
+{
+public:
+    InstanceBuffer()
+    {
+        glGenBuffers(1, &this->buffer);
+    }
+
+    ~InstanceBuffer()
+    {
+        for (ArenaVertexArray& vertexArray : this->arenaVertexArrays)
+        {
+            if (vertexArray.id != 0)
+            {
+                GLStateCache::instance().deleteVertexArray(vertexArray.id);
+            }
+        }
+
+        GLStateCache::instance().deleteBuffer(this->buffer);
+    }
+
+    InstanceBuffer(const InstanceBuffer&) = delete;
+    InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+
+    // Uploads one instance per model matrix, working out each one's normal matrix
+    void upload(const std::vector<glm::mat4>& models)
+    {
+        std::vector<InstanceTransform> instances(models.size());
+        size_t batchCount = (models.size() + INSTANCE_UPLOAD_BATCH - 1) / INSTANCE_UPLOAD_BATCH;
+        sharedThreadPool().parallelFor(batchCount, [&](size_t batch)
+        {
+            size_t end = std::min(models.size(), (batch + 1) * INSTANCE_UPLOAD_BATCH);
+            for (size_t i = batch * INSTANCE_UPLOAD_BATCH; i < end; i++)
+            {
+                instances[i].model = models[i];
+                instances[i].normalModel = glm::transpose(glm::inverse(glm::mat3(models[i])));
+            }
+        });
+
+        this->upload(instances);
+    }
+
+    void upload(const std::vector<InstanceTransform>& instances)
+    {
+        // Reallocating rather than writing over the old data, so the driver doesn't wait for draws still using it
+        GLStateCache::instance().bindBuffer(GL_ARRAY_BUFFER, this->buffer);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(InstanceTransform), instances.data(), GL_STATIC_DRAW);
+        this->count = instances.size();
+    }
+
+    // Adds the instance attributes to a VAO, which is left bound
+    void attach(GLuint vertexArray) const
+    {
+        GLStateCache::instance().bindVertexArray(vertexArray);
+        this->setupAttributes();
+    }
+
+    // A VAO for drawing the given arena's meshes instanced, rebuilt whenever the arena has replaced its buffers
+    GLuint vertexArrayFor(VertexFormat format)
+    {
+        GeometryArena& arena = GeometryArena::instance(format);
+        ArenaVertexArray& vertexArray = this->arenaVertexArrays[format == VertexFormat::Quantized ? 1 : 0];
+        if (vertexArray.id == 0 || vertexArray.arenaVersion != arena.bufferVersion())
+        {
+            if (vertexArray.id == 0)
+            {
+                glGenVertexArrays(1, &vertexArray.id);
+            }
+
+            GLStateCache::instance().bindVertexArray(vertexArray.id);
+            arena.setupAttributes();
+            this->setupAttributes();
+            vertexArray.arenaVersion = arena.bufferVersion();
+        }
+
+        return vertexArray.id;
+    }
+
+    GLsizei instanceCount() const
+    {
+        return static_cast<GLsizei>(this->count);
+    }
+
+private:
+    struct ArenaVertexArray
+    {
+        GLuint id = 0;
+        unsigned int arenaVersion = 0;
+    };
+
+    GLuint buffer = 0;
+    size_t count = 0;
+
+    // One per VertexFormat
+    ArenaVertexArray arenaVertexArrays[2];
+
+    // Points the bound VAO's instance attributes at our buffer
+    void setupAttributes() const
+    {
+        GLStateCache::instance().bindBuffer(GL_ARRAY_BUFFER, this->buffer);
+
+        GLsizei stride = sizeof(InstanceTransform);
+        for (GLuint column = 0; column < 4; column++)
+        {
+            GLuint location = INSTANCE_MODEL_LOCATION + column;
+            size_t offset = offsetof(InstanceTransform, model) + column * sizeof(glm::vec4);
+            glEnableVertexAttribArray(location);
+            glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+            glVertexAttribDivisor(location, 1);
+        }
+
+        for (GLuint column = 0; column < 3; column++)
+        {
+            GLuint location = INSTANCE_NORMAL_MODEL_LOCATION + column;
+            size_t offset = offsetof(InstanceTransform, normalModel) + column * sizeof(glm::vec3);
+            glEnableVertexAttribArray(location);
+            glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+            glVertexAttribDivisor(location, 1);
+        }
+    }
+};
+
+#endif
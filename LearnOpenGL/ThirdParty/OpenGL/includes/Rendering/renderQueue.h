@@ -0,0 +1,348 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <ModelLoading/geometryArena.h>
+#include <ModelLoading/mesh.h>
+#include <ModelLoading/meshletBuilder.h>
+#include <Rendering/glStateCache.h>
+#include <Rendering/instanceBuffer.h>
+#include <Shaders/shader.h>
+#include <Utility/hash.h>
+#include <vector>
+
+// Passes run in this order, and pick how their draws are sorted
+enum class RenderPass : uint8_t
+{
+    // Depth tested and written, sorted by state and then front to back so early depth testing rejects what's hidden
+    Opaque = 0,
+
+    // Alpha blended without writing depth, sorted back to front so each draw blends over what's behind it
+    Transparent = 1
+};
+
+// Textures a plain vertex array draw binds, to units 0, 1, ... (meshes bind their own)
+const size_t RENDER_QUEUE_MAX_TEXTURES = 4;
+
+// Reserves count consecutive ids for DrawSubmission::material and returns the first. Ids start at 1, so every
+// material that asks gets one of its own, and 0 is left for draws that don't care.
+inline uint32_t allocateMaterialIds(uint32_t count)
+{
+    static std::atomic<uint32_t> nextMaterialId(1);
+    return nextMaterialId.fetch_add(count);
+}
+
+// One draw, as handed to RenderQueue::submit(). Either a Mesh (drawn from its GeometryArena) or vertexCount vertices
+// of a plain vertex array, optionally once per instance of an InstanceBuffer. Everything pointed to has to stay alive
+// until the queue has been executed.
+struct DrawSubmission
+{
+    RenderPass pass = RenderPass::Opaque;
+    Shader* shader = nullptr;
+
+    // Set as a uniform if the handle is valid, otherwise the shader's model matrix is left as it is
+    UniformHandle modelUniform;
+    glm::mat4 model = glm::mat4(1.0f);
+
+    // Draws sharing a material id are kept together, for whatever per-material uniforms the caller sets up. Get ids
+    // from allocateMaterialIds(), Models give each of their meshes its material's.
+    uint32_t material = 0;
+
+    // View space distance to the draw, for ordering within the pass
+    float depth = 0.0f;
+
+    Mesh* mesh = nullptr;
+    unsigned int lod = 0;
+    const MeshletCuller* culler = nullptr;
+    MeshletCullingStats* cullingStats = nullptr;
+
+    GLuint vertexArray = 0;
+    GLsizei vertexCount = 0;
+    std::array<GLuint, RENDER_QUEUE_MAX_TEXTURES> textures = {};
+
+    InstanceBuffer* instances = nullptr;
+};
+
+// What the last RenderQueue::execute() did, and how often consecutive draws had to change state
+struct RenderQueueStats
+{
+    size_t drawCount = 0;
+    size_t shaderChanges = 0;
+    size_t materialChanges = 0;
+    size_t textureSetChanges = 0;
+};
+
+// Collects a frame's draws, sorts them by a 64-bit key and issues them in that order, so draws sharing a shader,
+// material and textures run back to back and the state only changes when it has to (the binds that do happen go
+// through GLStateCache, which drops whatever's left over).
+//
+// The key puts the pass in the top 2 bits. Opaque draws follow with the shader, material, texture set and depth, so
+// they're grouped by state and front to back within each group. Transparent draws have to be back to front whatever
+// their state, so their inverted depth comes first and the state only breaks ties:
+//
+//     Opaque:      pass:2 | shader:10 | material:12 | textures:12 | depth:28
+//     Transparent: pass:2 | ~depth:28 | shader:10 | material:12 | textures:12
+//
+// Shader and material ids and the texture set's hash are cut down to their fields, so two of them can end up
+// sharing a value. That only costs some grouping, never correctness. Depth is the top 28 bits of the float, which
+// for non-negative floats sort the same as the floats do.
+//
+// Keys are sorted with an 8-bit LSD radix sort, skipping the passes where every key has the same byte, which with
+// the few shaders and materials of a typical frame is most of them.
+class RenderQueue
+{
+public:
+    void submit(const DrawSubmission& submission)
+    {
+        SortEntry entry;
+        entry.key = sortKey(submission);
+        entry.index = static_cast<uint32_t>(this->submissions.size());
+        this->submissions.push_back(submission);
+        this->entries.push_back(entry);
+    }
+
+    // Sorts and issues everything submitted since the last clear()
+    void execute()
+    {
+        this->sort();
+        this->lastStats = RenderQueueStats();
+
+        GLStateCache& state = GLStateCache::instance();
+        const DrawSubmission* previous = nullptr;
+        uint16_t previousTextureSet = 0;
+        for (const SortEntry& entry : this->entries)
+        {
+            const DrawSubmission& draw = this->submissions[entry.index];
+            uint16_t textureSet = textureSetOf(draw);
+
+            if (!previous || draw.pass != previous->pass)
+            {
+                beginPass(draw.pass);
+            }
+
+            if (!previous || draw.shader != previous->shader)
+            {
+                this->lastStats.shaderChanges++;
+            }
+
+            if (!previous || draw.material != previous->material)
+            {
+                this->lastStats.materialChanges++;
+            }
+
+            if (!previous || textureSet != previousTextureSet)
+            {
+                this->lastStats.textureSetChanges++;
+            }
+
+            draw.shader->useProgram();
+            if (draw.modelUniform.isValid())
+            {
+                draw.shader->setMat4(draw.modelUniform, draw.model);
+            }
+
+            if (draw.mesh)
+            {
+                if (draw.instances)
+                {
+                    draw.mesh->drawInstanced(*draw.shader, *draw.instances, draw.lod);
+                }
+                else
+                {
+                    GeometryArena::instance(draw.mesh->format()).bind();
+                    draw.mesh->drawInBoundArena(*draw.shader, draw.lod, draw.culler, draw.cullingStats);
+                }
+            }
+            else
+            {
+                for (GLuint unit = 0; unit < RENDER_QUEUE_MAX_TEXTURES && draw.textures[unit] != 0; unit++)
+                {
+                    state.bindTexture(unit, GL_TEXTURE_2D, draw.textures[unit]);
+                }
+
+                state.bindVertexArray(draw.vertexArray);
+                if (draw.instances)
+                {
+                    glDrawArraysInstanced(GL_TRIANGLES, 0, draw.vertexCount, draw.instances->instanceCount());
+                }
+                else
+                {
+                    glDrawArrays(GL_TRIANGLES, 0, draw.vertexCount);
+                }
+            }
+
+            this->lastStats.drawCount++;
+            previous = &draw;
+            previousTextureSet = textureSet;
+        }
+
+        // Leave things as the opaque pass expects them
+        if (previous && previous->pass != RenderPass::Opaque)
+        {
+            beginPass(RenderPass::Opaque);
+        }
+    }
+
+    // Empties the queue, keeping its memory for the next frame
+    void clear()
+    {
+        this->submissions.clear();
+        this->entries.clear();
+    }
+
+    size_t size() const
+    {
+        return this->submissions.size();
+    }
+
+    const RenderQueueStats& lastExecuteStats() const
+    {
+        return this->lastStats;
+    }
+
+private:
+    struct SortEntry
+    {
+        uint64_t key;
+        uint32_t index;
+    };
+
+    std::vector<DrawSubmission> submissions;
+    std::vector<SortEntry> entries;
+
+    // The radix sort's other buffer, kept so sorting doesn't allocate every frame
+    std::vector<SortEntry> sortBuffer;
+
+    RenderQueueStats lastStats;
+
+    static const unsigned int SHADER_BITS = 10;
+    static const unsigned int MATERIAL_BITS = 12;
+    static const unsigned int TEXTURE_SET_BITS = 12;
+    static const unsigned int DEPTH_BITS = 28;
+
+    static uint64_t sortKey(const DrawSubmission& draw)
+    {
+        uint64_t pass = static_cast<uint64_t>(draw.pass);
+        uint64_t shader = draw.shader->ID & ((1u << SHADER_BITS) - 1);
+        uint64_t material = draw.material & ((1u << MATERIAL_BITS) - 1);
+        uint64_t textures = textureSetOf(draw);
+        uint64_t depth = depthBits(draw.depth);
+
+        uint64_t state = (shader << (MATERIAL_BITS + TEXTURE_SET_BITS)) | (material << TEXTURE_SET_BITS) | textures;
+        if (draw.pass == RenderPass::Transparent)
+        {
+            uint64_t farFirst = ~depth & ((uint64_t(1) << DEPTH_BITS) - 1);
+            return (pass << 62) | (farFirst << (SHADER_BITS + MATERIAL_BITS + TEXTURE_SET_BITS)) | state;
+        }
+
+        return (pass << 62) | (state << DEPTH_BITS) | depth;
+    }
+
+    // The top bits of the float. Non-negative floats order the same as their bit patterns do.
+    static uint64_t depthBits(float depth)
+    {
+        depth = std::max(depth, 0.0f);
+        uint32_t bits;
+        std::memcpy(&bits, &depth, sizeof(bits));
+        return bits >> (32 - DEPTH_BITS);
+    }
+
+    // Hash of the textures the draw binds, folded down to TEXTURE_SET_BITS
+    static uint16_t textureSetOf(const DrawSubmission& draw)
+    {
+        uint64_t hash = FNV_OFFSET_BASIS;
+        if (draw.mesh)
+        {
+            for (const Texture& texture : draw.mesh->textures)
+            {
+                hash = hashBytes(&texture.id, sizeof(texture.id), hash);
+            }
+        }
+        else
+        {
+            hash = hashBytes(draw.textures.data(), sizeof(GLuint) * draw.textures.size(), hash);
+        }
+
+        hash ^= hash >> 32;
+        hash ^= hash >> 16;
+        return static_cast<uint16_t>(hash & ((1u << TEXTURE_SET_BITS) - 1));
+    }
+
+    static void beginPass(RenderPass pass)
+    {
+        if (pass == RenderPass::Transparent)
+        {
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glDepthMask(GL_FALSE);
+        }
+        else
+        {
+            glDisable(GL_BLEND);
+            glDepthMask(GL_TRUE);
+        }
+    }
+
+    // LSD radix sort on the keys, a byte at a time. Stable, so equal keys keep their submission order.
+    void sort()
+    {
+        size_t count = this->entries.size();
+        if (count < 2)
+        {
+            return;
+        }
+
+        // All eight histograms in one pass over the keys
+        size_t histograms[8][256] = {};
+        for (const SortEntry& entry : this->entries)
+        {
+            for (unsigned int byte = 0; byte < 8; byte++)
+            {
+                histograms[byte][(entry.key >> (byte * 8)) & 0xFF]++;
+            }
+        }
+
+        this->sortBuffer.resize(count);
+        SortEntry* source = this->entries.data();
+        SortEntry* destination = this->sortBuffer.data();
+        for (unsigned int byte = 0; byte < 8; byte++)
+        {
+            size_t* histogram = histograms[byte];
+
+            // Every key has the same byte here, this pass wouldn't move anything
+            if (histogram[(source[0].key >> (byte * 8)) & 0xFF] == count)
+            {
+                continue;
+            }
+
+            size_t offset = 0;
+            for (size_t bucket = 0; bucket < 256; bucket++)
+            {
+                size_t bucketCount = histogram[bucket];
+                histogram[bucket] = offset;
+                offset += bucketCount;
+            }
+
+            for (size_t i = 0; i < count; i++)
+            {
+                destination[histogram[(source[i].key >> (byte * 8)) & 0xFF]++] = source[i];
+            }
+
+            std::swap(source, destination);
+        }
+
+        if (source != this->entries.data())
+        {
+            this->entries.swap(this->sortBuffer);
+        }
+    }
+};
+
+#endif
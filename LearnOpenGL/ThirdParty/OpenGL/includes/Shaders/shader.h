@@ -3,10 +3,29 @@
 
 #include <glad/glad.h>
 
-#include <string>
-#include <fstream>
-#include <sstream>
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <Rendering/glStateCache.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <Shaders/uniformBlocks.h>
+#include <Utility/assets.h>
+#include <Utility/hash.h>
+
+// Location of a uniform in one Shader's program, resolved ahead of time with Shader::uniform(). Hold on to it and
+// pass it to the set functions every frame, which then go straight to glUniform* without any string work or driver
+// lookup. A handle to a uniform the program doesn't have (or optimized out) has location -1, which GL ignores.
+struct UniformHandle
+{
+    GLint location = -1;
+
+    bool isValid() const
+    {
+        return this->location >= 0;
+    }
+};
 
 class Shader
 {
@@ -14,41 +33,20 @@ class Shader
 public:
     unsigned int ID;
 
-    // Creates a shader program given filepaths to a vertex and fragment shader
-    Shader(const char* vertexPath, const char* fragmentPath)
+    // Creates a shader program given the asset names of a vertex and fragment shader. Each of defines is #defined in
+    // both stages, to build a variant of the shader (e.g. INSTANCED_SHADER_DEFINE).
+    Shader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& defines = std::vector<std::string>())
     {
-        // Retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-
-        // Ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        try
-        {
-            // Open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-
-            // Read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-
-            // Close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-
-            // Convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
-        }
-        catch (std::ifstream::failure& e)
+        // Retrieve the vertex/fragment source code, from a mounted archive or loose file
+        AssetData vShaderFile = Assets::instance().read(vertexPath);
+        AssetData fShaderFile = Assets::instance().read(fragmentPath);
+        if (!vShaderFile.isOpen() || !fShaderFile.isOpen())
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << e.what() << std::endl;
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << (vShaderFile.isOpen() ? fragmentPath : vertexPath) << std::endl;
         }
+
+        std::string vertexCode = withDefines(vShaderFile.toString(), defines);
+        std::string fragmentCode = withDefines(fShaderFile.toString(), defines);
         const char* vShaderCode = vertexCode.c_str();
         const char* fShaderCode = fragmentCode.c_str();
 
@@ -73,6 +71,8 @@ public:
         glAttachShader(ID, fragment);
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
+        buildUniformTable();
+        bindUniformBlocks();
 
         // Delete the shaders as they're linked into our program now and no longer necessary
         glDeleteShader(vertex);
@@ -82,7 +82,7 @@ public:
     // Activates the shader
     void useProgram()
     {
-        glUseProgram(ID);
+        GLStateCache::instance().useProgram(ID);
     }
 
     // Deletes the shader.
@@ -90,49 +90,250 @@ public:
     // a new one via this class' constructor.
     void deleteProgram()
     {
-        glDeleteProgram(ID);
+        GLStateCache::instance().deleteProgram(ID);
     }
 
+    #pragma region Uniform Handles
+
+    // Looks a uniform up in the table built when the program was linked. Do this once, outside the render loop, and
+    // keep the handle.
+    UniformHandle uniform(const char* name) const
+    {
+        return findUniform(name, std::strlen(name));
+    }
+
+    UniformHandle uniform(const std::string& name) const
+    {
+        return findUniform(name.data(), name.size());
+    }
+
+    // Number of uniform names in the table (each element of an array counts)
+    size_t uniformCount() const
+    {
+        return uniformLocations.size();
+    }
+
+    #pragma endregion
+
     #pragma region Utility Uniform Functions
 
+    // These take a handle from uniform(), and are what the render loop should use
+    void setBool(UniformHandle uniform, bool value) const
+    {
+        glUniform1i(uniform.location, (int)value);
+    }
+
+    void setInt(UniformHandle uniform, int value) const
+    {
+        glUniform1i(uniform.location, value);
+    }
+
+    void setFloat(UniformHandle uniform, float value) const
+    {
+        glUniform1f(uniform.location, value);
+    }
+
+    void setMat3(UniformHandle uniform, const glm::mat3& mat) const
+    {
+        glUniformMatrix3fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+    }
+
+    void setMat4(UniformHandle uniform, const glm::mat4& mat) const
+    {
+        glUniformMatrix4fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+    }
+
+    void setVec3(UniformHandle uniform, const glm::vec3& vec) const
+    {
+        glUniform3fv(uniform.location, 1, &vec[0]);
+    }
+
+    void setVec4(UniformHandle uniform, const glm::vec4& vec) const
+    {
+        glUniform4fv(uniform.location, 1, &vec[0]);
+    }
+
+    // By name, for one-off setup. Still no driver lookup, but hashes the name every call.
     void setBool(const std::string& name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        setBool(uniform(name), value);
     }
 
     void setInt(const std::string& name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        setInt(uniform(name), value);
     }
 
     void setFloat(const std::string& name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        setFloat(uniform(name), value);
     }
 
     void setMat3(const std::string& name, const glm::mat3& mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat3(uniform(name), mat);
     }
 
     void setMat4(const std::string& name, const glm::mat4& mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat4(uniform(name), mat);
     }
 
     void setVec3(const std::string& name, const glm::vec3& vec) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &vec[0]);
+        setVec3(uniform(name), vec);
     }
 
     void setVec4(const std::string& name, const glm::vec4& vec) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &vec[0]);
+        setVec4(uniform(name), vec);
     }
 
     #pragma endregion
 
 private:
+    // Adds the defines right after the #version line, which has to come first. A #line directive after them keeps
+    // the compiler's line numbers matching the file.
+    static std::string withDefines(const std::string& source, const std::vector<std::string>& defines)
+    {
+        if (defines.empty())
+        {
+            return source;
+        }
+
+        size_t insertAt = 0;
+        size_t versionStart = source.find("#version");
+        if (versionStart != std::string::npos)
+        {
+            size_t lineEnd = source.find('\n', versionStart);
+            insertAt = lineEnd == std::string::npos ? source.size() : lineEnd + 1;
+        }
+
+        std::string header = insertAt > 0 && source[insertAt - 1] != '\n' ? "\n" : "";
+        for (const std::string& define : defines)
+        {
+            header += "#define " + define + "\n";
+        }
+
+        size_t nextLine = std::count(source.begin(), source.begin() + insertAt, '\n') + 1;
+        header += "#line " + std::to_string(nextLine) + "\n";
+        return source.substr(0, insertAt) + header + source.substr(insertAt);
+    }
+
+    struct UniformEntry
+    {
+        std::string name;
+        GLint location;
+    };
+
+    // Location of every active uniform, keyed by the hash of its name. The name is kept too and compared on lookup,
+    // so two names that happen to hash the same can't hand out each other's location.
+    std::unordered_multimap<uint64_t, UniformEntry> uniformLocations;
+
+    #pragma region Uniform Reflection
+
+    // Asks the linked program for all of its active uniforms and records where each one lives. Arrays are reported
+    // once, as "name[0]", so every element is added under its own name too, plus the bare name for element 0.
+    // Uniforms in a uniform block have no location and are left out.
+    void buildUniformTable()
+    {
+        uniformLocations.clear();
+
+        GLint activeCount = 0, maxNameLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &activeCount);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+        std::string nameBuffer(std::max(maxNameLength, 1), '\0');
+        for (GLint i = 0; i < activeCount; i++)
+        {
+            GLsizei nameLength = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)nameBuffer.size(), &nameLength, &size, &type, &nameBuffer[0]);
+            std::string name(nameBuffer.data(), nameLength);
+
+            GLint location = glGetUniformLocation(ID, name.c_str());
+            if (location < 0)
+            {
+                continue;
+            }
+
+            addUniform(name, location);
+
+            size_t arraySuffix = name.size() >= 3 ? name.rfind("[0]") : std::string::npos;
+            if (arraySuffix == std::string::npos || arraySuffix != name.size() - 3)
+            {
+                continue;
+            }
+
+            std::string baseName = name.substr(0, arraySuffix);
+            addUniform(baseName, location);
+            for (GLint element = 1; element < size; element++)
+            {
+                std::string elementName = baseName + "[" + std::to_string(element) + "]";
+                addUniform(elementName, glGetUniformLocation(ID, elementName.c_str()));
+            }
+        }
+    }
+
+    void addUniform(const std::string& name, GLint location)
+    {
+        uint64_t nameHash = hashString(name);
+        auto range = uniformLocations.equal_range(nameHash);
+        for (auto entry = range.first; entry != range.second; ++entry)
+        {
+            if (entry->second.name == name)
+            {
+                entry->second.location = location;
+                return;
+            }
+        }
+
+        uniformLocations.emplace(nameHash, UniformEntry{ name, location });
+    }
+
+    // Points each of the program's uniform blocks at its shared binding point (see uniformBlocks.h)
+    void bindUniformBlocks()
+    {
+        GLint blockCount = 0, maxNameLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxNameLength);
+
+        std::string nameBuffer(std::max(maxNameLength, 1), '\0');
+        for (GLint i = 0; i < blockCount; i++)
+        {
+            GLsizei nameLength = 0;
+            glGetActiveUniformBlockName(ID, (GLuint)i, (GLsizei)nameBuffer.size(), &nameLength, &nameBuffer[0]);
+            std::string name(nameBuffer.data(), nameLength);
+
+            GLint binding = uniformBlockBinding(name.c_str());
+            if (binding < 0)
+            {
+                std::cout << "ERROR::SHADER::UNKNOWN_UNIFORM_BLOCK: " << name << std::endl;
+                continue;
+            }
+
+            glUniformBlockBinding(ID, (GLuint)i, (GLuint)binding);
+        }
+    }
+
+    UniformHandle findUniform(const char* name, size_t nameLength) const
+    {
+        UniformHandle handle;
+        auto range = uniformLocations.equal_range(hashBytes(name, nameLength));
+        for (auto entry = range.first; entry != range.second; ++entry)
+        {
+            if (entry->second.name.compare(0, std::string::npos, name, nameLength) == 0)
+            {
+                handle.location = entry->second.location;
+                break;
+            }
+        }
+
+        return handle;
+    }
+
+    #pragma endregion
 
     #pragma region Error Checking
 
@@ -0,0 +1,112 @@
+#ifndef UNIFORM_BLOCKS_H
+#define UNIFORM_BLOCKS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Uniform blocks every program shares. Each one has a fixed binding point, and Shader binds any block it finds with
+// one of these names to it at link, so the buffer bound there (see UniformRingBuffer) feeds every program at once.
+//
+// The structs below mirror the std140 layout of the GLSL blocks byte for byte, so they're uploaded with a single
+// memcpy. GLSL has no includes, so the blocks are declared again in each shader; keep them in sync with these.
+// Every vec3 is followed by a float, which std140 packs into the vec3's 16 byte slot just like C++ does.
+
+const GLuint CAMERA_BLOCK_BINDING = 0;
+const GLuint LIGHT_BLOCK_BINDING = 1;
+
+const char* const CAMERA_BLOCK_NAME = "CameraBlock";
+const char* const LIGHT_BLOCK_NAME = "LightBlock";
+
+// Point lights don't fit in a uniform block in any number, LightManager keeps them in a texture buffer bound to this
+// unit, after the ones materials use
+const GLuint POINT_LIGHT_TEXTURE_UNIT = 15;
+const char* const POINT_LIGHT_SAMPLER_NAME = "pointLightData";
+
+// Binding point for a block name, or -1 if it's not one of ours
+inline GLint uniformBlockBinding(const char* blockName)
+{
+    if (std::strcmp(blockName, CAMERA_BLOCK_NAME) == 0)
+    {
+        return CAMERA_BLOCK_BINDING;
+    }
+
+    if (std::strcmp(blockName, LIGHT_BLOCK_NAME) == 0)
+    {
+        return LIGHT_BLOCK_BINDING;
+    }
+
+    return -1;
+}
+
+// layout (std140) uniform CameraBlock, written once per frame
+struct CameraBlockData
+{
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 projection = glm::mat4(1.0f);
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    glm::vec3 viewPos = glm::vec3(0.0f);
+    float padding = 0.0f;
+};
+
+struct DirectionalLightData
+{
+    glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f);
+    float padding0 = 0.0f;
+    glm::vec3 ambient = glm::vec3(0.0f);
+    float padding1 = 0.0f;
+    glm::vec3 diffuse = glm::vec3(0.0f);
+    float padding2 = 0.0f;
+    glm::vec3 specular = glm::vec3(0.0f);
+    float padding3 = 0.0f;
+};
+
+// Not part of a block, but laid out the same way: LightManager stores each row as a vec4 of the point light buffer.
+// The attenuation terms ride along in the vec3s' spare floats.
+struct PointLightData
+{
+    glm::vec3 position = glm::vec3(0.0f);
+    float constant = 1.0f;
+    glm::vec3 ambient = glm::vec3(0.0f);
+    float linear = 0.0f;
+    glm::vec3 diffuse = glm::vec3(0.0f);
+    float quadratic = 0.0f;
+    glm::vec3 specular = glm::vec3(0.0f);
+    float padding = 0.0f;
+};
+
+// Cut offs are the cosines of the cone's half angles
+struct SpotLightData
+{
+    glm::vec3 position = glm::vec3(0.0f);
+    float constant = 1.0f;
+    glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f);
+    float linear = 0.0f;
+    glm::vec3 ambient = glm::vec3(0.0f);
+    float quadratic = 0.0f;
+    glm::vec3 diffuse = glm::vec3(0.0f);
+    float innerCutOff = 1.0f;
+    glm::vec3 specular = glm::vec3(0.0f);
+    float outerCutOff = 1.0f;
+};
+
+// layout (std140) uniform LightBlock. The point lights themselves are in the texture buffer, as four streams of
+// pointLightCapacity vec4s each (see LightManager).
+struct LightBlockData
+{
+    DirectionalLightData directionalLight;
+    SpotLightData spotLight;
+    int32_t pointLightCount = 0;
+    int32_t pointLightCapacity = 0;
+    int32_t padding[2] = { 0, 0 };
+};
+
+static_assert(sizeof(CameraBlockData) == 208 && offsetof(CameraBlockData, viewPos) == 192, "CameraBlockData must match std140 CameraBlock");
+static_assert(sizeof(DirectionalLightData) == 64 && sizeof(PointLightData) == 64 && sizeof(SpotLightData) == 80,
+    "Light structs must match their std140 layout");
+static_assert(offsetof(LightBlockData, spotLight) == 64 && offsetof(LightBlockData, pointLightCount) == 144 && sizeof(LightBlockData) == 160,
+    "LightBlockData must match std140 LightBlock");
+
+#endif
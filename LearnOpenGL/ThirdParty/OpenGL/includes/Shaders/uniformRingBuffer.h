@@ -0,0 +1,135 @@
+#ifndef UNIFORM_RING_BUFFER_H
+#define UNIFORM_RING_BUFFER_H
+
+#include <cstddef>
+#include <cstring>
+#include <glad/glad.h>
+#include <Rendering/glStateCache.h>
+#include <type_traits>
+#include <vector>
+
+// Frames the GPU can be behind us before update() has to wait for it
+const unsigned int UNIFORM_RING_FRAMES = 3;
+
+// A uniform buffer holding a few copies of one block, written a whole block at a time, typically once per frame.
+//
+// Each update() goes into the next copy and binds that range to the block's binding point, so we never write into
+// a range the GPU may still be reading for an earlier frame. That lets us map unsynchronized instead of having the
+// driver either stall or shadow the buffer. A fence is dropped every time we move on to the next copy, and in the
+// rare case we come all the way round before the GPU has caught up, we wait on it.
+//
+// Owns GL objects, so create, use and destroy it on the thread the GL context is current on.
+class UniformRingBuffer
+{
+public:
+    UniformRingBuffer(GLuint binding, size_t blockSize, unsigned int frameCount = UNIFORM_RING_FRAMES)
+        : binding(binding), blockSize(blockSize), fences(frameCount, nullptr)
+    {
+        // Every copy has to start at a multiple of the implementation's offset alignment
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        this->stride = (blockSize + alignment - 1) / alignment * alignment;
+
+        glGenBuffers(1, &this->buffer);
+        GLStateCache::instance().bindBuffer(GL_UNIFORM_BUFFER, this->buffer);
+        glBufferData(GL_UNIFORM_BUFFER, this->stride * frameCount, nullptr, GL_DYNAMIC_DRAW);
+        GLStateCache::instance().bindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    ~UniformRingBuffer()
+    {
+        for (GLsync fence : this->fences)
+        {
+            if (fence)
+            {
+                glDeleteSync(fence);
+            }
+        }
+
+        GLStateCache::instance().deleteBuffer(this->buffer);
+    }
+
+    UniformRingBuffer(const UniformRingBuffer&) = delete;
+    UniformRingBuffer& operator=(const UniformRingBuffer&) = delete;
+
+    // Copies blockSize bytes of data into the next copy of the block and binds it
+    void update(const void* data)
+    {
+        // Everything drawn so far used the current copy
+        if (this->written)
+        {
+            this->fences[this->slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            this->slot = (this->slot + 1) % this->fences.size();
+        }
+
+        this->waitForSlot(this->slot);
+
+        GLintptr offset = static_cast<GLintptr>(this->slot * this->stride);
+        GLStateCache::instance().bindBuffer(GL_UNIFORM_BUFFER, this->buffer);
+        void* mapped = glMapBufferRange(GL_UNIFORM_BUFFER, offset, this->blockSize,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (mapped)
+        {
+            std::memcpy(mapped, data, this->blockSize);
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+        }
+        else
+        {
+            glBufferSubData(GL_UNIFORM_BUFFER, offset, this->blockSize, data);
+        }
+
+        GLStateCache::instance().bindBufferRange(GL_UNIFORM_BUFFER, this->binding, this->buffer, offset, this->blockSize);
+        this->written = true;
+    }
+
+    // Same, for one of the block structs in uniformBlocks.h
+    template <typename T>
+    void update(const T& block)
+    {
+        static_assert(!std::is_pointer<T>::value, "Pass the block itself, or a const void* to its bytes");
+        this->update(static_cast<const void*>(&block));
+    }
+
+    GLuint bindingPoint() const
+    {
+        return this->binding;
+    }
+
+private:
+    GLuint buffer = 0;
+    GLuint binding;
+    size_t blockSize;
+    size_t stride = 0;
+
+    // Fence for each copy, set once we've moved past it, null if the GPU's known to be done with it
+    std::vector<GLsync> fences;
+    size_t slot = 0;
+    bool written = false;
+
+    void waitForSlot(size_t index)
+    {
+        GLsync fence = this->fences[index];
+        if (!fence)
+        {
+            return;
+        }
+
+        // Only the first wait needs the flush, in case the fence is still sitting in our command queue
+        GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        while (true)
+        {
+            GLenum result = glClientWaitSync(fence, flags, 1000000);
+            if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED)
+            {
+                break;
+            }
+
+            flags = 0;
+        }
+
+        glDeleteSync(fence);
+        this->fences[index] = nullptr;
+    }
+};
+
+#endif
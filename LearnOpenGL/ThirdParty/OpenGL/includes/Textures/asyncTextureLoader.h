@@ -0,0 +1,173 @@
+#ifndef ASYNC_TEXTURE_LOADER_H
+#define ASYNC_TEXTURE_LOADER_H
+
+#include <chrono>
+#include <cstddef>
+#include <future>
+#include <glad/glad.h>
+#include <iostream>
+#include <Rendering/glStateCache.h>
+#include <string>
+#include <Textures/texture.h>
+#include <Utility/threadPool.h>
+#include <Utility/timer.h>
+#include <vector>
+
+// Default amount of each frame we're willing to spend on texture uploads
+const double TEXTURE_UPLOAD_BUDGET_MS = 2.0;
+
+// Streams textures in without blocking on JPEG/PNG decode (or block compression).
+//
+// load() hands back a real GL texture id straight away, holding a 1x1 placeholder texel. The image is decoded on the
+// shared thread pool, and processUploads() (called once per frame on the render thread) swaps the decoded pixels into
+// that same texture. Since the id never changes, anything already bound to it just starts showing the real image.
+//
+// Everything except the decode runs on the GL context's thread.
+class AsyncTextureLoader
+{
+public:
+    static AsyncTextureLoader& instance()
+    {
+        static AsyncTextureLoader loader;
+        return loader;
+    }
+
+    AsyncTextureLoader(const AsyncTextureLoader&) = delete;
+    AsyncTextureLoader& operator=(const AsyncTextureLoader&) = delete;
+
+    // Creates a placeholder texture and queues the image for decoding. The returned id is valid immediately,
+    // use isReady() to find out when it holds the real image.
+    unsigned int load(const std::string& filename, const TextureLoadParameters& requestedParameters)
+    {
+        TextureLoadParameters parameters = supportedLoadParameters(requestedParameters);
+
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        this->uploadPlaceholder(texture, parameters);
+
+        PendingTexture pending;
+        pending.id = texture;
+        pending.filename = filename;
+        pending.parameters = parameters;
+
+        pending.image = sharedThreadPool().submit([filename, parameters]()
+        {
+            return prepareImage(filename, parameters);
+        });
+
+        this->pendingTextures.push_back(std::move(pending));
+        return texture;
+    }
+
+    // Uploads finished decodes, oldest first, until the budget is used up. Always uploads at least one ready texture
+    // per call so a single huge image can't stall the queue forever.
+    void processUploads(double budgetMilliseconds = TEXTURE_UPLOAD_BUDGET_MS)
+    {
+        Timer uploadTimer;
+        bool uploadedAny = false;
+
+        for (size_t i = 0; i < this->pendingTextures.size();)
+        {
+            if (uploadedAny && uploadTimer.elapsedMilliseconds() >= budgetMilliseconds)
+            {
+                break;
+            }
+
+            PendingTexture& pending = this->pendingTextures[i];
+            if (pending.image.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            {
+                i++;
+                continue;
+            }
+
+            this->finish(pending, pending.image.get());
+            this->pendingTextures.erase(this->pendingTextures.begin() + i);
+            uploadedAny = true;
+        }
+    }
+
+    // Blocks until every queued texture has been decoded and uploaded, e.g. behind a loading screen
+    void finishAll()
+    {
+        for (PendingTexture& pending : this->pendingTextures)
+        {
+            // Waiting through the pool lets this thread help out with the decodes instead of just sitting idle
+            this->finish(pending, sharedThreadPool().wait(pending.image));
+        }
+
+        this->pendingTextures.clear();
+    }
+
+    // Stops tracking a texture that's about to be deleted. Its decode still finishes in the background,
+    // but the result is thrown away.
+    void cancel(unsigned int id)
+    {
+        for (size_t i = 0; i < this->pendingTextures.size(); i++)
+        {
+            if (this->pendingTextures[i].id == id)
+            {
+                this->pendingTextures.erase(this->pendingTextures.begin() + i);
+                return;
+            }
+        }
+    }
+
+    bool isReady(unsigned int id) const
+    {
+        for (const PendingTexture& pending : this->pendingTextures)
+        {
+            if (pending.id == id)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    size_t pendingCount() const
+    {
+        return this->pendingTextures.size();
+    }
+
+private:
+    struct PendingTexture
+    {
+        unsigned int id = 0;
+        std::string filename;
+        TextureLoadParameters parameters;
+        std::future<DecodedImage> image;
+    };
+
+    std::vector<PendingTexture> pendingTextures;
+
+    AsyncTextureLoader() = default;
+
+    void finish(const PendingTexture& pending, const DecodedImage& image)
+    {
+        if (!image.isValid())
+        {
+            // Leave the placeholder in place so whatever uses this texture still renders something
+            std::cout << "Failed to load texture " << pending.filename << std::endl;
+            return;
+        }
+
+        uploadTexture(pending.id, image, pending.parameters);
+    }
+
+    // Fills a texture with a single mid-grey texel. A 1x1 image is already mipmap complete, so this samples
+    // fine with any of our filtering modes.
+    void uploadPlaceholder(unsigned int texture, const TextureLoadParameters& parameters)
+    {
+        const unsigned char placeholderTexel[4] = { 128, 128, 128, 255 };
+
+        GLStateCache::instance().bindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, parameters.wrapS);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, parameters.wrapT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, parameters.minFilter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, parameters.magFilter);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholderTexel);
+    }
+};
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef MIP_BENCHMARK_H
+#define MIP_BENCHMARK_H
+
+#include <algorithm>
+#include <glad/glad.h>
+#include <iostream>
+#include <Rendering/glStateCache.h>
+#include <string>
+#include <Textures/mipGenerator.h>
+#include <Textures/texture.h>
+#include <Utility/timer.h>
+
+// Times getting a fully mipmapped texture onto the GPU both ways: uploading level 0 and calling glGenerateMipmap,
+// versus generating the chain with MipGenerator and uploading every level. Each is run a few times and the best
+// time kept, with a glFinish so the driver can't hide its share of the work.
+// Needs to be called from the thread that owns the GL context.
+inline void benchmarkMipGeneration(const std::string& filename, bool srgbEncoded = true, int runs = 5)
+{
+    DecodedImage image = decodeImage(filename, true);
+    if (!image.isValid())
+    {
+        std::cout << "Failed to load texture " << filename << std::endl;
+        return;
+    }
+
+    GLenum format = formatForChannels(image.channels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    double bestDriverTime = -1.0, bestCpuGenerateTime = -1.0, bestCpuTotalTime = -1.0;
+    for (int run = 0; run < runs; run++)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        GLStateCache::instance().bindTexture(GL_TEXTURE_2D, texture);
+        glFinish();
+
+        Timer driverTimer;
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glFinish();
+        double driverTime = driverTimer.elapsedMilliseconds();
+        GLStateCache::instance().deleteTexture(texture);
+
+        glGenTextures(1, &texture);
+        GLStateCache::instance().bindTexture(GL_TEXTURE_2D, texture);
+        glFinish();
+
+        Timer cpuTimer;
+        MipChain mips = MipGenerator::generate(image.pixels, image.width, image.height, image.channels, srgbEncoded);
+        double cpuGenerateTime = cpuTimer.elapsedMilliseconds();
+
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels);
+        for (size_t i = 0; i < mips.levels.size(); i++)
+        {
+            const MipChain::Level& level = mips.levels[i];
+            glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(i + 1), format, level.width, level.height, 0, format, GL_UNSIGNED_BYTE,
+                mips.levelPixels(i));
+        }
+
+        glFinish();
+        double cpuTotalTime = cpuTimer.elapsedMilliseconds();
+        GLStateCache::instance().deleteTexture(texture);
+
+        bestDriverTime = run == 0 ? driverTime : std::min(bestDriverTime, driverTime);
+        bestCpuGenerateTime = run == 0 ? cpuGenerateTime : std::min(bestCpuGenerateTime, cpuGenerateTime);
+        bestCpuTotalTime = run == 0 ? cpuTotalTime : std::min(bestCpuTotalTime, cpuTotalTime);
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    GLStateCache::instance().bindTexture(GL_TEXTURE_2D, 0);
+
+    std::cout << "TEXTURE::MIP_BENCHMARK::" << filename << " " << image.width << "x" << image.height << "x" << image.channels
+        << ", best of " << runs << ": glGenerateMipmap " << bestDriverTime << " ms, MipGenerator " << bestCpuTotalTime
+        << " ms (" << bestCpuGenerateTime << " ms generating, the rest uploading)" << std::endl;
+}
+
+#endif
@@ -0,0 +1,291 @@
+#ifndef MIP_GENERATOR_H
+#define MIP_GENERATOR_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <Utility/threadPool.h>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define MIP_GENERATOR_SSE2
+    #include <emmintrin.h>
+#endif
+
+// Every mip level below an image, largest first, all with the image's channel count
+struct MipChain
+{
+    struct Level
+    {
+        int width;
+        int height;
+        size_t offset;
+    };
+
+    int channels = 0;
+    std::vector<unsigned char> data;
+    std::vector<Level> levels;
+
+    const unsigned char* levelPixels(size_t level) const
+    {
+        return this->data.data() + this->levels[level].offset;
+    }
+};
+
+// Builds mip chains on the CPU, so uploads don't have to go through glGenerateMipmap.
+//
+// The driver's mip generation stalls the upload, filters however the driver feels like (often in sRGB space, which
+// darkens every level), and on software GL can take longer than everything else at startup put together. Here
+// each level is a box filter of the one above it, done in linear light for sRGB colour: a plain 2x2 average for even
+// dimensions, and the 3 tap polyphase box for odd ones so no row or column of the source gets dropped. Rows are spread
+// across the shared thread pool and the vertical pass, which does most of the arithmetic, runs four floats at a time.
+class MipGenerator
+{
+public:
+    // Generates every level below a width x height image with 1-4 channels of 8-bit texels. With srgbEncoded the
+    // colour channels are treated as sRGB and filtered in linear light, otherwise (and always for alpha) texels are
+    // averaged as they are. Use it for colour textures, not for data like specular or normal maps.
+    static MipChain generate(const unsigned char* pixels, int width, int height, int channels, bool srgbEncoded)
+    {
+        MipChain chain;
+        chain.channels = channels;
+        if (!pixels || width <= 0 || height <= 0 || channels < 1 || channels > 4)
+        {
+            return chain;
+        }
+
+        size_t offset = 0;
+        int levelWidth = width, levelHeight = height;
+        while (levelWidth > 1 || levelHeight > 1)
+        {
+            levelWidth = std::max(levelWidth / 2, 1);
+            levelHeight = std::max(levelHeight / 2, 1);
+
+            MipChain::Level level;
+            level.width = levelWidth;
+            level.height = levelHeight;
+            level.offset = offset;
+            chain.levels.push_back(level);
+            offset += static_cast<size_t>(levelWidth) * levelHeight * channels;
+        }
+
+        chain.data.resize(offset);
+
+        // Alpha is always stored linearly, it's the last channel of grey + alpha and RGBA images
+        bool linearChannels[4] = { !srgbEncoded, !srgbEncoded, !srgbEncoded, !srgbEncoded };
+        if (channels == 2 || channels == 4)
+        {
+            linearChannels[channels - 1] = true;
+        }
+
+        const unsigned char* source = pixels;
+        int sourceWidth = width, sourceHeight = height;
+        for (const MipChain::Level& level : chain.levels)
+        {
+            unsigned char* destination = chain.data.data() + level.offset;
+            downsample(source, sourceWidth, sourceHeight, destination, level.width, level.height, channels, linearChannels);
+
+            source = destination;
+            sourceWidth = level.width;
+            sourceHeight = level.height;
+        }
+
+        return chain;
+    }
+
+private:
+    // Rows of the destination handed to each thread pool task
+    static const int ROWS_PER_TASK = 16;
+
+    // Source texels (up to 3) and their weights contributing to one destination row or column
+    struct FilterTaps
+    {
+        int first;
+        int count;
+        float weights[3];
+    };
+
+    static std::vector<FilterTaps> filterTaps(int sourceSize, int destinationSize)
+    {
+        std::vector<FilterTaps> taps(destinationSize);
+        for (int i = 0; i < destinationSize; i++)
+        {
+            FilterTaps& tap = taps[i];
+            if (sourceSize == 1)
+            {
+                // Nothing left to shrink along this axis
+                tap.first = 0;
+                tap.count = 1;
+                tap.weights[0] = 1.0f;
+            }
+            else if (sourceSize % 2 == 0)
+            {
+                tap.first = i * 2;
+                tap.count = 2;
+                tap.weights[0] = tap.weights[1] = 0.5f;
+            }
+            else
+            {
+                // Each destination texel covers 2 + 1/destinationSize source texels, sliding across the three it
+                // touches from left to right
+                float total = static_cast<float>(2 * destinationSize + 1);
+                tap.first = i * 2;
+                tap.count = 3;
+                tap.weights[0] = (destinationSize - i) / total;
+                tap.weights[1] = destinationSize / total;
+                tap.weights[2] = (i + 1) / total;
+            }
+        }
+
+        return taps;
+    }
+
+    static void downsample(const unsigned char* source, int sourceWidth, int sourceHeight, unsigned char* destination,
+        int destinationWidth, int destinationHeight, int channels, const bool* linearChannels)
+    {
+        std::vector<FilterTaps> columnTaps = filterTaps(sourceWidth, destinationWidth);
+        std::vector<FilterTaps> rowTaps = filterTaps(sourceHeight, destinationHeight);
+
+        // Per channel lookup from stored 8-bit values to linear floats
+        const float* toLinear[4];
+        for (int channel = 0; channel < channels; channel++)
+        {
+            toLinear[channel] = linearChannels[channel] ? unormToFloatTable() : srgbToLinearTable();
+        }
+
+        const unsigned char* toSrgb = linearToSrgbTable();
+
+        size_t sourceRowSize = static_cast<size_t>(sourceWidth) * channels;
+        size_t destinationRowSize = static_cast<size_t>(destinationWidth) * channels;
+        size_t taskCount = (static_cast<size_t>(destinationHeight) + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+
+        sharedThreadPool().parallelFor(taskCount, [&](size_t task)
+        {
+            std::vector<float> linearRow(sourceRowSize);
+            std::vector<float> filteredRow(sourceRowSize);
+
+            int lastRow = std::min(static_cast<int>((task + 1) * ROWS_PER_TASK), destinationHeight);
+            for (int y = static_cast<int>(task * ROWS_PER_TASK); y < lastRow; y++)
+            {
+                // Vertical pass: weighted sum of the source rows, still at full width
+                const FilterTaps& rowTap = rowTaps[y];
+                std::fill(filteredRow.begin(), filteredRow.end(), 0.0f);
+                for (int tap = 0; tap < rowTap.count; tap++)
+                {
+                    const unsigned char* sourceRow = source + (rowTap.first + tap) * sourceRowSize;
+                    for (size_t i = 0; i < sourceRowSize; i += channels)
+                    {
+                        for (int channel = 0; channel < channels; channel++)
+                        {
+                            linearRow[i + channel] = toLinear[channel][sourceRow[i + channel]];
+                        }
+                    }
+
+                    accumulateRow(filteredRow.data(), linearRow.data(), rowTap.weights[tap], sourceRowSize);
+                }
+
+                // Horizontal pass, then back to 8 bits
+                unsigned char* destinationRow = destination + y * destinationRowSize;
+                for (int x = 0; x < destinationWidth; x++)
+                {
+                    const FilterTaps& columnTap = columnTaps[x];
+                    for (int channel = 0; channel < channels; channel++)
+                    {
+                        float value = 0.0f;
+                        for (int tap = 0; tap < columnTap.count; tap++)
+                        {
+                            value += filteredRow[(columnTap.first + tap) * channels + channel] * columnTap.weights[tap];
+                        }
+
+                        value = std::min(std::max(value, 0.0f), 1.0f);
+                        destinationRow[x * channels + channel] = linearChannels[channel]
+                            ? static_cast<unsigned char>(value * 255.0f + 0.5f)
+                            : toSrgb[static_cast<int>(value * LINEAR_TABLE_SCALE + 0.5f)];
+                    }
+                }
+            }
+        });
+    }
+
+    // total += row * weight
+    static void accumulateRow(float* total, const float* row, float weight, size_t count)
+    {
+        size_t i = 0;
+
+#ifdef MIP_GENERATOR_SSE2
+        const __m128 weights = _mm_set1_ps(weight);
+        for (; i + 4 <= count; i += 4)
+        {
+            _mm_storeu_ps(total + i, _mm_add_ps(_mm_loadu_ps(total + i), _mm_mul_ps(_mm_loadu_ps(row + i), weights)));
+        }
+#endif
+
+        for (; i < count; i++)
+        {
+            total[i] += row[i] * weight;
+        }
+    }
+
+    // Size of the linear to sRGB table. Fine enough that even the darkest sRGB steps are several entries apart.
+    static const int LINEAR_TABLE_SCALE = 65535;
+
+    static float srgbToLinear(float value)
+    {
+        return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+    }
+
+    static float linearToSrgb(float value)
+    {
+        return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+    }
+
+    static const float* unormToFloatTable()
+    {
+        static const std::vector<float> table = []()
+        {
+            std::vector<float> values(256);
+            for (int i = 0; i < 256; i++)
+            {
+                values[i] = i / 255.0f;
+            }
+
+            return values;
+        }();
+
+        return table.data();
+    }
+
+    static const float* srgbToLinearTable()
+    {
+        static const std::vector<float> table = []()
+        {
+            std::vector<float> values(256);
+            for (int i = 0; i < 256; i++)
+            {
+                values[i] = srgbToLinear(i / 255.0f);
+            }
+
+            return values;
+        }();
+
+        return table.data();
+    }
+
+    static const unsigned char* linearToSrgbTable()
+    {
+        static const std::vector<unsigned char> table = []()
+        {
+            std::vector<unsigned char> values(LINEAR_TABLE_SCALE + 1);
+            for (int i = 0; i <= LINEAR_TABLE_SCALE; i++)
+            {
+                values[i] = static_cast<unsigned char>(linearToSrgb(static_cast<float>(i) / LINEAR_TABLE_SCALE) * 255.0f + 0.5f);
+            }
+
+            return values;
+        }();
+
+        return table.data();
+    }
+};
+
+#endif
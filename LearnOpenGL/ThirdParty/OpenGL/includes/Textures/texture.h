@@ -0,0 +1,284 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <cstdint>
+#include <glad/glad.h>
+#include <iostream>
+#include <Rendering/glStateCache.h>
+#include <sstream>
+#include <string>
+#include <Textures/mipGenerator.h>
+#include <Textures/stb_image.h>
+#include <Textures/textureCache.h>
+#include <Textures/textureCompression.h>
+#include <Utility/assets.h>
+#include <Utility/timer.h>
+
+// Everything that changes what ends up on the GPU for a given image file. Two loads of the same file with different
+// parameters produce different GL textures, so this is part of the texture registry's key.
+struct TextureLoadParameters
+{
+    GLint wrapS = GL_REPEAT;
+    GLint wrapT = GL_REPEAT;
+    GLint minFilter = GL_LINEAR_MIPMAP_LINEAR;
+    GLint magFilter = GL_LINEAR;
+
+    // Most of our images are stored top row first, but OpenGL expects the bottom row first
+    bool flipVertically = true;
+
+    // Block compress the texture (through the cache next to the image, see TextureCache) instead of uploading
+    // plain 8-bit texels. Falls back to uncompressed if the GL context can't sample the format.
+    TextureCompression compression = TextureCompression::None;
+
+    // The image is sRGB encoded colour, so its mips are filtered in linear light. Turn it off for textures that
+    // hold data rather than colour, like specular and normal maps.
+    bool srgbEncoded = true;
+
+    bool operator==(const TextureLoadParameters& other) const
+    {
+        return this->wrapS == other.wrapS
+            && this->wrapT == other.wrapT
+            && this->minFilter == other.minFilter
+            && this->magFilter == other.magFilter
+            && this->flipVertically == other.flipVertically
+            && this->compression == other.compression
+            && this->srgbEncoded == other.srgbEncoded;
+    }
+};
+
+// CPU-side pixels decoded by stb_image. Owns the pixel buffer and frees it on destruction, so it can be handed
+// between threads without anyone having to remember to call stbi_image_free.
+struct DecodedImage
+{
+    unsigned char* pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+
+    // Levels below pixels, generated on the CPU so uploads don't need glGenerateMipmap
+    MipChain mips;
+
+    // Holds the image (and its mips) instead of pixels when it's going to be uploaded block compressed
+    CompressedTexture compressed;
+
+    DecodedImage() = default;
+
+    ~DecodedImage()
+    {
+        stbi_image_free(this->pixels);
+    }
+
+    DecodedImage(const DecodedImage&) = delete;
+    DecodedImage& operator=(const DecodedImage&) = delete;
+
+    DecodedImage(DecodedImage&& other) noexcept
+        : pixels(other.pixels), width(other.width), height(other.height), channels(other.channels), mips(std::move(other.mips)),
+          compressed(std::move(other.compressed))
+    {
+        other.pixels = nullptr;
+    }
+
+    DecodedImage& operator=(DecodedImage&& other) noexcept
+    {
+        if (this != &other)
+        {
+            stbi_image_free(this->pixels);
+            this->pixels = other.pixels;
+            this->width = other.width;
+            this->height = other.height;
+            this->channels = other.channels;
+            this->mips = std::move(other.mips);
+            this->compressed = std::move(other.compressed);
+            other.pixels = nullptr;
+        }
+
+        return *this;
+    }
+
+    bool isValid() const
+    {
+        return this->pixels != nullptr || this->compressed.isValid();
+    }
+};
+
+// Decodes an image file into memory. Doesn't touch OpenGL, so it's safe to call from worker threads.
+inline DecodedImage decodeImage(const std::string& filename, bool flipVertically)
+{
+    DecodedImage image;
+
+    AssetData file = Assets::instance().read(filename);
+    if (!file.isOpen())
+    {
+        return image;
+    }
+
+    // Use the per-thread flag so we never depend on (or clobber) whatever the global stbi setting happens to be
+    stbi_set_flip_vertically_on_load_thread(flipVertically);
+    image.pixels = stbi_load_from_memory(file.data(), static_cast<int>(file.size()), &image.width, &image.height, &image.channels, 0);
+
+    return image;
+}
+
+// Gets an image ready for uploadTexture(). Uncompressed textures are decoded and get their mips generated.
+// Compressed ones are read from the TextureCache, and if that's missing or stale the image is decoded, compressed
+// (mips and all) and written to the cache first. Doesn't touch OpenGL, so it's safe to call from worker threads.
+inline DecodedImage prepareImage(const std::string& filename, const TextureLoadParameters& parameters)
+{
+    if (parameters.compression == TextureCompression::None)
+    {
+        DecodedImage image = decodeImage(filename, parameters.flipVertically);
+        if (image.isValid())
+        {
+            image.mips = MipGenerator::generate(image.pixels, image.width, image.height, image.channels, parameters.srgbEncoded);
+        }
+
+        return image;
+    }
+
+    uint64_t sourceHash = 0;
+    if (!TextureCache::hashSourceFile(filename, parameters.flipVertically, parameters.srgbEncoded, sourceHash))
+    {
+        return DecodedImage();
+    }
+
+    DecodedImage image;
+    std::string cachePath = TextureCache::cachePathFor(filename, parameters.compression);
+    if (TextureCache::read(cachePath, sourceHash, parameters.compression, image.compressed))
+    {
+        image.width = image.compressed.width;
+        image.height = image.compressed.height;
+        return image;
+    }
+
+    Timer compressTimer;
+    image = decodeImage(filename, parameters.flipVertically);
+    if (!image.isValid())
+    {
+        return image;
+    }
+
+    image.compressed = TextureCompressor::compress(image.pixels, image.width, image.height, image.channels, parameters.compression,
+        parameters.srgbEncoded);
+    stbi_image_free(image.pixels);
+    image.pixels = nullptr;
+
+    // Built up front so lines from different worker threads don't get interleaved
+    std::ostringstream message;
+    message << "TEXTURE::COMPRESSED::" << filename << " " << compressionName(parameters.compression) << " " << image.width << "x"
+        << image.height << ", " << image.compressed.data.size() / 1024 << " KB with mips (" << compressTimer.elapsedMilliseconds() << " ms)\n";
+    if (!TextureCache::write(cachePath, sourceHash, image.compressed))
+    {
+        message << "ERROR::TEXTURE_CACHE::Failed to write " << cachePath << "\n";
+    }
+
+    std::cout << message.str();
+    return image;
+}
+
+// The parameters to actually load a texture with in the current GL context, dropping compression the driver can't
+// sample. Needs to be called from the thread that owns the GL context.
+inline TextureLoadParameters supportedLoadParameters(const TextureLoadParameters& parameters)
+{
+    TextureLoadParameters supported = parameters;
+    if (!isCompressionSupported(parameters.compression))
+    {
+        supported.compression = TextureCompression::None;
+    }
+
+    return supported;
+}
+
+// Maps a decoded channel count onto the matching GL pixel format
+inline GLenum formatForChannels(int channels)
+{
+    // TODO: Again, is this a proper initialization? We need a good default to avoid the unitialized memory issue
+    GLenum format = 0;
+    if (channels == 1)
+    {
+        format = GL_RED;
+    }
+    else if (channels == 3)
+    {
+        format = GL_RGB;
+    }
+    else if (channels == 4)
+    {
+        format = GL_RGBA;
+    }
+
+    return format;
+}
+
+// Uploads decoded pixels and their mips into an existing GL texture (replacing whatever it held before).
+// Needs to be called from the thread that owns the GL context.
+inline void uploadTexture(unsigned int texture, const DecodedImage& image, const TextureLoadParameters& parameters)
+{
+    GLStateCache::instance().bindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, parameters.wrapS);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, parameters.wrapT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, parameters.minFilter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, parameters.magFilter);
+
+    // Compressed images bring their own mips, glGenerateMipmap can't make them
+    const CompressedTexture& compressed = image.compressed;
+    if (compressed.isValid())
+    {
+        GLenum compressedFormat = compressionGLFormat(compressed.compression);
+        for (size_t i = 0; i < compressed.levels.size(); i++)
+        {
+            const CompressedTexture::Level& level = compressed.levels[i];
+            glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(i), compressedFormat, level.width, level.height, 0,
+                static_cast<GLsizei>(level.size), compressed.data.data() + level.offset);
+        }
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(compressed.levels.size() - 1));
+        return;
+    }
+
+    // Rows of 1 and 3 channel levels are rarely 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    GLenum format = formatForChannels(image.channels);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels);
+
+    if (image.mips.levels.empty())
+    {
+        // Images that didn't come through prepareImage() (or are already 1x1)
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    else
+    {
+        for (size_t i = 0; i < image.mips.levels.size(); i++)
+        {
+            const MipChain::Level& level = image.mips.levels[i];
+            glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(i + 1), format, level.width, level.height, 0, format, GL_UNSIGNED_BYTE,
+                image.mips.levelPixels(i));
+        }
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(image.mips.levels.size()));
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+// Decodes an image file and uploads it as a new mipmapped GL texture, returning its id (or 0 on failure).
+// Blocks on the decode, see AsyncTextureLoader for the non-blocking version.
+// Needs to be called from the thread that owns the GL context.
+inline unsigned int loadTexture(const std::string& filename, const TextureLoadParameters& requestedParameters)
+{
+    TextureLoadParameters parameters = supportedLoadParameters(requestedParameters);
+    DecodedImage image = prepareImage(filename, parameters);
+    if (!image.isValid())
+    {
+        std::cout << "Failed to load texture " << filename << std::endl;
+        return 0;
+    }
+
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    uploadTexture(texture, image, parameters);
+
+    return texture;
+}
+
+#endif
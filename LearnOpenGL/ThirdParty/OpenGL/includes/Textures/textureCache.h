@@ -0,0 +1,210 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <Textures/textureCompression.h>
+#include <Utility/assets.h>
+#include <Utility/hash.h>
+
+// Block compressed copies of our textures, written next to the source image (e.g. diffuse.jpg.bc7.dds).
+//
+// Compressing a 4K texture takes far longer than decoding it, so it's done once at import and the result, mips and
+// all, is stored as a plain DDS file (with the DX10 header) that any texture viewer can open. Rows are stored in the
+// order we upload them, i.e. already flipped if the load asked for it.
+//
+// We stash our own magic, version and a hash of the source image in the header's reserved words. A cache whose hash
+// doesn't match (the source changed, or was loaded with a different flip or colour space) is ignored and rewritten. Bump
+// TEXTURE_CACHE_VERSION whenever the encoder changes what it outputs.
+//
+// Caches are read through Assets like their source is, so an archive can ship them; new ones are written as loose files.
+
+const uint32_t TEXTURE_CACHE_MAGIC = 0x43544F4C; // "LOTC"
+const uint32_t TEXTURE_CACHE_VERSION = 2;
+
+struct DdsPixelFormat
+{
+    uint32_t size;
+    uint32_t flags;
+    uint32_t fourCC;
+    uint32_t rgbBitCount;
+    uint32_t redMask;
+    uint32_t greenMask;
+    uint32_t blueMask;
+    uint32_t alphaMask;
+};
+
+struct DdsHeader
+{
+    uint32_t size;
+    uint32_t flags;
+    uint32_t height;
+    uint32_t width;
+    uint32_t pitchOrLinearSize;
+    uint32_t depth;
+    uint32_t mipMapCount;
+
+    // [0] magic, [1] version, [2..3] source hash
+    uint32_t reserved1[11];
+
+    DdsPixelFormat pixelFormat;
+    uint32_t caps;
+    uint32_t caps2;
+    uint32_t caps3;
+    uint32_t caps4;
+    uint32_t reserved2;
+};
+
+struct DdsHeaderDx10
+{
+    uint32_t dxgiFormat;
+    uint32_t resourceDimension;
+    uint32_t miscFlag;
+    uint32_t arraySize;
+    uint32_t miscFlags2;
+};
+
+class TextureCache
+{
+public:
+    // Where the cache for a given source image and format lives
+    static std::string cachePathFor(const std::string& sourcePath, TextureCompression compression)
+    {
+        return sourcePath + "." + compressionName(compression) + ".dds";
+    }
+
+    // Hashes the contents of the source image, and how it's going to be decoded and filtered. Returns false if the
+    // file can't be read.
+    static bool hashSourceFile(const std::string& sourcePath, bool flipVertically, bool srgbEncoded, uint64_t& hash)
+    {
+        AssetData source = Assets::instance().read(sourcePath);
+        if (!source.isOpen())
+        {
+            return false;
+        }
+
+        hash = hashBytes(source.data(), source.size());
+        hash = hashBytes(&flipVertically, sizeof(flipVertically), hash);
+        hash = hashBytes(&srgbEncoded, sizeof(srgbEncoded), hash);
+        return true;
+    }
+
+    // Loads a cached texture. Returns false (leaving texture empty) if the cache is missing, stale or malformed.
+    static bool read(const std::string& cachePath, uint64_t sourceHash, TextureCompression compression, CompressedTexture& texture)
+    {
+        texture = CompressedTexture();
+
+        const size_t HEADERS_SIZE = sizeof(uint32_t) + sizeof(DdsHeader) + sizeof(DdsHeaderDx10);
+
+        AssetData cache = Assets::instance().read(cachePath);
+        if (!cache.isOpen() || cache.size() < HEADERS_SIZE)
+        {
+            return false;
+        }
+
+        const unsigned char* data = cache.data();
+
+        uint32_t magic;
+        DdsHeader header;
+        DdsHeaderDx10 headerDx10;
+        memcpy(&magic, data, sizeof(uint32_t));
+        memcpy(&header, data + sizeof(uint32_t), sizeof(DdsHeader));
+        memcpy(&headerDx10, data + sizeof(uint32_t) + sizeof(DdsHeader), sizeof(DdsHeaderDx10));
+
+        uint64_t cachedHash = static_cast<uint64_t>(header.reserved1[2]) | (static_cast<uint64_t>(header.reserved1[3]) << 32);
+        if (magic != DDS_MAGIC
+            || header.reserved1[0] != TEXTURE_CACHE_MAGIC
+            || header.reserved1[1] != TEXTURE_CACHE_VERSION
+            || cachedHash != sourceHash
+            || headerDx10.dxgiFormat != dxgiFormatFor(compression)
+            || header.width == 0 || header.height == 0)
+        {
+            return false;
+        }
+
+        texture.allocate(compression, static_cast<int>(header.width), static_cast<int>(header.height));
+        if (header.mipMapCount != texture.levels.size() || cache.size() != HEADERS_SIZE + texture.data.size())
+        {
+            texture = CompressedTexture();
+            return false;
+        }
+
+        memcpy(texture.data.data(), data + HEADERS_SIZE, texture.data.size());
+        return true;
+    }
+
+    static bool write(const std::string& cachePath, uint64_t sourceHash, const CompressedTexture& texture)
+    {
+        if (!texture.isValid())
+        {
+            return false;
+        }
+
+        DdsHeader header = {};
+        header.size = sizeof(DdsHeader);
+        header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+        header.height = static_cast<uint32_t>(texture.height);
+        header.width = static_cast<uint32_t>(texture.width);
+        header.pitchOrLinearSize = static_cast<uint32_t>(texture.levels[0].size);
+        header.mipMapCount = static_cast<uint32_t>(texture.levels.size());
+        header.reserved1[0] = TEXTURE_CACHE_MAGIC;
+        header.reserved1[1] = TEXTURE_CACHE_VERSION;
+        header.reserved1[2] = static_cast<uint32_t>(sourceHash);
+        header.reserved1[3] = static_cast<uint32_t>(sourceHash >> 32);
+        header.pixelFormat.size = sizeof(DdsPixelFormat);
+        header.pixelFormat.flags = DDPF_FOURCC;
+        header.pixelFormat.fourCC = FOURCC_DX10;
+        header.caps = DDSCAPS_COMPLEX | DDSCAPS_TEXTURE | DDSCAPS_MIPMAP;
+
+        DdsHeaderDx10 headerDx10 = {};
+        headerDx10.dxgiFormat = dxgiFormatFor(texture.compression);
+        headerDx10.resourceDimension = D3D10_RESOURCE_DIMENSION_TEXTURE2D;
+        headerDx10.arraySize = 1;
+
+        std::ofstream cacheFile(Assets::instance().resolvePath(cachePath), std::ios::binary | std::ios::trunc);
+        if (!cacheFile)
+        {
+            return false;
+        }
+
+        cacheFile.write(reinterpret_cast<const char*>(&DDS_MAGIC), sizeof(uint32_t));
+        cacheFile.write(reinterpret_cast<const char*>(&header), sizeof(DdsHeader));
+        cacheFile.write(reinterpret_cast<const char*>(&headerDx10), sizeof(DdsHeaderDx10));
+        cacheFile.write(reinterpret_cast<const char*>(texture.data.data()), texture.data.size());
+
+        return static_cast<bool>(cacheFile);
+    }
+
+private:
+    static constexpr uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+    static constexpr uint32_t FOURCC_DX10 = 0x30315844; // "DX10"
+
+    static constexpr uint32_t DDSD_CAPS = 0x1;
+    static constexpr uint32_t DDSD_HEIGHT = 0x2;
+    static constexpr uint32_t DDSD_WIDTH = 0x4;
+    static constexpr uint32_t DDSD_PIXELFORMAT = 0x1000;
+    static constexpr uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+    static constexpr uint32_t DDSD_LINEARSIZE = 0x80000;
+    static constexpr uint32_t DDPF_FOURCC = 0x4;
+    static constexpr uint32_t DDSCAPS_COMPLEX = 0x8;
+    static constexpr uint32_t DDSCAPS_TEXTURE = 0x1000;
+    static constexpr uint32_t DDSCAPS_MIPMAP = 0x400000;
+    static constexpr uint32_t D3D10_RESOURCE_DIMENSION_TEXTURE2D = 3;
+
+    static uint32_t dxgiFormatFor(TextureCompression compression)
+    {
+        switch (compression)
+        {
+            case TextureCompression::BC1: return 71; // DXGI_FORMAT_BC1_UNORM
+            case TextureCompression::BC3: return 77; // DXGI_FORMAT_BC3_UNORM
+            case TextureCompression::BC5: return 83; // DXGI_FORMAT_BC5_UNORM
+            case TextureCompression::BC7: return 98; // DXGI_FORMAT_BC7_UNORM
+            default: return 0;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,703 @@
+#ifndef TEXTURE_COMPRESSION_H
+#define TEXTURE_COMPRESSION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <glad/glad.h>
+#include <string>
+#include <Textures/mipGenerator.h>
+#include <Utility/threadPool.h>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define TEXTURE_COMPRESSION_SSE2
+    #include <emmintrin.h>
+#endif
+
+// S3TC and BPTC aren't part of GL 3.3 core, so glad doesn't define their enums for us
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+    #define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+    #define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+    #define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+
+// GPU block compression formats. Every one of them stores 4x4 texel blocks:
+//
+//      BC1 - RGB, 8 bytes per block (4 bits per texel). Fine for colour without alpha, e.g. specular maps.
+//      BC3 - RGBA, 16 bytes per block. BC1 colour plus a separately interpolated alpha channel.
+//      BC5 - RG, 16 bytes per block. Two independent channels, made for tangent space normal maps (z is rebuilt
+//            in the shader).
+//      BC7 - RGBA, 16 bytes per block. Much better quality than BC1/BC3 for the same or double the size.
+enum class TextureCompression
+{
+    None,
+    BC1,
+    BC3,
+    BC5,
+    BC7
+};
+
+inline const char* compressionName(TextureCompression compression)
+{
+    switch (compression)
+    {
+        case TextureCompression::BC1: return "bc1";
+        case TextureCompression::BC3: return "bc3";
+        case TextureCompression::BC5: return "bc5";
+        case TextureCompression::BC7: return "bc7";
+        default: return "none";
+    }
+}
+
+inline GLenum compressionGLFormat(TextureCompression compression)
+{
+    switch (compression)
+    {
+        case TextureCompression::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case TextureCompression::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case TextureCompression::BC5: return GL_COMPRESSED_RG_RGTC2;
+        case TextureCompression::BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+        default: return 0;
+    }
+}
+
+// Bytes per 4x4 block
+inline size_t compressionBlockSize(TextureCompression compression)
+{
+    return compression == TextureCompression::BC1 ? 8 : 16;
+}
+
+inline size_t compressedLevelSize(TextureCompression compression, int width, int height)
+{
+    size_t blocksWide = (static_cast<size_t>(width) + 3) / 4;
+    size_t blocksHigh = (static_cast<size_t>(height) + 3) / 4;
+    return blocksWide * blocksHigh * compressionBlockSize(compression);
+}
+
+// Whether the current GL context can sample the given format. RGTC (BC5) is core, the others need an extension.
+// Has to be called from the thread the GL context is current on.
+inline bool isCompressionSupported(TextureCompression compression)
+{
+    static bool queried = false;
+    static bool s3tcSupported = false;
+    static bool bptcSupported = false;
+
+    if (!queried)
+    {
+        GLint extensionCount = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+        for (GLint i = 0; i < extensionCount; i++)
+        {
+            const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+            if (extension && strcmp(extension, "GL_EXT_texture_compression_s3tc") == 0)
+            {
+                s3tcSupported = true;
+            }
+            else if (extension && strcmp(extension, "GL_ARB_texture_compression_bptc") == 0)
+            {
+                bptcSupported = true;
+            }
+        }
+
+        queried = true;
+    }
+
+    switch (compression)
+    {
+        case TextureCompression::None: return true;
+        case TextureCompression::BC1: return s3tcSupported;
+        case TextureCompression::BC3: return s3tcSupported;
+        case TextureCompression::BC5: return true;
+        case TextureCompression::BC7: return bptcSupported;
+        default: return false;
+    }
+}
+
+// A block compressed image and its full mip chain, ready for glCompressedTexImage2D
+struct CompressedTexture
+{
+    struct Level
+    {
+        int width;
+        int height;
+        size_t offset;
+        size_t size;
+    };
+
+    TextureCompression compression = TextureCompression::None;
+    int width = 0;
+    int height = 0;
+
+    // Every level's blocks back to back, largest level first
+    std::vector<unsigned char> data;
+    std::vector<Level> levels;
+
+    bool isValid() const
+    {
+        return !this->levels.empty();
+    }
+
+    // Lays out the levels of a width x height image down to 1x1 and sizes data to fit them
+    void allocate(TextureCompression compression, int width, int height)
+    {
+        this->compression = compression;
+        this->width = width;
+        this->height = height;
+        this->levels.clear();
+
+        size_t offset = 0;
+        while (true)
+        {
+            Level level;
+            level.width = width;
+            level.height = height;
+            level.offset = offset;
+            level.size = compressedLevelSize(compression, width, height);
+            this->levels.push_back(level);
+            offset += level.size;
+
+            if (width == 1 && height == 1)
+            {
+                break;
+            }
+
+            width = std::max(width / 2, 1);
+            height = std::max(height / 2, 1);
+        }
+
+        this->data.assign(offset, 0);
+    }
+};
+
+// CPU encoder for BC1/BC3/BC5/BC7.
+//
+// Each block's endpoints are the extremes of its texels along their principal axis, and each texel gets the palette
+// entry nearest to its projection onto the line between the (quantized) endpoints. That's a long way from what the
+// offline encoders squeeze out with exhaustive endpoint searches, but it's fast enough to run at import time and
+// looks fine on photographic textures. BC7 only uses mode 6 (one RGBA line, 4 bit indices).
+//
+// Blocks are independent, so each level is spread across the shared thread pool a row of blocks at a time.
+class TextureCompressor
+{
+public:
+    // Compresses an 8-bit image with 1-4 channels (as decoded by stb_image) and the mip chain below it. Grey
+    // images are treated as RGB with equal channels, and missing alpha as opaque. srgbEncoded picks how the mips
+    // are filtered, see MipGenerator.
+    static CompressedTexture compress(const unsigned char* pixels, int width, int height, int channels, TextureCompression compression,
+        bool srgbEncoded)
+    {
+        CompressedTexture texture;
+        if (!pixels || width <= 0 || height <= 0 || channels < 1 || channels > 4 || compression == TextureCompression::None)
+        {
+            return texture;
+        }
+
+        texture.allocate(compression, width, height);
+
+        std::vector<unsigned char> rgba = expandToRGBA(pixels, width, height, channels);
+        MipChain mips = MipGenerator::generate(rgba.data(), width, height, 4, srgbEncoded);
+
+        for (size_t i = 0; i < texture.levels.size(); i++)
+        {
+            const CompressedTexture::Level& level = texture.levels[i];
+            const unsigned char* levelPixels = i == 0 ? rgba.data() : mips.levelPixels(i - 1);
+            compressLevel(levelPixels, level.width, level.height, compression, texture.data.data() + level.offset);
+        }
+
+        return texture;
+    }
+
+private:
+    // One 4x4 block as floats, one array per channel, so the SIMD paths can load four texels of a channel at once
+    struct BlockTexels
+    {
+        float channels[4][16];
+    };
+
+    static std::vector<unsigned char> expandToRGBA(const unsigned char* pixels, int width, int height, int channels)
+    {
+        size_t texelCount = static_cast<size_t>(width) * height;
+        std::vector<unsigned char> rgba(texelCount * 4);
+
+        for (size_t i = 0; i < texelCount; i++)
+        {
+            const unsigned char* source = pixels + i * channels;
+            unsigned char* destination = &rgba[i * 4];
+
+            if (channels <= 2)
+            {
+                destination[0] = destination[1] = destination[2] = source[0];
+                destination[3] = channels == 2 ? source[1] : 255;
+            }
+            else
+            {
+                destination[0] = source[0];
+                destination[1] = source[1];
+                destination[2] = source[2];
+                destination[3] = channels == 4 ? source[3] : 255;
+            }
+        }
+
+        return rgba;
+    }
+
+    static void compressLevel(const unsigned char* rgba, int width, int height, TextureCompression compression, unsigned char* output)
+    {
+        size_t blocksWide = (static_cast<size_t>(width) + 3) / 4;
+        size_t blocksHigh = (static_cast<size_t>(height) + 3) / 4;
+        size_t blockSize = compressionBlockSize(compression);
+
+        sharedThreadPool().parallelFor(blocksHigh, [&](size_t blockY)
+        {
+            BlockTexels block;
+            for (size_t blockX = 0; blockX < blocksWide; blockX++)
+            {
+                fetchBlock(rgba, width, height, static_cast<int>(blockX), static_cast<int>(blockY), block);
+
+                unsigned char* destination = output + (blockY * blocksWide + blockX) * blockSize;
+                switch (compression)
+                {
+                    case TextureCompression::BC1:
+                        encodeBC1(block, destination);
+                        break;
+                    case TextureCompression::BC3:
+                        encodeBC4(block, 3, destination);
+                        encodeBC1(block, destination + 8);
+                        break;
+                    case TextureCompression::BC5:
+                        encodeBC4(block, 0, destination);
+                        encodeBC4(block, 1, destination + 8);
+                        break;
+                    case TextureCompression::BC7:
+                        encodeBC7(block, destination);
+                        break;
+                    default:
+                        break;
+                }
+            }
+        });
+    }
+
+    // Blocks hanging over the right or bottom edge repeat the edge texels, which the GPU never samples anyway
+    static void fetchBlock(const unsigned char* rgba, int width, int height, int blockX, int blockY, BlockTexels& block)
+    {
+        for (int y = 0; y < 4; y++)
+        {
+            int sourceY = std::min(blockY * 4 + y, height - 1);
+            for (int x = 0; x < 4; x++)
+            {
+                int sourceX = std::min(blockX * 4 + x, width - 1);
+                const unsigned char* texel = rgba + (static_cast<size_t>(sourceY) * width + sourceX) * 4;
+                for (int c = 0; c < 4; c++)
+                {
+                    block.channels[c][y * 4 + x] = texel[c];
+                }
+            }
+        }
+    }
+
+    // Finds the line through the block's texels (in channels [firstChannel, firstChannel + channelCount)) that fits
+    // them best, and returns the two points on it that span all of their projections
+    static void fitEndpoints(const BlockTexels& block, int firstChannel, int channelCount, float* start, float* end)
+    {
+        float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for (int c = 0; c < channelCount; c++)
+        {
+            for (int i = 0; i < 16; i++)
+            {
+                mean[c] += block.channels[firstChannel + c][i];
+            }
+
+            mean[c] /= 16.0f;
+        }
+
+        float covariance[4][4] = {};
+        for (int i = 0; i < 16; i++)
+        {
+            for (int a = 0; a < channelCount; a++)
+            {
+                float da = block.channels[firstChannel + a][i] - mean[a];
+                for (int b = a; b < channelCount; b++)
+                {
+                    covariance[a][b] += da * (block.channels[firstChannel + b][i] - mean[b]);
+                }
+            }
+        }
+
+        for (int a = 0; a < channelCount; a++)
+        {
+            for (int b = 0; b < a; b++)
+            {
+                covariance[a][b] = covariance[b][a];
+            }
+        }
+
+        // Power iteration converges on the principal axis plenty fast for a 4x4 matrix. It's seeded with the
+        // covariance row of the channel that varies most: a fixed seed like grey misses any axis orthogonal to it
+        // (red against green, say), iterating down to nothing and leaving the block flat.
+        int widest = 0;
+        for (int a = 1; a < channelCount; a++)
+        {
+            if (covariance[a][a] > covariance[widest][widest])
+            {
+                widest = a;
+            }
+        }
+
+        // Every texel is the same colour
+        if (covariance[widest][widest] <= 0.0f)
+        {
+            for (int c = 0; c < channelCount; c++)
+            {
+                start[c] = end[c] = mean[c];
+            }
+
+            return;
+        }
+
+        float seed[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        float seedLength = 0.0f;
+        for (int a = 0; a < channelCount; a++)
+        {
+            seed[a] = covariance[widest][a];
+            seedLength = std::max(seedLength, std::abs(seed[a]));
+        }
+
+        float axis[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for (int a = 0; a < channelCount; a++)
+        {
+            seed[a] /= seedLength;
+            axis[a] = seed[a];
+        }
+
+        for (int iteration = 0; iteration < 8; iteration++)
+        {
+            float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            float length = 0.0f;
+            for (int a = 0; a < channelCount; a++)
+            {
+                for (int b = 0; b < channelCount; b++)
+                {
+                    next[a] += covariance[a][b] * axis[b];
+                }
+
+                length = std::max(length, std::abs(next[a]));
+            }
+
+            // The seed row itself has to lie along some spread of the texels, so it beats a degenerate axis
+            if (length <= covariance[widest][widest] * 1e-6f)
+            {
+                std::copy(seed, seed + 4, axis);
+                break;
+            }
+
+            for (int a = 0; a < channelCount; a++)
+            {
+                axis[a] = next[a] / length;
+            }
+        }
+
+        float axisLengthSquared = 0.0f;
+        for (int c = 0; c < channelCount; c++)
+        {
+            axisLengthSquared += axis[c] * axis[c];
+        }
+
+        float minProjection = 0.0f, maxProjection = 0.0f;
+        for (int i = 0; i < 16; i++)
+        {
+            float projection = 0.0f;
+            for (int c = 0; c < channelCount; c++)
+            {
+                projection += (block.channels[firstChannel + c][i] - mean[c]) * axis[c];
+            }
+
+            projection /= axisLengthSquared;
+            minProjection = std::min(minProjection, projection);
+            maxProjection = std::max(maxProjection, projection);
+        }
+
+        for (int c = 0; c < channelCount; c++)
+        {
+            start[c] = std::min(std::max(mean[c] + axis[c] * minProjection, 0.0f), 255.0f);
+            end[c] = std::min(std::max(mean[c] + axis[c] * maxProjection, 0.0f), 255.0f);
+        }
+    }
+
+    // Rounds each texel's projection onto the line from start to end to the nearest of steps evenly spaced points
+    // (0 at start, steps - 1 at end). Every encoder picks its indices through here, so it does four texels at a time.
+    static void fitToLine(const BlockTexels& block, int firstChannel, int channelCount, const float* start, const float* end, int steps, int* result)
+    {
+        float direction[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        float lengthSquared = 0.0f;
+        for (int c = 0; c < channelCount; c++)
+        {
+            direction[c] = end[c] - start[c];
+            lengthSquared += direction[c] * direction[c];
+        }
+
+        if (lengthSquared == 0.0f)
+        {
+            std::fill(result, result + 16, 0);
+            return;
+        }
+
+        float scale = (steps - 1) / lengthSquared;
+
+#ifdef TEXTURE_COMPRESSION_SSE2
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 lastStep = _mm_set1_ps(static_cast<float>(steps - 1));
+        for (int i = 0; i < 16; i += 4)
+        {
+            __m128 t = zero;
+            for (int c = 0; c < channelCount; c++)
+            {
+                __m128 offset = _mm_sub_ps(_mm_loadu_ps(&block.channels[firstChannel + c][i]), _mm_set1_ps(start[c]));
+                t = _mm_add_ps(t, _mm_mul_ps(offset, _mm_set1_ps(direction[c])));
+            }
+
+            t = _mm_min_ps(_mm_max_ps(_mm_mul_ps(t, _mm_set1_ps(scale)), zero), lastStep);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(result + i), _mm_cvtps_epi32(t));
+        }
+#else
+        for (int i = 0; i < 16; i++)
+        {
+            float t = 0.0f;
+            for (int c = 0; c < channelCount; c++)
+            {
+                t += (block.channels[firstChannel + c][i] - start[c]) * direction[c];
+            }
+
+            t = std::min(std::max(t * scale, 0.0f), static_cast<float>(steps - 1));
+            result[i] = static_cast<int>(t + 0.5f);
+        }
+#endif
+    }
+
+    static uint16_t packRGB565(const float* color, float* quantized)
+    {
+        int r = static_cast<int>(color[0] * 31.0f / 255.0f + 0.5f);
+        int g = static_cast<int>(color[1] * 63.0f / 255.0f + 0.5f);
+        int b = static_cast<int>(color[2] * 31.0f / 255.0f + 0.5f);
+
+        // What the GPU will expand the endpoint back to
+        quantized[0] = static_cast<float>((r << 3) | (r >> 2));
+        quantized[1] = static_cast<float>((g << 2) | (g >> 4));
+        quantized[2] = static_cast<float>((b << 3) | (b >> 2));
+
+        return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+    }
+
+    static void encodeBC1(const BlockTexels& block, unsigned char* output)
+    {
+        float start[4], end[4];
+        fitEndpoints(block, 0, 3, start, end);
+
+        float quantizedStart[4], quantizedEnd[4];
+        uint16_t color0 = packRGB565(start, quantizedStart);
+        uint16_t color1 = packRGB565(end, quantizedEnd);
+
+        uint32_t indices = 0;
+        if (color0 != color1)
+        {
+            int steps[16];
+            fitToLine(block, 0, 3, quantizedStart, quantizedEnd, 4, steps);
+
+            // Palette order is color0, color1, 2/3 color0 + 1/3 color1, 1/3 color0 + 2/3 color1
+            const uint32_t STEP_TO_INDEX[4] = { 0, 2, 3, 1 };
+
+            // The 4 colour mode needs color0 > color1, swapping the endpoints swaps 0 with 1 and 2 with 3
+            uint32_t swapMask = 0;
+            if (color0 < color1)
+            {
+                std::swap(color0, color1);
+                swapMask = 1;
+            }
+
+            for (int i = 0; i < 16; i++)
+            {
+                indices |= (STEP_TO_INDEX[steps[i]] ^ swapMask) << (i * 2);
+            }
+        }
+
+        memcpy(output, &color0, 2);
+        memcpy(output + 2, &color1, 2);
+        memcpy(output + 4, &indices, 4);
+    }
+
+    // Single channel block, used for BC3 alpha and both BC5 channels
+    static void encodeBC4(const BlockTexels& block, int channel, unsigned char* output)
+    {
+        float low = 255.0f, high = 0.0f;
+        for (int i = 0; i < 16; i++)
+        {
+            low = std::min(low, block.channels[channel][i]);
+            high = std::max(high, block.channels[channel][i]);
+        }
+
+        // value0 > value1 selects the 8 value mode: value0, value1, then 6 evenly spaced values from value0 to value1
+        unsigned char value0 = static_cast<unsigned char>(high + 0.5f);
+        unsigned char value1 = static_cast<unsigned char>(low + 0.5f);
+        output[0] = value0;
+        output[1] = value1;
+
+        uint64_t indices = 0;
+        if (value0 != value1)
+        {
+            float start = value0, end = value1;
+            int steps[16];
+            fitToLine(block, channel, 1, &start, &end, 8, steps);
+
+            for (int i = 0; i < 16; i++)
+            {
+                uint64_t index = steps[i] == 0 ? 0 : (steps[i] == 7 ? 1 : steps[i] + 1);
+                indices |= index << (i * 3);
+            }
+        }
+
+        for (int i = 0; i < 6; i++)
+        {
+            output[2 + i] = static_cast<unsigned char>(indices >> (i * 8));
+        }
+    }
+
+    // Picks the 7 bit RGBA endpoint plus shared p-bit that lands closest to color
+    static void quantizeBC7Endpoint(const float* color, int* quantized, int& pBit, float* reconstructed)
+    {
+        float bestError = -1.0f;
+        for (int candidatePBit = 0; candidatePBit < 2; candidatePBit++)
+        {
+            int candidate[4];
+            float error = 0.0f;
+            for (int c = 0; c < 4; c++)
+            {
+                candidate[c] = std::min(std::max(static_cast<int>((color[c] - candidatePBit) / 2.0f + 0.5f), 0), 127);
+                float difference = static_cast<float>((candidate[c] << 1) | candidatePBit) - color[c];
+                error += difference * difference;
+            }
+
+            if (bestError < 0.0f || error < bestError)
+            {
+                bestError = error;
+                pBit = candidatePBit;
+                for (int c = 0; c < 4; c++)
+                {
+                    quantized[c] = candidate[c];
+                    reconstructed[c] = static_cast<float>((candidate[c] << 1) | candidatePBit);
+                }
+            }
+        }
+    }
+
+    static void encodeBC7(const BlockTexels& block, unsigned char* output)
+    {
+        static const int WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+        float start[4], end[4];
+        fitEndpoints(block, 0, 4, start, end);
+
+        int endpoints[2][4];
+        int pBits[2];
+        float reconstructed[2][4];
+        quantizeBC7Endpoint(start, endpoints[0], pBits[0], reconstructed[0]);
+        quantizeBC7Endpoint(end, endpoints[1], pBits[1], reconstructed[1]);
+
+        int indices[16];
+        fitToLine(block, 0, 4, reconstructed[0], reconstructed[1], 16, indices);
+
+        // The weights are only roughly even, so let each texel check the neighbouring palette entries too
+        float palette[16][4];
+        for (int i = 0; i < 16; i++)
+        {
+            for (int c = 0; c < 4; c++)
+            {
+                int value0 = static_cast<int>(reconstructed[0][c]), value1 = static_cast<int>(reconstructed[1][c]);
+                palette[i][c] = static_cast<float>(((64 - WEIGHTS[i]) * value0 + WEIGHTS[i] * value1 + 32) >> 6);
+            }
+        }
+
+        for (int i = 0; i < 16; i++)
+        {
+            int bestIndex = indices[i];
+            float bestError = -1.0f;
+            for (int candidate = std::max(indices[i] - 1, 0); candidate <= std::min(indices[i] + 1, 15); candidate++)
+            {
+                float error = 0.0f;
+                for (int c = 0; c < 4; c++)
+                {
+                    float difference = palette[candidate][c] - block.channels[c][i];
+                    error += difference * difference;
+                }
+
+                if (bestError < 0.0f || error < bestError)
+                {
+                    bestError = error;
+                    bestIndex = candidate;
+                }
+            }
+
+            indices[i] = bestIndex;
+        }
+
+        // The first texel's index is stored without its top bit, so it has to point into the first half of the palette
+        if (indices[0] >= 8)
+        {
+            std::swap(endpoints[0], endpoints[1]);
+            std::swap(pBits[0], pBits[1]);
+            for (int i = 0; i < 16; i++)
+            {
+                indices[i] = 15 - indices[i];
+            }
+        }
+
+        // Mode 6: 7 mode bits (0000001), R0 R1 G0 G1 B0 B1 A0 A1 at 7 bits each, P0 P1, then the indices
+        BitWriter writer(output);
+        writer.write(1 << 6, 7);
+        for (int c = 0; c < 4; c++)
+        {
+            writer.write(endpoints[0][c], 7);
+            writer.write(endpoints[1][c], 7);
+        }
+
+        writer.write(pBits[0], 1);
+        writer.write(pBits[1], 1);
+        writer.write(indices[0], 3);
+        for (int i = 1; i < 16; i++)
+        {
+            writer.write(indices[i], 4);
+        }
+    }
+
+    // Packs fields into a 128 bit block, least significant bit first
+    struct BitWriter
+    {
+        unsigned char* output;
+        int position = 0;
+
+        explicit BitWriter(unsigned char* output)
+            : output(output)
+        {
+            memset(output, 0, 16);
+        }
+
+        void write(int value, int bitCount)
+        {
+            for (int i = 0; i < bitCount; i++, this->position++)
+            {
+                if (value & (1 << i))
+                {
+                    this->output[this->position / 8] |= static_cast<unsigned char>(1 << (this->position % 8));
+                }
+            }
+        }
+    };
+};
+
+#endif
@@ -0,0 +1,192 @@
+#ifndef TEXTURE_REGISTRY_H
+#define TEXTURE_REGISTRY_H
+
+#include <cstddef>
+#include <filesystem>
+#include <glad/glad.h>
+#include <Rendering/glStateCache.h>
+#include <string>
+#include <Textures/asyncTextureLoader.h>
+#include <Textures/texture.h>
+#include <Textures/textureStreamer.h>
+#include <unordered_map>
+#include <Utility/assetArchive.h>
+#include <Utility/hash.h>
+
+// How a texture that isn't resident yet gets loaded
+enum class TextureLoadMode
+{
+    // Decoded and uploaded before acquire returns
+    Blocking,
+
+    // Decoded in the background and uploaded whole, see AsyncTextureLoader
+    Async,
+
+    // Decoded in the background, then only the mip levels we can see are kept resident, see TextureStreamer
+    Streamed
+};
+
+// Process-wide cache of loaded GL textures, so every image is decoded and uploaded exactly once no matter how many
+// Models (or anything else) reference it.
+//
+// Textures are keyed by their canonical path, load parameters and load mode, and reference counted: every acquire()
+// has to be paired with a release(), and the GL texture is deleted when the last reference goes away. The mode is part
+// of the key because the modes hand out different things: a blocking acquire expects the whole image there when it
+// returns, and a streamed texture is budgeted and evicted by the TextureStreamer, which never sees one loaded any
+// other way. Acquiring the same image in two modes loads it twice.
+//
+// Like everything else that owns GL objects, only use this from the thread the GL context is current on.
+class TextureRegistry
+{
+public:
+    static TextureRegistry& instance()
+    {
+        static TextureRegistry registry;
+        return registry;
+    }
+
+    TextureRegistry(const TextureRegistry&) = delete;
+    TextureRegistry& operator=(const TextureRegistry&) = delete;
+
+    // Returns the GL texture for the given image, loading it on first use. Returns 0 (and holds no reference)
+    // if the image can't be loaded.
+    unsigned int acquire(const std::string& path, const TextureLoadParameters& parameters = TextureLoadParameters())
+    {
+        return this->acquireTexture(path, parameters, TextureLoadMode::Blocking);
+    }
+
+    // Same as acquire(), but a texture that isn't resident yet is streamed in through the AsyncTextureLoader.
+    // The id is usable straight away and shows a placeholder until the image has been decoded and uploaded.
+    unsigned int acquireAsync(const std::string& path, const TextureLoadParameters& parameters = TextureLoadParameters())
+    {
+        return this->acquireTexture(path, parameters, TextureLoadMode::Async);
+    }
+
+    // Same as acquireAsync(), but the texture's mip levels are streamed in and out by the TextureStreamer according
+    // to how big it is on screen. Report that every frame with TextureStreamer::requestScreenSize().
+    unsigned int acquireStreamed(const std::string& path, const TextureLoadParameters& parameters = TextureLoadParameters())
+    {
+        return this->acquireTexture(path, parameters, TextureLoadMode::Streamed);
+    }
+
+    // Drops a reference acquired through any of the acquire functions, deleting the GL texture once nobody is using it anymore.
+    // Releasing 0 or an id the registry doesn't own is a no-op.
+    void release(unsigned int id)
+    {
+        auto keyIterator = this->keysById.find(id);
+        if (keyIterator == this->keysById.end())
+        {
+            return;
+        }
+
+        auto entryIterator = this->entries.find(keyIterator->second);
+        if (--entryIterator->second.referenceCount == 0)
+        {
+            // Make sure a decode that's still in flight doesn't get uploaded into a deleted (or recycled) texture id
+            AsyncTextureLoader::instance().cancel(id);
+            TextureStreamer::instance().forget(id);
+
+            GLStateCache::instance().deleteTexture(id);
+            this->entries.erase(entryIterator);
+            this->keysById.erase(keyIterator);
+        }
+    }
+
+    // Number of distinct textures currently resident
+    size_t size() const
+    {
+        return this->entries.size();
+    }
+
+private:
+    struct TextureKey
+    {
+        std::string path;
+        TextureLoadParameters parameters;
+        TextureLoadMode mode;
+
+        bool operator==(const TextureKey& other) const
+        {
+            return this->path == other.path && this->parameters == other.parameters && this->mode == other.mode;
+        }
+    };
+
+    struct TextureKeyHasher
+    {
+        size_t operator()(const TextureKey& key) const
+        {
+            const TextureLoadParameters& parameters = key.parameters;
+            uint64_t hash = hashString(key.path);
+            hash = hashBytes(&parameters.wrapS, sizeof(parameters.wrapS), hash);
+            hash = hashBytes(&parameters.wrapT, sizeof(parameters.wrapT), hash);
+            hash = hashBytes(&parameters.minFilter, sizeof(parameters.minFilter), hash);
+            hash = hashBytes(&parameters.magFilter, sizeof(parameters.magFilter), hash);
+            hash = hashBytes(&parameters.flipVertically, sizeof(parameters.flipVertically), hash);
+            hash = hashBytes(&parameters.compression, sizeof(parameters.compression), hash);
+            hash = hashBytes(&parameters.srgbEncoded, sizeof(parameters.srgbEncoded), hash);
+            hash = hashBytes(&key.mode, sizeof(key.mode), hash);
+            return static_cast<size_t>(hash);
+        }
+    };
+
+    struct TextureEntry
+    {
+        unsigned int id;
+        unsigned int referenceCount;
+    };
+
+    std::unordered_map<TextureKey, TextureEntry, TextureKeyHasher> entries;
+    std::unordered_map<unsigned int, TextureKey> keysById;
+
+    TextureRegistry() = default;
+
+    unsigned int acquireTexture(const std::string& path, const TextureLoadParameters& parameters, TextureLoadMode mode)
+    {
+        TextureKey key;
+        key.path = canonicalizePath(path);
+        key.parameters = parameters;
+        key.mode = mode;
+
+        auto existing = this->entries.find(key);
+        if (existing != this->entries.end())
+        {
+            existing->second.referenceCount++;
+            return existing->second.id;
+        }
+
+        unsigned int id = 0;
+        switch (mode)
+        {
+            case TextureLoadMode::Blocking:
+                id = loadTexture(path, parameters);
+                break;
+            case TextureLoadMode::Async:
+                id = AsyncTextureLoader::instance().load(path, parameters);
+                break;
+            case TextureLoadMode::Streamed:
+                id = TextureStreamer::instance().load(path, parameters);
+                break;
+        }
+
+        if (id == 0)
+        {
+            return 0;
+        }
+
+        TextureEntry entry;
+        entry.id = id;
+        entry.referenceCount = 1;
+        this->entries.emplace(key, entry);
+        this->keysById.emplace(id, key);
+
+        return id;
+    }
+
+    // Resolves "./", "../" and slash direction so different spellings of the same asset name share one entry
+    static std::string canonicalizePath(const std::string& path)
+    {
+        return std::filesystem::path(normalizeAssetName(path)).lexically_normal().generic_string();
+    }
+};
+
+#endif
@@ -0,0 +1,456 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <future>
+#include <glad/glad.h>
+#include <iostream>
+#include <Rendering/glStateCache.h>
+#include <string>
+#include <Textures/texture.h>
+#include <unordered_map>
+#include <Utility/threadPool.h>
+#include <Utility/timer.h>
+#include <vector>
+
+// Default texture memory ceiling for streamed textures
+const size_t TEXTURE_STREAMING_BUDGET_BYTES = 256 * 1024 * 1024;
+
+// Default amount of each frame we're willing to spend uploading streamed mip levels
+const double TEXTURE_STREAMING_BUDGET_MS = 2.0;
+
+// Levels no bigger than this (in either dimension) are the always resident tail of a streamed texture
+const int STREAMING_TAIL_SIZE = 64;
+
+// What the streamer is holding on to, see TextureStreamer::stats()
+struct TextureStreamingStats
+{
+    size_t textureCount = 0;
+    size_t residentBytes = 0;
+    size_t budgetBytes = 0;
+
+    // Levels uploaded and evicted since the last stats() call
+    size_t uploadedLevels = 0;
+    size_t evictedLevels = 0;
+
+    // Textures sharper on screen than what's resident, and not yet caught up
+    size_t starvedTextures = 0;
+};
+
+// Keeps only the mip levels we can actually see resident, under a fixed memory budget.
+//
+// load() hands back a GL texture id straight away, holding a placeholder. Once the image has been prepared on the
+// thread pool (decoded, or read from the compressed texture cache) just its small tail levels are uploaded, and
+// GL_TEXTURE_BASE_LEVEL points at the largest of them so the texture is complete and samples fine from then on.
+//
+// Every frame whoever draws with a streamed texture reports how big it ends up on screen (requestScreenSize()), and
+// update() works out which level each texture needs. Textures missing levels are served biggest on screen first,
+// one level at a time from the coarsest down. When the next level doesn't fit in the budget, levels are evicted from
+// the textures that are least visible (or have more resident than they need) until it does. Evicted levels are
+// redefined as empty images so the driver can actually give their memory back.
+//
+// The CPU copy of every level is kept in RAM to stream from, so this bounds GPU memory, not system memory.
+// Like everything else that owns GL objects, only use this from the thread the GL context is current on.
+class TextureStreamer
+{
+public:
+    static TextureStreamer& instance()
+    {
+        static TextureStreamer streamer;
+        return streamer;
+    }
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    void setMemoryBudget(size_t bytes)
+    {
+        this->budgetBytes = bytes;
+    }
+
+    // Creates a placeholder texture and queues the image for preparing. The id is valid immediately.
+    unsigned int load(const std::string& filename, const TextureLoadParameters& requestedParameters)
+    {
+        TextureLoadParameters parameters = supportedLoadParameters(requestedParameters);
+
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        uploadPlaceholder(texture, parameters);
+
+        StreamedTexture& streamed = this->textures[texture];
+        streamed.id = texture;
+        streamed.filename = filename;
+        streamed.parameters = parameters;
+        streamed.pendingImage = sharedThreadPool().submit([filename, parameters]()
+        {
+            return prepareImage(filename, parameters);
+        });
+
+        return texture;
+    }
+
+    // Notes that a texture covers about this many pixels across on screen this frame. Textures the streamer
+    // doesn't own are ignored, so callers don't have to care how a texture was loaded.
+    void requestScreenSize(unsigned int id, float pixels)
+    {
+        auto streamed = this->textures.find(id);
+        if (streamed != this->textures.end())
+        {
+            streamed->second.screenSize = std::max(streamed->second.screenSize, pixels);
+        }
+    }
+
+    // Stops streaming a texture that's about to be deleted
+    void forget(unsigned int id)
+    {
+        auto streamed = this->textures.find(id);
+        if (streamed != this->textures.end())
+        {
+            this->residentBytes -= streamed->second.residentBytes;
+            this->textures.erase(streamed);
+        }
+    }
+
+    // Call once per frame, after everything has been drawn (and reported its screen sizes). Uploads finished
+    // images' tails, then streams levels in (and out) until the time budget is used up.
+    void update(double budgetMilliseconds = TEXTURE_STREAMING_BUDGET_MS)
+    {
+        Timer updateTimer;
+
+        for (auto& entry : this->textures)
+        {
+            StreamedTexture& streamed = entry.second;
+            if (streamed.levelCount == 0 && streamed.pendingImage.valid()
+                && streamed.pendingImage.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+            {
+                this->uploadTail(streamed, streamed.pendingImage.get());
+            }
+        }
+
+        // Work out what each texture wants, and serve the biggest on screen first
+        std::vector<StreamedTexture*> wanting;
+        for (auto& entry : this->textures)
+        {
+            StreamedTexture& streamed = entry.second;
+            if (streamed.levelCount == 0)
+            {
+                continue;
+            }
+
+            streamed.visibleSize = streamed.screenSize;
+            streamed.screenSize = 0.0f;
+            streamed.desiredLevel = this->desiredLevelFor(streamed);
+            if (streamed.residentLevel > streamed.desiredLevel)
+            {
+                wanting.push_back(&streamed);
+            }
+        }
+
+        std::sort(wanting.begin(), wanting.end(), [](const StreamedTexture* a, const StreamedTexture* b)
+        {
+            return a->visibleSize > b->visibleSize;
+        });
+
+        this->starvedTextures = wanting.size();
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (StreamedTexture* streamed : wanting)
+        {
+            while (streamed->residentLevel > streamed->desiredLevel)
+            {
+                if (updateTimer.elapsedMilliseconds() >= budgetMilliseconds)
+                {
+                    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+                    return;
+                }
+
+                size_t levelBytes = this->levelSize(*streamed, streamed->residentLevel - 1);
+                if (!this->makeRoom(levelBytes, *streamed))
+                {
+                    // Everything still resident is more important than this, and so is everything after it
+                    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+                    return;
+                }
+
+                this->uploadLevel(*streamed, streamed->residentLevel - 1);
+            }
+
+            this->starvedTextures--;
+        }
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+
+    // Resets the upload and eviction counters
+    TextureStreamingStats stats()
+    {
+        TextureStreamingStats result;
+        result.textureCount = this->textures.size();
+        result.residentBytes = this->residentBytes;
+        result.budgetBytes = this->budgetBytes;
+        result.uploadedLevels = this->uploadedLevels;
+        result.evictedLevels = this->evictedLevels;
+        result.starvedTextures = this->starvedTextures;
+
+        this->uploadedLevels = 0;
+        this->evictedLevels = 0;
+        return result;
+    }
+
+private:
+    struct StreamedTexture
+    {
+        unsigned int id = 0;
+        std::string filename;
+        TextureLoadParameters parameters;
+        std::future<DecodedImage> pendingImage;
+
+        // CPU copy of every level, which is what we stream from
+        DecodedImage image;
+
+        // 0 until the image has been prepared and its tail uploaded
+        int levelCount = 0;
+
+        // First level of the always resident tail, and the largest level currently resident
+        int tailLevel = 0;
+        int residentLevel = 0;
+        size_t residentBytes = 0;
+
+        // Largest reported on screen size this frame, and last frame's (0 = not drawn)
+        float screenSize = 0.0f;
+        float visibleSize = 0.0f;
+        int desiredLevel = 0;
+    };
+
+    std::unordered_map<unsigned int, StreamedTexture> textures;
+    size_t budgetBytes = TEXTURE_STREAMING_BUDGET_BYTES;
+    size_t residentBytes = 0;
+    size_t uploadedLevels = 0;
+    size_t evictedLevels = 0;
+    size_t starvedTextures = 0;
+
+    TextureStreamer() = default;
+
+    // Largest level needed so texels are about pixel sized, assuming whatever's drawn with the texture stretches
+    // it across its screen size once. Meshes often only cover part of their texture, so we aim one level sharper.
+    int desiredLevelFor(const StreamedTexture& streamed) const
+    {
+        if (streamed.visibleSize <= 0.0f)
+        {
+            return streamed.tailLevel;
+        }
+
+        int width = 0, height = 0;
+        levelDimensions(streamed, 0, width, height);
+        float texelsPerPixel = std::max(width, height) / streamed.visibleSize;
+        int level = static_cast<int>(std::floor(std::log2(std::max(texelsPerPixel, 1.0f)))) - 1;
+
+        return std::min(std::max(level, 0), streamed.tailLevel);
+    }
+
+    // Evicts levels until bytes more fit in the budget, never taking from textures at least as visible as the one
+    // we're making room for. Returns false if that isn't enough.
+    bool makeRoom(size_t bytes, const StreamedTexture& forTexture)
+    {
+        while (this->residentBytes + bytes > this->budgetBytes)
+        {
+            // Prefer textures holding more than they need, then the least visible
+            StreamedTexture* victim = nullptr;
+            for (auto& entry : this->textures)
+            {
+                StreamedTexture& candidate = entry.second;
+                if (&candidate == &forTexture || candidate.levelCount == 0 || candidate.residentLevel >= candidate.tailLevel)
+                {
+                    continue;
+                }
+
+                bool surplus = candidate.residentLevel < candidate.desiredLevel;
+                if (!surplus && candidate.visibleSize >= forTexture.visibleSize)
+                {
+                    continue;
+                }
+
+                if (!victim)
+                {
+                    victim = &candidate;
+                    continue;
+                }
+
+                bool victimSurplus = victim->residentLevel < victim->desiredLevel;
+                if ((surplus && !victimSurplus) || (surplus == victimSurplus && candidate.visibleSize < victim->visibleSize))
+                {
+                    victim = &candidate;
+                }
+            }
+
+            if (!victim)
+            {
+                return false;
+            }
+
+            this->evictLevel(*victim);
+        }
+
+        return true;
+    }
+
+    void uploadTail(StreamedTexture& streamed, DecodedImage image)
+    {
+        if (!image.isValid())
+        {
+            // Leave the placeholder in place so whatever uses this texture still renders something
+            std::cout << "Failed to load texture " << streamed.filename << std::endl;
+            return;
+        }
+
+        streamed.image = std::move(image);
+        streamed.levelCount = streamed.image.compressed.isValid()
+            ? static_cast<int>(streamed.image.compressed.levels.size())
+            : 1 + static_cast<int>(streamed.image.mips.levels.size());
+
+        streamed.tailLevel = streamed.levelCount - 1;
+        for (int level = 0; level < streamed.levelCount; level++)
+        {
+            int width = 0, height = 0;
+            levelDimensions(streamed, level, width, height);
+            if (std::max(width, height) <= STREAMING_TAIL_SIZE)
+            {
+                streamed.tailLevel = level;
+                break;
+            }
+        }
+
+        // Replace the placeholder outright, the tail levels are all the texture has for now
+        GLStateCache::instance().bindTexture(GL_TEXTURE_2D, streamed.id);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, streamed.levelCount - 1);
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        streamed.residentLevel = streamed.levelCount;
+        for (int level = streamed.levelCount - 1; level >= streamed.tailLevel; level--)
+        {
+            this->uploadLevel(streamed, level);
+        }
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        // A placeholder texel at level 0 would otherwise hang around until level 0 is streamed in
+        if (streamed.tailLevel > 0)
+        {
+            this->clearLevel(streamed, 0);
+        }
+    }
+
+    void uploadLevel(StreamedTexture& streamed, int level)
+    {
+        int width = 0, height = 0;
+        levelDimensions(streamed, level, width, height);
+
+        GLStateCache::instance().bindTexture(GL_TEXTURE_2D, streamed.id);
+
+        const DecodedImage& image = streamed.image;
+        if (image.compressed.isValid())
+        {
+            const CompressedTexture::Level& compressedLevel = image.compressed.levels[level];
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, compressionGLFormat(image.compressed.compression), width, height, 0,
+                static_cast<GLsizei>(compressedLevel.size), image.compressed.data.data() + compressedLevel.offset);
+        }
+        else
+        {
+            GLenum format = formatForChannels(image.channels);
+            const unsigned char* pixels = level == 0 ? image.pixels : image.mips.levelPixels(level - 1);
+            glTexImage2D(GL_TEXTURE_2D, level, format, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
+        }
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+
+        streamed.residentLevel = level;
+        streamed.residentBytes += this->levelSize(streamed, level);
+        this->residentBytes += this->levelSize(streamed, level);
+        this->uploadedLevels++;
+    }
+
+    void evictLevel(StreamedTexture& streamed)
+    {
+        int level = streamed.residentLevel;
+
+        GLStateCache::instance().bindTexture(GL_TEXTURE_2D, streamed.id);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level + 1);
+        this->clearLevel(streamed, level);
+
+        streamed.residentLevel = level + 1;
+        streamed.residentBytes -= this->levelSize(streamed, level);
+        this->residentBytes -= this->levelSize(streamed, level);
+        this->evictedLevels++;
+    }
+
+    // Redefines a level as an empty image, releasing its storage. Levels below the base level don't count towards
+    // completeness, so this leaves the texture perfectly usable.
+    void clearLevel(const StreamedTexture& streamed, int level)
+    {
+        GLStateCache::instance().bindTexture(GL_TEXTURE_2D, streamed.id);
+
+        const DecodedImage& image = streamed.image;
+        if (image.compressed.isValid())
+        {
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, compressionGLFormat(image.compressed.compression), 0, 0, 0, 0, nullptr);
+        }
+        else
+        {
+            GLenum format = formatForChannels(image.channels);
+            glTexImage2D(GL_TEXTURE_2D, level, format, 0, 0, 0, format, GL_UNSIGNED_BYTE, nullptr);
+        }
+    }
+
+    static void levelDimensions(const StreamedTexture& streamed, int level, int& width, int& height)
+    {
+        const DecodedImage& image = streamed.image;
+        if (image.compressed.isValid())
+        {
+            width = image.compressed.levels[level].width;
+            height = image.compressed.levels[level].height;
+        }
+        else if (level == 0)
+        {
+            width = image.width;
+            height = image.height;
+        }
+        else
+        {
+            width = image.mips.levels[level - 1].width;
+            height = image.mips.levels[level - 1].height;
+        }
+    }
+
+    // GPU memory a level takes up. Drivers pad RGB8 out to RGBA8, so count uncompressed texels as 4 bytes
+    // unless they're single channel.
+    size_t levelSize(const StreamedTexture& streamed, int level) const
+    {
+        const DecodedImage& image = streamed.image;
+        if (image.compressed.isValid())
+        {
+            return image.compressed.levels[level].size;
+        }
+
+        int width = 0, height = 0;
+        levelDimensions(streamed, level, width, height);
+        return static_cast<size_t>(width) * height * (image.channels == 1 ? 1 : 4);
+    }
+
+    // Fills a texture with a single mid-grey texel, see AsyncTextureLoader
+    static void uploadPlaceholder(unsigned int texture, const TextureLoadParameters& parameters)
+    {
+        const unsigned char placeholderTexel[4] = { 128, 128, 128, 255 };
+
+        GLStateCache::instance().bindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, parameters.wrapS);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, parameters.wrapT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, parameters.minFilter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, parameters.magFilter);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholderTexel);
+    }
+};
+
+#endif
@@ -0,0 +1,365 @@
+#ifndef ASSET_ARCHIVE_H
+#define ASSET_ARCHIVE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <Utility/hash.h>
+#include <Utility/lzBlock.h>
+#include <Utility/mappedFile.h>
+#include <vector>
+
+// A single file packing many assets, read through one memory mapping.
+//
+// Layout:
+//
+//      AssetArchiveHeader
+//      blobs               - each entry's bytes, stored raw or LZ compressed, every one aligned to ASSET_ARCHIVE_ALIGNMENT
+//      AssetArchiveEntry[] - table of contents, sorted by name hash so lookups are a binary search
+//      names               - every entry's name, back to back, not null terminated
+//
+// Blobs keep the same alignment the mesh cache gives its sections, so a raw blob can be read in place straight out
+// of the mapping exactly like the loose file would be.
+const uint32_t ASSET_ARCHIVE_MAGIC = 0x4B504F4C; // "LOPK"
+const uint32_t ASSET_ARCHIVE_VERSION = 1;
+const uint64_t ASSET_ARCHIVE_ALIGNMENT = 16;
+
+// Entries are only kept compressed if that saves at least this fraction of their size, otherwise the cost of
+// decompressing on every read isn't worth it
+const double ASSET_ARCHIVE_MIN_SAVING = 0.1;
+
+enum class AssetCompression : uint32_t
+{
+    None,
+    LZ
+};
+
+struct AssetArchiveHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved;
+    uint64_t tocOffset;
+    uint64_t namesOffset;
+    uint64_t namesSize;
+    uint64_t fileSize;
+};
+
+struct AssetArchiveEntry
+{
+    uint64_t nameHash;
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint64_t dataOffset;
+    uint64_t storedSize;
+    uint64_t size;
+    AssetCompression compression;
+    uint32_t reserved;
+};
+
+// Logical asset names always use forward slashes and never start with "./" or "/", so the same asset has one name
+// however it was written
+inline std::string normalizeAssetName(const std::string& name)
+{
+    std::string normalized = name;
+    std::replace(normalized.begin(), normalized.end(), '\\', '/');
+
+    size_t start = 0;
+    while (true)
+    {
+        if (normalized.compare(start, 2, "./") == 0)
+        {
+            start += 2;
+        }
+        else if (start < normalized.size() && normalized[start] == '/')
+        {
+            start++;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    return normalized.substr(start);
+}
+
+class AssetArchive
+{
+public:
+    // Maps the archive and checks its header and table of contents. Returns false if it can't be opened or is
+    // malformed, in which case nothing will be found in it.
+    bool open(const std::string& path)
+    {
+        this->close();
+
+        if (!this->file.open(path) || this->file.size() < sizeof(AssetArchiveHeader))
+        {
+            this->file.close();
+            return false;
+        }
+
+        AssetArchiveHeader header;
+        memcpy(&header, this->file.data(), sizeof(header));
+
+        size_t fileSize = this->file.size();
+        uint64_t tocSize = static_cast<uint64_t>(header.entryCount) * sizeof(AssetArchiveEntry);
+        if (header.magic != ASSET_ARCHIVE_MAGIC || header.version != ASSET_ARCHIVE_VERSION || header.fileSize != fileSize
+            || !fitsInFile(header.tocOffset, tocSize, fileSize) || !fitsInFile(header.namesOffset, header.namesSize, fileSize))
+        {
+            this->file.close();
+            return false;
+        }
+
+        this->entries.resize(header.entryCount);
+        memcpy(this->entries.data(), this->file.data() + header.tocOffset, tocSize);
+        this->names = reinterpret_cast<const char*>(this->file.data() + header.namesOffset);
+
+        for (const AssetArchiveEntry& entry : this->entries)
+        {
+            if (static_cast<uint64_t>(entry.nameOffset) + entry.nameLength > header.namesSize
+                || !fitsInFile(entry.dataOffset, entry.storedSize, fileSize)
+                || (entry.compression == AssetCompression::None && entry.storedSize != entry.size)
+                || entry.compression > AssetCompression::LZ)
+            {
+                this->close();
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void close()
+    {
+        this->file.close();
+        this->entries.clear();
+        this->names = nullptr;
+    }
+
+    bool isOpen() const
+    {
+        return this->file.isOpen();
+    }
+
+    size_t entryCount() const
+    {
+        return this->entries.size();
+    }
+
+    const AssetArchiveEntry& entry(size_t index) const
+    {
+        return this->entries[index];
+    }
+
+    std::string entryName(size_t index) const
+    {
+        const AssetArchiveEntry& entry = this->entries[index];
+        return std::string(this->names + entry.nameOffset, entry.nameLength);
+    }
+
+    // Looks an asset up by its logical name, returning nullptr if the archive doesn't hold it
+    const AssetArchiveEntry* find(const std::string& name) const
+    {
+        std::string normalized = normalizeAssetName(name);
+        uint64_t hash = hashString(normalized);
+
+        auto first = std::lower_bound(this->entries.begin(), this->entries.end(), hash,
+            [](const AssetArchiveEntry& entry, uint64_t value) { return entry.nameHash < value; });
+
+        // Hashes can collide, so check the names of everything sharing this one
+        for (auto it = first; it != this->entries.end() && it->nameHash == hash; ++it)
+        {
+            if (it->nameLength == normalized.size() && memcmp(this->names + it->nameOffset, normalized.data(), normalized.size()) == 0)
+            {
+                return &*it;
+            }
+        }
+
+        return nullptr;
+    }
+
+    // The entry's bytes as stored, pointing into the mapping. Only the asset itself if it isn't compressed.
+    const unsigned char* storedData(const AssetArchiveEntry& entry) const
+    {
+        return this->file.data() + entry.dataOffset;
+    }
+
+    // Decompresses an entry into output, which must hold entry.size bytes
+    bool decompress(const AssetArchiveEntry& entry, unsigned char* output) const
+    {
+        switch (entry.compression)
+        {
+            case AssetCompression::None:
+                memcpy(output, this->storedData(entry), static_cast<size_t>(entry.size));
+                return true;
+            case AssetCompression::LZ:
+                return lzDecompress(this->storedData(entry), static_cast<size_t>(entry.storedSize), output, static_cast<size_t>(entry.size));
+        }
+
+        return false;
+    }
+
+private:
+    MappedFile file;
+    std::vector<AssetArchiveEntry> entries;
+    const char* names = nullptr;
+
+    static bool fitsInFile(uint64_t offset, uint64_t length, size_t fileSize)
+    {
+        return offset <= fileSize && length <= fileSize - offset;
+    }
+};
+
+// Builds an archive. Add everything, then write it out in one go.
+class AssetArchiveWriter
+{
+public:
+    // Adds an asset under a logical name. With compress the bytes are LZ compressed, but only kept that way if it
+    // pays off. Returns false if an asset with that name was already added.
+    bool add(const std::string& name, const unsigned char* data, size_t size, bool compress)
+    {
+        PendingEntry pending;
+        pending.name = normalizeAssetName(name);
+        pending.size = size;
+
+        for (const PendingEntry& existing : this->pendingEntries)
+        {
+            if (existing.name == pending.name)
+            {
+                return false;
+            }
+        }
+
+        if (compress && size > 0)
+        {
+            std::vector<unsigned char> compressed = lzCompress(data, size);
+            if (compressed.size() <= static_cast<size_t>(size * (1.0 - ASSET_ARCHIVE_MIN_SAVING)))
+            {
+                pending.compression = AssetCompression::LZ;
+                pending.data = std::move(compressed);
+            }
+        }
+
+        if (pending.compression == AssetCompression::None)
+        {
+            pending.data.assign(data, data + size);
+        }
+
+        this->pendingEntries.push_back(std::move(pending));
+        return true;
+    }
+
+    // Reads a file from disk and adds it. Returns false if it can't be read or the name is taken.
+    bool addFile(const std::string& name, const std::string& path, bool compress)
+    {
+        MappedFile source(path);
+        if (!source.isOpen())
+        {
+            return false;
+        }
+
+        return this->add(name, source.data(), source.size(), compress);
+    }
+
+    size_t entryCount() const
+    {
+        return this->pendingEntries.size();
+    }
+
+    bool write(const std::string& path)
+    {
+        std::vector<AssetArchiveEntry> entries(this->pendingEntries.size());
+        std::string names;
+
+        uint64_t offset = alignOffset(sizeof(AssetArchiveHeader));
+        for (size_t i = 0; i < this->pendingEntries.size(); i++)
+        {
+            const PendingEntry& pending = this->pendingEntries[i];
+            AssetArchiveEntry& entry = entries[i];
+            entry.nameHash = hashString(pending.name);
+            entry.nameOffset = static_cast<uint32_t>(names.size());
+            entry.nameLength = static_cast<uint32_t>(pending.name.size());
+            entry.dataOffset = offset;
+            entry.storedSize = pending.data.size();
+            entry.size = pending.size;
+            entry.compression = pending.compression;
+            entry.reserved = 0;
+
+            names += pending.name;
+            offset = alignOffset(offset + entry.storedSize);
+        }
+
+        AssetArchiveHeader header = {};
+        header.magic = ASSET_ARCHIVE_MAGIC;
+        header.version = ASSET_ARCHIVE_VERSION;
+        header.entryCount = static_cast<uint32_t>(entries.size());
+        header.tocOffset = offset;
+        header.namesOffset = header.tocOffset + entries.size() * sizeof(AssetArchiveEntry);
+        header.namesSize = names.size();
+        header.fileSize = header.namesOffset + header.namesSize;
+
+        std::ofstream archiveFile(path, std::ios::binary | std::ios::trunc);
+        if (!archiveFile)
+        {
+            return false;
+        }
+
+        writeBytes(archiveFile, &header, sizeof(header));
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            writePadding(archiveFile, entries[i].dataOffset);
+            writeBytes(archiveFile, this->pendingEntries[i].data.data(), this->pendingEntries[i].data.size());
+        }
+
+        // Blobs went out in the order they were added, the table of contents is sorted for lookups
+        std::sort(entries.begin(), entries.end(),
+            [](const AssetArchiveEntry& a, const AssetArchiveEntry& b) { return a.nameHash < b.nameHash; });
+
+        writePadding(archiveFile, header.tocOffset);
+        writeBytes(archiveFile, entries.data(), entries.size() * sizeof(AssetArchiveEntry));
+        writeBytes(archiveFile, names.data(), names.size());
+
+        return static_cast<bool>(archiveFile);
+    }
+
+private:
+    struct PendingEntry
+    {
+        std::string name;
+        size_t size = 0;
+        AssetCompression compression = AssetCompression::None;
+        std::vector<unsigned char> data;
+    };
+
+    std::vector<PendingEntry> pendingEntries;
+
+    static uint64_t alignOffset(uint64_t offset)
+    {
+        return (offset + ASSET_ARCHIVE_ALIGNMENT - 1) & ~(ASSET_ARCHIVE_ALIGNMENT - 1);
+    }
+
+    static void writeBytes(std::ofstream& file, const void* source, size_t length)
+    {
+        if (length > 0)
+        {
+            file.write(static_cast<const char*>(source), static_cast<std::streamsize>(length));
+        }
+    }
+
+    static void writePadding(std::ofstream& file, uint64_t sectionOffset)
+    {
+        const char zeros[ASSET_ARCHIVE_ALIGNMENT] = {};
+        uint64_t position = static_cast<uint64_t>(file.tellp());
+        if (position < sectionOffset)
+        {
+            file.write(zeros, static_cast<std::streamsize>(sectionOffset - position));
+        }
+    }
+};
+
+#endif
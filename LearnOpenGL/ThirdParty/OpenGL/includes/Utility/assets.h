@@ -0,0 +1,272 @@
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include <cstddef>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <Utility/assetArchive.h>
+#include <Utility/mappedFile.h>
+#include <utility>
+#include <vector>
+
+// The bytes of one asset, however they were found: a view straight into a mounted archive, a buffer an archive entry
+// was decompressed into, or a mapping of a loose file. Holds on to whatever the bytes live in for as long as it's
+// alive, so it's safe to keep around after the asset system has moved on.
+class AssetData
+{
+public:
+    AssetData() = default;
+
+    AssetData(const AssetData&) = delete;
+    AssetData& operator=(const AssetData&) = delete;
+
+    AssetData(AssetData&& other) noexcept
+    {
+        this->takeFrom(other);
+    }
+
+    AssetData& operator=(AssetData&& other) noexcept
+    {
+        if (this != &other)
+        {
+            this->takeFrom(other);
+        }
+
+        return *this;
+    }
+
+    bool isOpen() const
+    {
+        return this->found;
+    }
+
+    const unsigned char* data() const
+    {
+        return this->bytes;
+    }
+
+    size_t size() const
+    {
+        return this->byteCount;
+    }
+
+    std::string toString() const
+    {
+        return std::string(reinterpret_cast<const char*>(this->bytes), this->byteCount);
+    }
+
+private:
+    friend class Assets;
+
+    bool found = false;
+    const unsigned char* bytes = nullptr;
+    size_t byteCount = 0;
+
+    std::shared_ptr<const AssetArchive> archive;
+    std::vector<unsigned char> decompressed;
+    MappedFile file;
+
+    // Moving a vector or mapping keeps its storage where it is, so bytes stays valid. other is left not found.
+    void takeFrom(AssetData& other)
+    {
+        this->found = other.found;
+        this->bytes = other.bytes;
+        this->byteCount = other.byteCount;
+        this->archive = std::move(other.archive);
+        this->decompressed = std::move(other.decompressed);
+        this->file = std::move(other.file);
+
+        other.found = false;
+        other.bytes = nullptr;
+        other.byteCount = 0;
+        other.archive.reset();
+        other.decompressed.clear();
+    }
+};
+
+// Resolves logical asset names like "Textures/container2.png" to their bytes, so nothing needs to know where (or in
+// what) the assets actually live.
+//
+// Archives and directories are mounted at startup and searched newest first. An archive answers every lookup from a
+// single mapping, with no opens or seeks per asset; a directory maps a prefix of the logical names onto a folder of
+// loose files, which is handy while developing and for anything that isn't packed yet.
+class Assets
+{
+public:
+    static Assets& instance()
+    {
+        static Assets assets;
+        return assets;
+    }
+
+    Assets(const Assets&) = delete;
+    Assets& operator=(const Assets&) = delete;
+
+    // Mounts a packed archive. Returns false (mounting nothing) if it's missing or malformed.
+    bool mountArchive(const std::string& path)
+    {
+        std::shared_ptr<AssetArchive> archive = std::make_shared<AssetArchive>();
+        if (!archive->open(path))
+        {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(this->mutex);
+        Mount mount;
+        mount.archive = archive;
+        this->mounts.push_back(mount);
+        return true;
+    }
+
+    // Maps logical names starting with prefix onto loose files under directory. An empty prefix catches everything.
+    void mountDirectory(const std::string& prefix, const std::string& directory)
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        Mount mount;
+        mount.prefix = normalizeAssetName(prefix);
+        if (!mount.prefix.empty() && mount.prefix.back() != '/')
+        {
+            mount.prefix += '/';
+        }
+
+        mount.directory = directory;
+        this->mounts.push_back(mount);
+    }
+
+    void unmountAll()
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->mounts.clear();
+    }
+
+    // Finds an asset, returning an AssetData that isn't open if no mount has it
+    AssetData read(const std::string& name) const
+    {
+        std::string normalized = normalizeAssetName(name);
+        std::vector<Mount> mounts = this->currentMounts();
+
+        AssetData asset;
+        for (auto it = mounts.rbegin(); it != mounts.rend(); ++it)
+        {
+            if (it->archive)
+            {
+                const AssetArchiveEntry* entry = it->archive->find(normalized);
+                if (!entry)
+                {
+                    continue;
+                }
+
+                if (entry->compression == AssetCompression::None)
+                {
+                    asset.archive = it->archive;
+                    asset.bytes = it->archive->storedData(*entry);
+                }
+                else
+                {
+                    asset.decompressed.resize(static_cast<size_t>(entry->size));
+                    if (!it->archive->decompress(*entry, asset.decompressed.data()))
+                    {
+                        std::cout << "ERROR::ASSETS::CORRUPT_ENTRY: " << normalized << std::endl;
+                        return AssetData();
+                    }
+
+                    asset.bytes = asset.decompressed.data();
+                }
+
+                asset.byteCount = static_cast<size_t>(entry->size);
+                asset.found = true;
+                return asset;
+            }
+
+            std::string path;
+            if (!looseFilePath(*it, normalized, path) || !asset.file.open(path))
+            {
+                continue;
+            }
+
+            asset.bytes = asset.file.data();
+            asset.byteCount = asset.file.size();
+            asset.found = true;
+            return asset;
+        }
+
+        return asset;
+    }
+
+    bool exists(const std::string& name) const
+    {
+        std::string normalized = normalizeAssetName(name);
+        std::vector<Mount> mounts = this->currentMounts();
+
+        std::error_code error;
+        for (auto it = mounts.rbegin(); it != mounts.rend(); ++it)
+        {
+            std::string path;
+            if (it->archive ? it->archive->find(normalized) != nullptr
+                : looseFilePath(*it, normalized, path) && std::filesystem::is_regular_file(path, error))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Where an asset would live as a loose file, for anything that needs a real path, like writing a cache next to
+    // its source. Uses the newest directory mount covering the name, or the name itself if none does.
+    std::string resolvePath(const std::string& name) const
+    {
+        std::string normalized = normalizeAssetName(name);
+        std::vector<Mount> mounts = this->currentMounts();
+
+        for (auto it = mounts.rbegin(); it != mounts.rend(); ++it)
+        {
+            std::string path;
+            if (!it->archive && looseFilePath(*it, normalized, path))
+            {
+                return path;
+            }
+        }
+
+        return normalized;
+    }
+
+private:
+    struct Mount
+    {
+        // Either an archive, or a prefix of logical names and the directory it maps onto
+        std::shared_ptr<const AssetArchive> archive;
+        std::string prefix;
+        std::string directory;
+    };
+
+    mutable std::mutex mutex;
+    std::vector<Mount> mounts;
+
+    Assets() = default;
+
+    // Assets are read from the texture workers as well as the main thread, so lookups work on a copy of the mounts
+    std::vector<Mount> currentMounts() const
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        return this->mounts;
+    }
+
+    static bool looseFilePath(const Mount& mount, const std::string& name, std::string& path)
+    {
+        if (name.compare(0, mount.prefix.size(), mount.prefix) != 0)
+        {
+            return false;
+        }
+
+        std::string relativePath = name.substr(mount.prefix.size());
+        path = mount.directory.empty() ? relativePath : mount.directory + '/' + relativePath;
+        return true;
+    }
+};
+
+#endif
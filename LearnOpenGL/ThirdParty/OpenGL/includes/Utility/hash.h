@@ -0,0 +1,35 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 64-bit FNV-1a hash.
+//
+// Not cryptographic, just a cheap and well distributed content hash we can use to tell whether an asset
+// has changed since we last derived something from it. Pass a previous result in as the seed to hash
+// several buffers as if they were one.
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+const uint64_t FNV_PRIME = 1099511628211ull;
+
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = FNV_OFFSET_BASIS)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = seed;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+inline uint64_t hashString(const std::string& value, uint64_t seed = FNV_OFFSET_BASIS)
+{
+    return hashBytes(value.data(), value.size(), seed);
+}
+
+#endif
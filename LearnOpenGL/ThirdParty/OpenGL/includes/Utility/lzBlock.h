@@ -0,0 +1,237 @@
+#ifndef LZ_BLOCK_H
+#define LZ_BLOCK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Small LZ77 compressor writing the LZ4 block format, so anything we compress can also be read by the real LZ4.
+//
+// We only need it for packing assets, where decompression speed is what matters: decoding is a tight loop of
+// memcpys that runs at memory bandwidth. Compression is a single greedy pass over a hash table of 4 byte sequences,
+// nowhere near as thorough as LZ4 HC, but fast and good enough on text formats like OBJ and GLSL.
+//
+// Block format: a run of sequences, each being
+//
+//      token           - high nibble literal count, low nibble match length - 4 (15 in either = more length bytes follow)
+//      [length bytes]  - added to the literal count, each 255 means another byte follows
+//      literals
+//      offset          - uint16 little endian, distance back to the start of the match
+//      [length bytes]  - added to the match length
+//
+// The last sequence is literals only, and the format requires it to hold at least the last 5 bytes of input.
+
+const size_t LZ_MIN_MATCH = 4;
+const size_t LZ_MAX_OFFSET = 65535;
+
+// Matches can't start in the last 12 bytes or end in the last 5
+const size_t LZ_MATCH_START_LIMIT = 12;
+const size_t LZ_LAST_LITERALS = 5;
+
+const int LZ_HASH_BITS = 16;
+
+// Largest possible compressed size of size bytes of input
+inline size_t lzCompressBound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+inline void lzWriteLength(std::vector<unsigned char>& output, size_t length)
+{
+    while (length >= 255)
+    {
+        output.push_back(255);
+        length -= 255;
+    }
+
+    output.push_back(static_cast<unsigned char>(length));
+}
+
+inline void lzWriteSequence(std::vector<unsigned char>& output, const unsigned char* literals, size_t literalCount, size_t offset, size_t matchLength)
+{
+    size_t matchCode = matchLength >= LZ_MIN_MATCH ? matchLength - LZ_MIN_MATCH : 0;
+    unsigned char token = static_cast<unsigned char>(((literalCount >= 15 ? 15 : literalCount) << 4) | (matchCode >= 15 ? 15 : matchCode));
+    output.push_back(token);
+
+    if (literalCount >= 15)
+    {
+        lzWriteLength(output, literalCount - 15);
+    }
+
+    output.insert(output.end(), literals, literals + literalCount);
+
+    // The final sequence has no match
+    if (matchLength == 0)
+    {
+        return;
+    }
+
+    output.push_back(static_cast<unsigned char>(offset & 0xFF));
+    output.push_back(static_cast<unsigned char>(offset >> 8));
+
+    if (matchCode >= 15)
+    {
+        lzWriteLength(output, matchCode - 15);
+    }
+}
+
+inline uint32_t lzHash(const unsigned char* data)
+{
+    uint32_t sequence;
+    memcpy(&sequence, data, sizeof(sequence));
+    return (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+inline std::vector<unsigned char> lzCompress(const unsigned char* input, size_t size)
+{
+    std::vector<unsigned char> output;
+    output.reserve(lzCompressBound(size));
+
+    // Position + 1 of the last time each hashed 4 byte sequence was seen (0 = never)
+    std::vector<uint32_t> table(static_cast<size_t>(1) << LZ_HASH_BITS, 0);
+
+    size_t anchor = 0;
+    size_t position = 0;
+
+    if (size > LZ_MATCH_START_LIMIT)
+    {
+        size_t matchStartLimit = size - LZ_MATCH_START_LIMIT;
+        size_t matchEndLimit = size - LZ_LAST_LITERALS;
+
+        while (position < matchStartLimit)
+        {
+            uint32_t hash = lzHash(input + position);
+            size_t candidate = table[hash];
+            table[hash] = static_cast<uint32_t>(position + 1);
+
+            if (candidate == 0 || position - (candidate - 1) > LZ_MAX_OFFSET || memcmp(input + candidate - 1, input + position, LZ_MIN_MATCH) != 0)
+            {
+                position++;
+                continue;
+            }
+
+            size_t matchStart = candidate - 1;
+
+            // Stretch the match backwards over literals we haven't emitted yet, then forwards as far as it goes
+            while (position > anchor && matchStart > 0 && input[position - 1] == input[matchStart - 1])
+            {
+                position--;
+                matchStart--;
+            }
+
+            size_t matchLength = LZ_MIN_MATCH;
+            while (position + matchLength < matchEndLimit && input[position + matchLength] == input[matchStart + matchLength])
+            {
+                matchLength++;
+            }
+
+            lzWriteSequence(output, input + anchor, position - anchor, position - matchStart, matchLength);
+
+            position += matchLength;
+            anchor = position;
+        }
+    }
+
+    lzWriteSequence(output, input + anchor, size - anchor, 0, 0);
+    return output;
+}
+
+// Decompresses a block into exactly size bytes of output. Returns false if the block is malformed or doesn't
+// decompress to exactly that size, never reading or writing out of bounds.
+inline bool lzDecompress(const unsigned char* input, size_t inputSize, unsigned char* output, size_t size)
+{
+    size_t in = 0;
+    size_t out = 0;
+
+    while (in < inputSize)
+    {
+        unsigned char token = input[in++];
+
+        size_t literalCount = token >> 4;
+        if (literalCount == 15)
+        {
+            unsigned char extra;
+            do
+            {
+                if (in >= inputSize)
+                {
+                    return false;
+                }
+
+                extra = input[in++];
+                literalCount += extra;
+            } while (extra == 255);
+        }
+
+        if (literalCount > inputSize - in || literalCount > size - out)
+        {
+            return false;
+        }
+
+        memcpy(output + out, input + in, literalCount);
+        in += literalCount;
+        out += literalCount;
+
+        // The last sequence ends after its literals
+        if (in == inputSize)
+        {
+            break;
+        }
+
+        if (inputSize - in < 2)
+        {
+            return false;
+        }
+
+        size_t offset = input[in] | (static_cast<size_t>(input[in + 1]) << 8);
+        in += 2;
+        if (offset == 0 || offset > out)
+        {
+            return false;
+        }
+
+        size_t matchLength = (token & 0x0F);
+        if (matchLength == 15)
+        {
+            unsigned char extra;
+            do
+            {
+                if (in >= inputSize)
+                {
+                    return false;
+                }
+
+                extra = input[in++];
+                matchLength += extra;
+            } while (extra == 255);
+        }
+
+        matchLength += LZ_MIN_MATCH;
+        if (matchLength > size - out)
+        {
+            return false;
+        }
+
+        // Matches can overlap the bytes they're producing (offset < length repeats a pattern), so only copy in bulk
+        // when they don't
+        const unsigned char* match = output + out - offset;
+        if (offset >= matchLength)
+        {
+            memcpy(output + out, match, matchLength);
+        }
+        else
+        {
+            for (size_t i = 0; i < matchLength; i++)
+            {
+                output[out + i] = match[i];
+            }
+        }
+
+        out += matchLength;
+    }
+
+    return out == size;
+}
+
+#endif
@@ -0,0 +1,222 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#ifdef _WIN32
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of an entire file.
+//
+// Mapping lets us hand the OS a single request for the whole file and then read straight out of the page cache,
+// instead of pulling the file through a chain of buffered stream reads.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+
+    explicit MappedFile(const std::string& path)
+    {
+        this->open(path);
+    }
+
+    ~MappedFile()
+    {
+        this->close();
+    }
+
+    // A mapping owns OS handles, so it can be moved around but never copied
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept
+    {
+        this->takeFrom(other);
+    }
+
+    MappedFile& operator=(MappedFile&& other) noexcept
+    {
+        if (this != &other)
+        {
+            this->close();
+            this->takeFrom(other);
+        }
+
+        return *this;
+    }
+
+    // Maps the file at the given path, returning false if it can't be opened or mapped.
+    // Empty files open successfully but have no data.
+    bool open(const std::string& path)
+    {
+        this->close();
+
+#ifdef _WIN32
+        this->fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (this->fileHandle == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(this->fileHandle, &fileSize))
+        {
+            this->close();
+            return false;
+        }
+
+        this->mappedSize = static_cast<size_t>(fileSize.QuadPart);
+        if (this->mappedSize == 0)
+        {
+            this->opened = true;
+            return true;
+        }
+
+        this->mappingHandle = CreateFileMappingA(this->fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (this->mappingHandle == NULL)
+        {
+            this->close();
+            return false;
+        }
+
+        this->mappedData = static_cast<const unsigned char*>(MapViewOfFile(this->mappingHandle, FILE_MAP_READ, 0, 0, 0));
+        if (this->mappedData == nullptr)
+        {
+            this->close();
+            return false;
+        }
+#else
+        this->fileDescriptor = ::open(path.c_str(), O_RDONLY);
+        if (this->fileDescriptor < 0)
+        {
+            return false;
+        }
+
+        struct stat fileStats;
+        if (fstat(this->fileDescriptor, &fileStats) != 0)
+        {
+            this->close();
+            return false;
+        }
+
+        this->mappedSize = static_cast<size_t>(fileStats.st_size);
+        if (this->mappedSize == 0)
+        {
+            this->opened = true;
+            return true;
+        }
+
+        void* mapping = mmap(nullptr, this->mappedSize, PROT_READ, MAP_PRIVATE, this->fileDescriptor, 0);
+        if (mapping == MAP_FAILED)
+        {
+            this->close();
+            return false;
+        }
+
+        this->mappedData = static_cast<const unsigned char*>(mapping);
+#endif
+
+        this->opened = true;
+        return true;
+    }
+
+    // Unmaps the file and releases its handles. Safe to call on an unopened mapping.
+    void close()
+    {
+#ifdef _WIN32
+        if (this->mappedData != nullptr)
+        {
+            UnmapViewOfFile(this->mappedData);
+        }
+        if (this->mappingHandle != NULL)
+        {
+            CloseHandle(this->mappingHandle);
+        }
+        if (this->fileHandle != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(this->fileHandle);
+        }
+
+        this->mappingHandle = NULL;
+        this->fileHandle = INVALID_HANDLE_VALUE;
+#else
+        if (this->mappedData != nullptr)
+        {
+            munmap(const_cast<unsigned char*>(this->mappedData), this->mappedSize);
+        }
+        if (this->fileDescriptor >= 0)
+        {
+            ::close(this->fileDescriptor);
+        }
+
+        this->fileDescriptor = -1;
+#endif
+
+        this->mappedData = nullptr;
+        this->mappedSize = 0;
+        this->opened = false;
+    }
+
+    bool isOpen() const
+    {
+        return this->opened;
+    }
+
+    const unsigned char* data() const
+    {
+        return this->mappedData;
+    }
+
+    size_t size() const
+    {
+        return this->mappedSize;
+    }
+
+private:
+    const unsigned char* mappedData = nullptr;
+    size_t mappedSize = 0;
+    bool opened = false;
+
+#ifdef _WIN32
+    HANDLE fileHandle = INVALID_HANDLE_VALUE;
+    HANDLE mappingHandle = NULL;
+#else
+    int fileDescriptor = -1;
+#endif
+
+    void takeFrom(MappedFile& other)
+    {
+        this->mappedData = other.mappedData;
+        this->mappedSize = other.mappedSize;
+        this->opened = other.opened;
+
+#ifdef _WIN32
+        this->fileHandle = other.fileHandle;
+        this->mappingHandle = other.mappingHandle;
+        other.fileHandle = INVALID_HANDLE_VALUE;
+        other.mappingHandle = NULL;
+#else
+        this->fileDescriptor = other.fileDescriptor;
+        other.fileDescriptor = -1;
+#endif
+
+        other.mappedData = nullptr;
+        other.mappedSize = 0;
+        other.opened = false;
+    }
+};
+
+#endif
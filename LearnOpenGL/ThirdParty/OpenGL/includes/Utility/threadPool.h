@@ -0,0 +1,219 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed size pool of worker threads pulling tasks off a shared FIFO queue.
+//
+// Only for CPU work! None of the workers own a GL context, so anything touching OpenGL has to be handed back to
+// the thread the context is current on.
+class ThreadPool
+{
+public:
+    // A thread count of 0 picks one worker per hardware thread, minus one for the main thread
+    explicit ThreadPool(unsigned int threadCount = 0)
+    {
+        if (threadCount == 0)
+        {
+            unsigned int hardwareThreads = std::thread::hardware_concurrency();
+            threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+        }
+
+        this->workers.reserve(threadCount);
+        for (unsigned int i = 0; i < threadCount; i++)
+        {
+            this->workers.emplace_back([this]() { this->workerLoop(); });
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->queueMutex);
+            this->stopping = true;
+        }
+
+        this->queueCondition.notify_all();
+        for (std::thread& worker : this->workers)
+        {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned int threadCount() const
+    {
+        return static_cast<unsigned int>(this->workers.size());
+    }
+
+    // Queues a task, returning a future for its result. Exceptions thrown by the task are rethrown from future::get().
+    template <typename Function>
+    auto submit(Function function) -> std::future<decltype(function())>
+    {
+        typedef decltype(function()) Result;
+
+        // packaged_task is move-only but std::function needs something copyable, hence the shared_ptr
+        std::shared_ptr<std::packaged_task<Result()>> task = std::make_shared<std::packaged_task<Result()>>(std::move(function));
+        std::future<Result> result = task->get_future();
+
+        {
+            std::lock_guard<std::mutex> lock(this->queueMutex);
+            this->tasks.emplace_back([task]() { (*task)(); });
+        }
+
+        this->queueCondition.notify_one();
+        return result;
+    }
+
+    // Blocks until the future is ready, running queued tasks on the calling thread in the meantime.
+    // This keeps things moving when a pool task itself waits on other pool tasks.
+    template <typename Result>
+    Result wait(std::future<Result>& future)
+    {
+        while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            if (!this->runPendingTask())
+            {
+                future.wait_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        return future.get();
+    }
+
+    // Calls function(i) for every i in [0, count), spread across the workers and the calling thread.
+    // Each index is visited exactly once, but in no particular order, so write results into slot i
+    // rather than appending if the order matters.
+    template <typename Function>
+    void parallelFor(size_t count, Function function)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        std::atomic<size_t> nextIndex(0);
+        auto runItems = [&nextIndex, &function, count]()
+        {
+            for (size_t i = nextIndex++; i < count; i = nextIndex++)
+            {
+                function(i);
+            }
+        };
+
+        // The calling thread pitches in too, so only spin up as many helpers as there's work for
+        size_t helperCount = std::min(count - 1, this->workers.size());
+        std::vector<std::future<void>> helpers;
+        helpers.reserve(helperCount);
+        for (size_t i = 0; i < helperCount; i++)
+        {
+            helpers.push_back(this->submit(runItems));
+        }
+
+        // The helpers reference locals on this stack frame, so every one of them has to finish before we leave,
+        // even if an item threw
+        std::exception_ptr error;
+        try
+        {
+            runItems();
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+            nextIndex = count;
+        }
+
+        for (std::future<void>& helper : helpers)
+        {
+            try
+            {
+                this->wait(helper);
+            }
+            catch (...)
+            {
+                if (!error)
+                {
+                    error = std::current_exception();
+                }
+            }
+        }
+
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    bool stopping = false;
+
+    void workerLoop()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+
+            {
+                std::unique_lock<std::mutex> lock(this->queueMutex);
+                this->queueCondition.wait(lock, [this]() { return this->stopping || !this->tasks.empty(); });
+
+                // Drain whatever is left before shutting down so no future is left hanging
+                if (this->tasks.empty())
+                {
+                    return;
+                }
+
+                task = std::move(this->tasks.front());
+                this->tasks.pop_front();
+            }
+
+            task();
+        }
+    }
+
+    bool runPendingTask()
+    {
+        std::function<void()> task;
+
+        {
+            std::lock_guard<std::mutex> lock(this->queueMutex);
+            if (this->tasks.empty())
+            {
+                return false;
+            }
+
+            task = std::move(this->tasks.front());
+            this->tasks.pop_front();
+        }
+
+        task();
+        return true;
+    }
+};
+
+// Process-wide pool shared by the asset pipeline, created on first use
+inline ThreadPool& sharedThreadPool()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+#endif
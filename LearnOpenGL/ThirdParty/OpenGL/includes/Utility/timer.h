@@ -0,0 +1,29 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <chrono>
+
+// Simple wall clock stopwatch for timing load stages and benchmarks
+class Timer
+{
+public:
+    Timer() : start(std::chrono::steady_clock::now())
+    {
+    }
+
+    void reset()
+    {
+        this->start = std::chrono::steady_clock::now();
+    }
+
+    double elapsedMilliseconds() const
+    {
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - this->start;
+        return elapsed.count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif